@@ -0,0 +1,30 @@
+#pragma once
+#include <glm\glm.hpp>
+#include <cmath>
+
+// Axis-aligned bounding box
+struct AABB
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+inline AABB mergeAABB(const AABB& a, const AABB& b) { return AABB{ glm::min(a.min, b.min), glm::max(a.max, b.max) }; }
+
+// bounds of the transformed box, computed from the transformed centre and extents
+inline AABB transformAABB(const AABB& box, const glm::mat4& transform)
+{
+	glm::vec3 centre = 0.5f * (box.min + box.max);
+	glm::vec3 extent = 0.5f * (box.max - box.min);
+	glm::vec3 newCentre = glm::vec3(transform * glm::vec4(centre, 1.0f));
+	glm::vec3 newExtent;
+	for (int i = 0; i < 3; i++)
+		newExtent[i] = fabsf(transform[0][i]) * extent.x + fabsf(transform[1][i]) * extent.y + fabsf(transform[2][i]) * extent.z;
+	return AABB{ newCentre - newExtent, newCentre + newExtent };
+}
+
+inline bool sphereIntersectsAABB(const glm::vec3& centre, float radius, const AABB& box)
+{
+	glm::vec3 offset = glm::clamp(centre, box.min, box.max) - centre;
+	return glm::dot(offset, offset) <= radius * radius;
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// constant initialised, so they are ready before any static constructor allocates
+static std::atomic<unsigned long long> gAllocations{ 0 };
+static std::atomic<unsigned long long> gAllocatedBytes{ 0 };
+
+AllocationCounts getAllocationCounts()
+{
+	return { gAllocations.load(std::memory_order_relaxed), gAllocatedBytes.load(std::memory_order_relaxed) };
+}
+
+static void* trackedAlloc(size_t size)
+{
+	gAllocations.fetch_add(1, std::memory_order_relaxed);
+	gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+	void* p = trackedAlloc(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return trackedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return trackedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+#ifdef __cpp_aligned_new
+// over-aligned types, such as the cache line padded per-worker lists
+static void* trackedAlignedAlloc(size_t size, std::align_val_t alignment)
+{
+	gAllocations.fetch_add(1, std::memory_order_relaxed);
+	gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	size_t align = (size_t)alignment;
+#ifdef _MSC_VER
+	return _aligned_malloc(size > 0 ? size : 1, align);
+#else
+	// aligned_alloc wants the size to be a multiple of the alignment
+	size_t rounded = (size + align - 1) / align * align;
+	return std::aligned_alloc(align, rounded > 0 ? rounded : align);
+#endif
+}
+
+static void trackedAlignedFree(void* p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* p = trackedAlignedAlloc(size, alignment);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return trackedAlignedAlloc(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return trackedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	trackedAlignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	trackedAlignedFree(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+	trackedAlignedFree(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+	trackedAlignedFree(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	trackedAlignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	trackedAlignedFree(p);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+// Totals of the allocations made through the global operator new, on any thread, since the program started.
+// AllocationTracker.cpp replaces operator new and delete to keep them; memory allocated with malloc by C
+// libraries (GLFW, the GL driver, stb_image) isn't counted.
+struct AllocationCounts
+{
+	unsigned long long allocations;
+	unsigned long long bytes;
+};
+
+AllocationCounts getAllocationCounts();
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "BasicMesh.h"
+#include "GpuMemory.h"
+#include "RenderStats.h"
 
-BasicMesh::BasicMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
-	: mTextures(textures)
+BasicMesh::BasicMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, CpuGeometry cpuGeometry)
+	: mTextures(std::move(textures)), mSamplerNames(makeSamplerNames(mTextures))
 {
 	// Create tangents and bitangents
 	for (int i = 0; i < indices.size(); i += 3)
@@ -40,36 +42,25 @@ BasicMesh::BasicMesh(std::vector<Vertex> vertices, std::vector<unsigned int> ind
 		mVertices.push_back(vertex3);
 	}
 
+	mVertexCount = mVertices.size();
 	SetupMesh();
+	if (cpuGeometry == CpuGeometry::Release)
+		std::vector<Vertex>().swap(mVertices);
 }
 
-void BasicMesh::Draw(Shader shader)
+void BasicMesh::Draw(const Shader& shader)
 {
-	/* CONVENTION: */
-	// assume that each sampler2D in the shader is called texture_<type>N,
-	// where N ranges from 1 to the maximum number of texture units allowed
-	int diffuseNum = 1, specularNum = 1, normalNum = 1, displacementNum = 1;
 	for (int i = 0; i < mTextures.size(); i++)
 	{
 		glActiveTexture(GL_TEXTURE0 + i);
-		std::string number;
-		std::string name = mTextures[i].type;
-		if (name == "texture_diffuse")
-			number = std::to_string(diffuseNum++);
-		else if (name == "texture_specular")
-			number = std::to_string(specularNum++);
-		else if (name == "texture_normal")
-			number = std::to_string(normalNum++);
-		else if (name == "texture_displacement")
-			number = std::to_string(displacementNum++);
-
-		shader.SetInt(("material." + name + number).c_str(), i);
+		shader.SetInt(mSamplerNames[i].c_str(), i);
 		glBindTexture(GL_TEXTURE_2D, mTextures[i].id);
 	}
 
 	// Draw
 	glBindVertexArray(mVAO);
-	glDrawArrays(GL_TRIANGLES, 0, mVertices.size());
+	glDrawArrays(GL_TRIANGLES, 0, mVertexCount);
+	countDraw(mVertexCount / 3);
 	glBindVertexArray(0);
 
 	glActiveTexture(GL_TEXTURE0);
@@ -77,13 +68,19 @@ void BasicMesh::Draw(Shader shader)
 
 void BasicMesh::SetupMesh()
 {
-	glGenVertexArrays(1, &mVAO);
-	glGenBuffers(1, &mVBO);
+	mBounds = AABB{ mVertices[0].Position, mVertices[0].Position };
+	for (int i = 1; i < mVertices.size(); i++)
+		mBounds = AABB{ glm::min(mBounds.min, mVertices[i].Position), glm::max(mBounds.max, mVertices[i].Position) };
+
+	mVAO = GlVertexArray::Create();
+	mVBO = GlBuffer::Create();
+	TRACK_GPU_OBJECT(GpuResourceType::VertexArray, mVAO, "basic mesh");
 
 	glBindVertexArray(mVAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * mVertices.size(), &mVertices[0], GL_STATIC_DRAW);
+	TRACK_GPU_BUFFER(mVBO, sizeof(Vertex) * mVertices.size(), "basic mesh vertices");
 
 	// Positions
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -5,13 +5,26 @@ class BasicMesh
 {
 public:
 	BasicMesh() = default;
-	BasicMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures = {});
-	void Draw(Shader shader);
+	BasicMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures = {}, CpuGeometry cpuGeometry = CpuGeometry::Release);
+	BasicMesh(const BasicMesh&) = delete;
+	BasicMesh& operator=(const BasicMesh&) = delete;
+	BasicMesh(BasicMesh&&) = default;
+	BasicMesh& operator=(BasicMesh&&) = default;
+
+	void Draw(const Shader& shader);
+	const AABB& GetBounds() const { return mBounds; }
+	const std::vector<Texture>& GetTextures() const { return mTextures; }
+	// three per triangle; empty unless the mesh was made with CpuGeometry::Keep
+	const std::vector<Vertex>& GetVertices() const { return mVertices; }
 
 private:
 	void SetupMesh();
 
 	std::vector<Vertex> mVertices;
 	std::vector<Texture> mTextures;
-	unsigned int mVAO, mVBO;
+	std::vector<std::string> mSamplerNames;
+	GlVertexArray mVAO;
+	GlBuffer mVBO;
+	unsigned int mVertexCount = 0;
+	AABB mBounds;
 };
\ No newline at end of file
@@ -12,7 +12,11 @@ Camera::Camera(float x, float y, float z, float yaw, float pitch) :
 	mLastX(0.0f),
 	mLastY(0.0f),
 	mForwardSpeed(0.0),
-	mRightSpeed(0.0f)
+	mRightSpeed(0.0f),
+	mFov(60.0f),
+	mAspectRatio(1024.0f / 720.0f),
+	mNearPlane(0.1f),
+	mFarPlane(100.0f)
 {
 	UpdateCameraVectors();
 }
@@ -27,7 +31,11 @@ Camera::Camera(glm::vec3 pos, float yaw, float pitch) :
 	mLastX(0.0f),
 	mLastY(0.0f),
 	mForwardSpeed(0.0f),
-	mRightSpeed(0.0f)
+	mRightSpeed(0.0f),
+	mFov(60.0f),
+	mAspectRatio(1024.0f / 720.0f),
+	mNearPlane(0.1f),
+	mFarPlane(100.0f)
 {
 	UpdateCameraVectors();
 }
@@ -104,6 +112,17 @@ void Camera::Update(float deltaTime)
 	UpdateCameraVectors();
 }
 
+void Camera::LookAt(const glm::vec3& position, const glm::vec3& target)
+{
+	glm::vec3 direction = glm::normalize(target - position);
+	mPosition = position;
+	mYaw = glm::degrees(atan2f(direction.z, direction.x));
+	mPitch = glm::clamp(glm::degrees(asinf(direction.y)), -89.0f, 89.0f);
+	mForwardSpeed = 0.0f;
+	mRightSpeed = 0.0f;
+	UpdateCameraVectors();
+}
+
 void Camera::UpdateCameraVectors()
 {
 	glm::vec3 worldUp(0.0f, 1.0f, 0.0f);
@@ -9,11 +9,19 @@ public:
 	Camera(float x, float y, float z, float yaw = -90.0f, float pitch = 0.0f);
 	Camera(glm::vec3 pos, float yaw = -90.0f, float pitch = 0.0f);
 	const glm::mat4 GetViewMatrix() const { return glm::lookAt(mPosition, mPosition + mFront, mUp); }
+	const glm::mat4 GetProjectionMatrix() const { return glm::perspective(glm::radians(mFov), mAspectRatio, mNearPlane, mFarPlane); }
 	void ProcessInput(GLFWwindow* window);
 	void Update(float deltaTime);
+	// places the camera directly, bypassing the input and the room bounds
+	void LookAt(const glm::vec3& position, const glm::vec3& target);
 
 	const glm::vec3& GetPosition() const { return mPosition; }
 	const glm::vec3& GetFront() const { return mFront; }
+	float GetFov() const { return mFov; }
+	float GetAspectRatio() const { return mAspectRatio; }
+	float GetNearPlane() const { return mNearPlane; }
+	float GetFarPlane() const { return mFarPlane; }
+	void SetAspectRatio(float aspectRatio) { mAspectRatio = aspectRatio; }
 
 private:
 	void UpdateCameraVectors();
@@ -39,4 +47,10 @@ private:
 
 	float mForwardSpeed;
 	float mRightSpeed;
+
+	// projection
+	float mFov;
+	float mAspectRatio;
+	float mNearPlane;
+	float mFarPlane;
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "CameraPath.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+CameraPath::CameraPath(const std::vector<CameraKey>& keys, float duration) :
+	mKeys(keys),
+	mDuration(duration)
+{
+	if (mKeys.size() < 2 || mDuration <= 0.0f)
+		std::cout << "Error::CameraPath::A path needs at least two keys and a positive duration" << std::endl;
+}
+
+CameraKey CameraPath::Evaluate(float time) const
+{
+	if (mKeys.size() < 2 || mDuration <= 0.0f)
+		return mKeys.empty() ? CameraKey{ glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) } : mKeys[0];
+
+	// the segment the time falls in, and how far along it
+	unsigned int n = mKeys.size();
+	float position = n * (time / mDuration - std::floor(time / mDuration));
+	unsigned int segment = std::min((unsigned int)position, n - 1);
+	float t = position - segment;
+
+	const CameraKey& k0 = mKeys[(segment + n - 1) % n];
+	const CameraKey& k1 = mKeys[segment];
+	const CameraKey& k2 = mKeys[(segment + 1) % n];
+	const CameraKey& k3 = mKeys[(segment + 2) % n];
+	return { catmullRom(k0.position, k1.position, k2.position, k3.position, t), catmullRom(k0.target, k1.target, k2.target, k3.target, t) };
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+// A camera position and the point it looks at
+struct CameraKey
+{
+	glm::vec3 position;
+	glm::vec3 target;
+};
+
+// A closed loop through camera keys, spaced evenly in time and joined by Catmull-Rom splines, so the camera moves
+// and turns smoothly through every key and ends where it started. Used to drive the camera in benchmark runs.
+class CameraPath
+{
+public:
+	CameraPath() = default;
+	// duration is the time one loop takes; needs at least two keys
+	CameraPath(const std::vector<CameraKey>& keys, float duration);
+
+	// time wraps round after each loop
+	CameraKey Evaluate(float time) const;
+
+private:
+	std::vector<CameraKey> mKeys;
+	float mDuration = 0.0f;
+};
\ No newline at end of file
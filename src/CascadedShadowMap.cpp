@@ -0,0 +1,134 @@
+#include "CascadedShadowMap.h"
+#include "GpuMemory.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// uniform names spelled out, so that setting them each frame doesn't build strings
+static const char* CASCADE_MATRIX_NAMES[MAX_CASCADES] = { "cascadeMatrices[0]", "cascadeMatrices[1]", "cascadeMatrices[2]", "cascadeMatrices[3]" };
+static const char* CASCADE_SPLIT_NAMES[MAX_CASCADES] = { "cascadeSplits[0]", "cascadeSplits[1]", "cascadeSplits[2]", "cascadeSplits[3]" };
+static const char* CASCADE_TEXEL_SIZE_NAMES[MAX_CASCADES] = { "cascadeTexelSizes[0]", "cascadeTexelSizes[1]", "cascadeTexelSizes[2]", "cascadeTexelSizes[3]" };
+
+CascadedShadowMap::CascadedShadowMap(unsigned int resolution, unsigned int numCascades, float shadowDistance, float splitLambda, float casterDistance) :
+	mResolution(resolution),
+	mNumCascades(std::min(numCascades, MAX_CASCADES)),
+	mShadowDistance(shadowDistance),
+	mSplitLambda(splitLambda),
+	mCasterDistance(casterDistance)
+{
+	if (numCascades > MAX_CASCADES)
+		std::cout << "Error::CascadedShadowMap::Only " << MAX_CASCADES << " cascades are supported" << std::endl;
+
+	// one layer per cascade, sampled with hardware depth comparison
+	mTexture = GlTexture::Create();
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, mResolution, mResolution, mNumCascades, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	TRACK_GPU_TEXTURE(mTexture, GL_DEPTH_COMPONENT24, mResolution, mResolution, mNumCascades, 1, false, "cascaded shadow map");
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	float borderColour[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColour);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	mFramebuffer = GlFramebuffer::Create();
+	TRACK_GPU_OBJECT(GpuResourceType::Framebuffer, mFramebuffer, "cascaded shadow map");
+	glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mTexture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Error::CascadedShadowMap::Framebuffer is incomplete" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CascadedShadowMap::Update(const Camera& camera, const glm::vec3& lightDirection)
+{
+	float nearPlane = camera.GetNearPlane();
+	float farPlane = std::min(camera.GetFarPlane(), mShadowDistance);
+
+	// practical split scheme: blend of logarithmic and uniform split distances
+	for (int i = 0; i < mNumCascades; i++)
+	{
+		float p = (float)(i + 1) / mNumCascades;
+		float logSplit = nearPlane * powf(farPlane / nearPlane, p);
+		float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+		mSplitDepths[i] = mSplitLambda * logSplit + (1.0f - mSplitLambda) * uniformSplit;
+	}
+
+	glm::mat4 inverseView = glm::inverse(camera.GetViewMatrix());
+	float tanHalfFovY = tanf(glm::radians(camera.GetFov()) * 0.5f);
+	float tanHalfFovX = tanHalfFovY * camera.GetAspectRatio();
+	glm::vec3 lightDir = glm::normalize(lightDirection);
+	glm::vec3 up = fabsf(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	for (int i = 0; i < mNumCascades; i++)
+	{
+		// corners of this cascade's slice of the view frustum in world space
+		float sliceNear = i == 0 ? nearPlane : mSplitDepths[i - 1];
+		float sliceFar = mSplitDepths[i];
+		glm::vec3 corners[8];
+		glm::vec3 centre(0.0f);
+		for (int j = 0; j < 8; j++)
+		{
+			float depth = j < 4 ? sliceNear : sliceFar;
+			float x = (j & 1) ? 1.0f : -1.0f;
+			float y = (j & 2) ? 1.0f : -1.0f;
+			corners[j] = glm::vec3(inverseView * glm::vec4(x * depth * tanHalfFovX, y * depth * tanHalfFovY, -depth, 1.0f));
+			centre += corners[j];
+		}
+		centre /= 8.0f;
+
+		// the bounding sphere's radius only depends on the slice's shape, not the camera's orientation
+		float radius = 0.0f;
+		for (int j = 0; j < 8; j++)
+			radius = std::max(radius, glm::length(corners[j] - centre));
+		radius = ceilf(radius * 16.0f) / 16.0f;
+
+		// pull the near plane back towards the light so that casters between the light and the slice are kept
+		glm::mat4 lightView = glm::lookAt(centre - lightDir * (radius + mCasterDistance), centre, up);
+		glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + mCasterDistance);
+
+		// snap the projection to whole shadow texels
+		glm::mat4 lightSpaceMatrix = lightProjection * lightView;
+		glm::vec4 origin = lightSpaceMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) * (mResolution * 0.5f);
+		glm::vec4 offset = (glm::vec4(roundf(origin.x), roundf(origin.y), 0.0f, 0.0f) - glm::vec4(origin.x, origin.y, 0.0f, 0.0f)) * (2.0f / mResolution);
+		lightProjection[3][0] += offset.x;
+		lightProjection[3][1] += offset.y;
+
+		mLightSpaceMatrices[i] = lightProjection * lightView;
+		mCascadeFrusta[i] = Frustum(mLightSpaceMatrices[i]);
+		mTexelSizes[i] = 2.0f * radius / mResolution;
+	}
+}
+
+void CascadedShadowMap::BeginCascade(unsigned int cascade, const Shader& depthShader)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mTexture, 0, cascade);
+	glViewport(0, 0, mResolution, mResolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	depthShader.SetMat4f("lightSpaceMatrix", mLightSpaceMatrices[cascade]);
+}
+
+void CascadedShadowMap::BindTexture(unsigned int unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void CascadedShadowMap::SetUniforms(const Shader& shader) const
+{
+	shader.SetInt("numCascades", mNumCascades);
+	for (int i = 0; i < mNumCascades; i++)
+	{
+		shader.SetMat4f(CASCADE_MATRIX_NAMES[i], mLightSpaceMatrices[i]);
+		shader.SetFloat(CASCADE_SPLIT_NAMES[i], mSplitDepths[i]);
+		shader.SetFloat(CASCADE_TEXEL_SIZE_NAMES[i], mTexelSizes[i]);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <glm\glm.hpp>
+#include "Camera.h"
+#include "Frustum.h"
+#include "GlObject.h"
+#include "Shader.h"
+
+// shaders/shadows.txt declares cascadeMatrices[4] and cascadeSplits[4]
+const unsigned int MAX_CASCADES = 4;
+
+// Shadow map for a directional light, split into cascades along the camera's view depth.
+// Each cascade is one layer of a depth 2D texture array fitted to a bounding sphere of its
+// slice of the camera frustum, so its size doesn't change as the camera turns, and snapped to
+// the shadow texel grid so that the shadows don't shimmer as the camera moves.
+class CascadedShadowMap
+{
+public:
+	CascadedShadowMap() = default;
+	CascadedShadowMap(unsigned int resolution, unsigned int numCascades, float shadowDistance, float splitLambda, float casterDistance);
+
+	void Update(const Camera& camera, const glm::vec3& lightDirection);
+	void BeginCascade(unsigned int cascade, const Shader& depthShader);
+	void BindTexture(unsigned int unit) const;
+	void SetUniforms(const Shader& shader) const;
+
+	unsigned int GetNumCascades() const { return mNumCascades; }
+	const Frustum& GetCascadeFrustum(unsigned int cascade) const { return mCascadeFrusta[cascade]; }
+	const glm::mat4& GetLightSpaceMatrix(unsigned int cascade) const { return mLightSpaceMatrices[cascade]; }
+
+private:
+	unsigned int mResolution = 0;
+	unsigned int mNumCascades = 0;
+	float mShadowDistance = 0.0f;
+	float mSplitLambda = 0.0f;   // 0 = uniform splits, 1 = logarithmic splits
+	float mCasterDistance = 0.0f; // how far towards the light casters outside a cascade are still caught
+
+	GlTexture mTexture;
+	GlFramebuffer mFramebuffer;
+
+	float mSplitDepths[MAX_CASCADES];
+	float mTexelSizes[MAX_CASCADES];
+	glm::mat4 mLightSpaceMatrices[MAX_CASCADES];
+	Frustum mCascadeFrusta[MAX_CASCADES];
+};
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include "CommandList.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+void CommandList::Begin(unsigned int numWorkers)
+{
+	if (mWorkerPackets.size() < numWorkers)
+		mWorkerPackets.resize(numWorkers);
+	for (WorkerPackets& worker : mWorkerPackets)
+		worker.packets.clear();
+	mPackets.clear();
+}
+
+void CommandList::Record(const DrawPacket& packet)
+{
+	mWorkerPackets[JobSystem::GetCurrentWorker()].packets.push_back(packet);
+}
+
+const std::vector<DrawPacket>& CommandList::Merge()
+{
+	for (const WorkerPackets& worker : mWorkerPackets)
+		mPackets.insert(mPackets.end(), worker.packets.begin(), worker.packets.end());
+	std::sort(mPackets.begin(), mPackets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.sortKey < b.sortKey; });
+	return mPackets;
+}
\ No newline at end of file
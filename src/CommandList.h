@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <glm\glm.hpp>
+
+// Everything the GL thread needs to issue one draw. The sort key decides the replay order.
+struct DrawPacket
+{
+	unsigned long long sortKey;
+	const glm::mat4* transform; // the scene graph's cached world matrix
+	unsigned int entity;
+	unsigned int material;
+};
+// kept small so sorting a frame's packets moves as little memory as it can
+static_assert(sizeof(DrawPacket) == 24, "DrawPacket has grown");
+
+// material (or pass specific state) in the top 16 bits, view depth in the next 24, then the entity so that
+// the order is fully determined
+inline unsigned long long makeSortKey(unsigned int state, float depth, float farPlane, unsigned int entity)
+{
+	float normalised = depth <= 0.0f ? 0.0f : (depth >= farPlane ? 1.0f : depth / farPlane);
+	unsigned long long depthBits = (unsigned long long)(normalised * 0xFFFFFF);
+	return ((unsigned long long)(state & 0xFFFF) << 48) | (depthBits << 24) | (entity & 0xFFFFFF);
+}
+
+// Draws recorded in parallel and replayed on the GL thread.
+// Jobs append packets to the list of the worker they run on, so recording needs no locks. The lists keep
+// their capacity from frame to frame, so once the scene has been seen recording doesn't allocate.
+// Merge() joins them on the GL thread and sorts by key, so the replay order doesn't depend on which
+// worker recorded what.
+class CommandList
+{
+public:
+	void Begin(unsigned int numWorkers);
+	// from a job, or the thread that called Begin()
+	void Record(const DrawPacket& packet);
+	const std::vector<DrawPacket>& Merge();
+
+	const std::vector<DrawPacket>& GetPackets() const { return mPackets; }
+
+private:
+	// padded to a cache line each so that workers recording side by side don't share one
+	struct alignas(64) WorkerPackets
+	{
+		std::vector<DrawPacket> packets;
+	};
+
+	std::vector<WorkerPackets> mWorkerPackets;
+	std::vector<DrawPacket> mPackets;
+};
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "CpuProfiler.h"
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+struct ProfileEvent
+{
+	const char* name;
+	long long start;
+	long long end;
+};
+
+// One thread's ring. Only its own thread writes; count is published after each event so a reader sees whole ones.
+struct ThreadEvents
+{
+	char name[32];
+	unsigned int id;
+	std::vector<ProfileEvent> events;
+	std::atomic<unsigned long long> count{ 0 };
+};
+
+// rings are registered once per thread and kept until exit, so traces still show threads that have finished
+static std::mutex gThreadsMutex;
+static std::vector<ThreadEvents*> gThreads;
+static thread_local ThreadEvents* tEvents = nullptr;
+
+static long long gFrameStarts[CPU_PROFILER_FRAMES];
+static unsigned long long gNumFrames = 0;
+
+long long profilerTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static ThreadEvents& getThreadEvents()
+{
+	if (!tEvents)
+	{
+		ThreadEvents* events = new ThreadEvents();
+		events->events.resize(CPU_PROFILER_EVENTS_PER_THREAD);
+		std::lock_guard<std::mutex> lock(gThreadsMutex);
+		events->id = gThreads.size();
+		std::snprintf(events->name, sizeof(events->name), "Thread %u", events->id);
+		gThreads.push_back(events);
+		tEvents = events;
+	}
+	return *tEvents;
+}
+
+CpuScope::~CpuScope()
+{
+	ThreadEvents& thread = getThreadEvents();
+	unsigned long long count = thread.count.load(std::memory_order_relaxed);
+	thread.events[count % CPU_PROFILER_EVENTS_PER_THREAD] = { mName, mStart, profilerTime() };
+	thread.count.store(count + 1, std::memory_order_release);
+}
+
+void setProfilerThreadName(const char* name)
+{
+	ThreadEvents& thread = getThreadEvents();
+	std::lock_guard<std::mutex> lock(gThreadsMutex);
+	std::snprintf(thread.name, sizeof(thread.name), "%s", name);
+}
+
+void markCpuFrame()
+{
+	gFrameStarts[gNumFrames % CPU_PROFILER_FRAMES] = profilerTime();
+	gNumFrames++;
+}
+
+// JSON strings: the names are literals from the code, but quotes and backslashes would still break the file
+static void writeJsonString(std::ostream& out, const char* text)
+{
+	out << '"';
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			out << '\\';
+		out << *c;
+	}
+	out << '"';
+}
+
+static void writeEvent(std::ostream& out, bool& first, const char* name, long long start, long long end, long long origin, unsigned int pid, unsigned int tid)
+{
+	// complete events, with times in microseconds
+	out << (first ? "\n" : ",\n") << "{\"name\":";
+	writeJsonString(out, name);
+	out << ",\"ph\":\"X\",\"ts\":" << (start - origin) / 1000.0 << ",\"dur\":" << (end - start) / 1000.0
+		<< ",\"pid\":" << pid << ",\"tid\":" << tid << "}";
+	first = false;
+}
+
+static void writeTrackName(std::ostream& out, bool& first, const char* name, unsigned int pid, unsigned int tid)
+{
+	out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"name\":";
+	writeJsonString(out, name);
+	out << "}}";
+	first = false;
+}
+
+bool writeChromeTrace(const std::string& path, unsigned int numFrames, const GpuProfiler* gpuProfiler)
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cout << "Error::CpuProfiler::Can't write " << path << std::endl;
+		return false;
+	}
+
+	// from the start of the oldest frame asked for, or of the oldest frame still known
+	numFrames = (unsigned int)std::min<unsigned long long>({ (unsigned long long)numFrames, gNumFrames, CPU_PROFILER_FRAMES });
+	long long origin = numFrames > 0 ? gFrameStarts[(gNumFrames - numFrames) % CPU_PROFILER_FRAMES] : 0;
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	std::vector<ThreadEvents*> threads;
+	{
+		std::lock_guard<std::mutex> lock(gThreadsMutex);
+		threads = gThreads;
+		for (ThreadEvents* thread : threads)
+			writeTrackName(file, first, thread->name, 1, thread->id);
+	}
+	for (ThreadEvents* thread : threads)
+	{
+		unsigned long long count = thread->count.load(std::memory_order_acquire);
+		unsigned long long oldest = count > CPU_PROFILER_EVENTS_PER_THREAD ? count - CPU_PROFILER_EVENTS_PER_THREAD : 0;
+		for (unsigned long long i = oldest; i < count; i++)
+		{
+			const ProfileEvent& event = thread->events[i % CPU_PROFILER_EVENTS_PER_THREAD];
+			if (event.end >= origin)
+				writeEvent(file, first, event.name, event.start, event.end, origin, 1, thread->id);
+		}
+	}
+
+	if (gpuProfiler)
+	{
+		std::vector<GpuTimelineEvent> gpuEvents;
+		gpuProfiler->GetTimeline(gpuEvents);
+		writeTrackName(file, first, "GPU", 2, 0);
+		for (const GpuTimelineEvent& event : gpuEvents)
+		{
+			if (event.end >= origin)
+				writeEvent(file, first, event.name, event.begin, event.end, origin, 2, 0);
+		}
+	}
+	file << "\n]}" << std::endl;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+
+class GpuProfiler;
+
+// events kept per thread; older ones are overwritten
+const unsigned int CPU_PROFILER_EVENTS_PER_THREAD = 32768;
+// frame starts kept, which bounds the frames one trace can cover
+const unsigned int CPU_PROFILER_FRAMES = 1024;
+
+// Scoped CPU timing.
+// A CpuScope records its name, start and end (steady_clock) into a ring owned by the calling thread, so
+// recording takes no locks and, once a thread's ring exists, never allocates. markCpuFrame() notes where each
+// frame starts, and writeChromeTrace() writes the events of the last few frames as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev), one track per thread, with the GPU profiler's scopes on their own track.
+// Rings are read while other threads may still write to them: a dump taken as a ring wraps can show a torn
+// event, which is fine for a diagnostic.
+
+// nanoseconds on the profiler's clock
+long long profilerTime();
+
+class CpuScope
+{
+public:
+	// name must outlive the profiler, e.g. a string literal
+	CpuScope(const char* name) : mName(name), mStart(profilerTime()) {}
+	~CpuScope();
+	CpuScope(const CpuScope&) = delete;
+	CpuScope& operator=(const CpuScope&) = delete;
+
+private:
+	const char* mName;
+	long long mStart;
+};
+
+// label for the calling thread's track in the trace
+void setProfilerThreadName(const char* name);
+// call from the main thread at the start of each frame
+void markCpuFrame();
+// the last numFrames frames; gpuProfiler (optional) adds its timeline. Returns false if the file can't be written.
+bool writeChromeTrace(const std::string& path, unsigned int numFrames, const GpuProfiler* gpuProfiler);
\ No newline at end of file
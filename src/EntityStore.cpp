@@ -0,0 +1,65 @@
+#include "EntityStore.h"
+
+unsigned int EntityStore::AddMaterial(const Material& material)
+{
+	mMaterials.push_back(material);
+	return mMaterials.size() - 1;
+}
+
+unsigned int EntityStore::CreateEntity(unsigned int node, MeshHandle mesh, ModelHandle model, unsigned int material, const AABB& localBounds, bool castsShadows)
+{
+	mNodes.push_back(node);
+	mMeshes.push_back(mesh);
+	mModels.push_back(model);
+	mMaterialIndices.push_back(material);
+	mShadowCasters.push_back(castsShadows);
+	mLocalBounds.push_back(localBounds);
+	mWorldBounds.push_back(localBounds);
+	return mNodes.size() - 1;
+}
+
+// entities per job
+static const unsigned int BATCH_SIZE = 2048;
+
+void EntityStore::UpdateBounds(const SceneGraph& sceneGraph, JobSystem& jobs)
+{
+	jobs.ParallelFor(mNodes.size(), BATCH_SIZE, [this, &sceneGraph](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++)
+			mWorldBounds[i] = transformAABB(mLocalBounds[i], sceneGraph.GetWorldMatrix(mNodes[i]));
+	});
+}
+
+void EntityStore::GatherVisible(const Frustum& frustum, std::vector<unsigned int>& drawList, JobSystem& jobs) const
+{
+	Gather([this, &frustum](unsigned int i) { return frustum.IntersectsAABB(mWorldBounds[i]); }, drawList, jobs);
+}
+
+void EntityStore::GatherShadowCasters(const std::function<bool(const AABB&)>& reachesShadowMap, std::vector<unsigned int>& drawList, JobSystem& jobs) const
+{
+	Gather([this, &reachesShadowMap](unsigned int i) { return mShadowCasters[i] && reachesShadowMap(mWorldBounds[i]); }, drawList, jobs);
+}
+
+void EntityStore::Gather(const std::function<bool(unsigned int)>& include, std::vector<unsigned int>& drawList, JobSystem& jobs) const
+{
+	// each batch fills its own stretch of the scratch list, and the stretches are joined in batch order so the
+	// result doesn't depend on scheduling; the scratch lists keep their size, so gathering doesn't allocate
+	unsigned int numEntities = mNodes.size();
+	mGatherScratch.resize(numEntities);
+	mBatchCounts.resize((numEntities + BATCH_SIZE - 1) / BATCH_SIZE);
+	jobs.ParallelFor(numEntities, BATCH_SIZE, [this, &include](unsigned int begin, unsigned int end) {
+		unsigned int count = 0;
+		for (unsigned int i = begin; i < end; i++)
+		{
+			if (include(i))
+				mGatherScratch[begin + count++] = i;
+		}
+		mBatchCounts[begin / BATCH_SIZE] = count;
+	});
+
+	drawList.clear();
+	for (unsigned int batch = 0; batch < mBatchCounts.size(); batch++)
+	{
+		const unsigned int* list = &mGatherScratch[batch * BATCH_SIZE];
+		drawList.insert(drawList.end(), list, list + mBatchCounts[batch]);
+	}
+}
\ No newline at end of file
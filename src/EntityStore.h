@@ -0,0 +1,61 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <glm\glm.hpp>
+#include "AABB.h"
+#include "Frustum.h"
+#include "SceneGraph.h"
+#include "Resources.h"
+#include "JobSystem.h"
+
+// The switches the object shaders read for a surface
+struct Material
+{
+	glm::vec2 textureScale;
+	bool normalMapping;
+	bool parallaxMapping; // parallax mapping discards fragments, so these surfaces are left out of the depth pre-pass
+	bool insideOut; // drawn with clockwise front faces
+};
+
+// Drawable objects stored as packed component arrays, one entry per entity in each.
+// An entity is its index: a scene graph node for its transform, a mesh or a model, a material,
+// whether it casts shadows, and its bounds. The systems below walk the arrays linearly, in batches
+// spread over the job system, and emit the list of entities each pass should draw in entity order,
+// so the passes contain no per-object code.
+class EntityStore
+{
+public:
+	unsigned int AddMaterial(const Material& material);
+	// exactly one of mesh and model is valid
+	unsigned int CreateEntity(unsigned int node, MeshHandle mesh, ModelHandle model, unsigned int material, const AABB& localBounds, bool castsShadows);
+
+	// world space bounds from the scene graph's cached world matrices
+	void UpdateBounds(const SceneGraph& sceneGraph, JobSystem& jobs);
+	void GatherVisible(const Frustum& frustum, std::vector<unsigned int>& drawList, JobSystem& jobs) const;
+	void GatherShadowCasters(const std::function<bool(const AABB&)>& reachesShadowMap, std::vector<unsigned int>& drawList, JobSystem& jobs) const;
+
+	unsigned int GetNode(unsigned int entity) const { return mNodes[entity]; }
+	MeshHandle GetMesh(unsigned int entity) const { return mMeshes[entity]; }
+	ModelHandle GetModel(unsigned int entity) const { return mModels[entity]; }
+	unsigned int GetMaterialIndex(unsigned int entity) const { return mMaterialIndices[entity]; }
+	const Material& GetMaterial(unsigned int entity) const { return mMaterials[mMaterialIndices[entity]]; }
+	const AABB& GetWorldBounds(unsigned int entity) const { return mWorldBounds[entity]; }
+	unsigned int GetNumEntities() const { return mNodes.size(); }
+
+private:
+	void Gather(const std::function<bool(unsigned int)>& include, std::vector<unsigned int>& drawList, JobSystem& jobs) const;
+
+	std::vector<unsigned int> mNodes;
+	std::vector<MeshHandle> mMeshes;
+	std::vector<ModelHandle> mModels;
+	std::vector<unsigned int> mMaterialIndices;
+	std::vector<unsigned char> mShadowCasters;
+	std::vector<AABB> mLocalBounds;
+	std::vector<AABB> mWorldBounds;
+
+	std::vector<Material> mMaterials;
+
+	// Gather()'s working space: the entities each batch includes, packed at the start of the batch's range
+	mutable std::vector<unsigned int> mGatherScratch;
+	mutable std::vector<unsigned int> mBatchCounts;
+};
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "Foliage.h"
+#include "GpuMemory.h"
+#include "RenderStats.h"
+#include <glad\glad.h>
+#include "stb_image.h"
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <random>
+
+Foliage::Foliage(const std::string& densityMapPath, unsigned int texture, const glm::vec2& areaMin, const glm::vec2& areaMax, unsigned int count, float minScale, float maxScale, unsigned int seed)
+	: mTexture(texture)
+{
+	std::vector<FoliageInstance> instances = Scatter(densityMapPath, areaMin, areaMax, count, minScale, maxScale, seed);
+	mInstanceCount = instances.size();
+
+	// a unit quad standing on its base: xy is the corner in the quad, zw the texture coordinates
+	float quad[] =
+	{
+		-0.5f, 0.0f, 0.0f, 0.0f,
+		 0.5f, 0.0f, 1.0f, 0.0f,
+		-0.5f, 1.0f, 0.0f, 1.0f,
+		 0.5f, 1.0f, 1.0f, 1.0f
+	};
+
+	mVAO = GlVertexArray::Create();
+	mQuadVBO = GlBuffer::Create();
+	mInstanceVBO = GlBuffer::Create();
+	TRACK_GPU_OBJECT(GpuResourceType::VertexArray, mVAO, "foliage");
+	glBindVertexArray(mVAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mQuadVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	TRACK_GPU_BUFFER(mQuadVBO, sizeof(quad), "foliage quad");
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+
+	// per instance attributes: position and scale, then the variant
+	glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(FoliageInstance), instances.data(), GL_STATIC_DRAW);
+	TRACK_GPU_BUFFER(mInstanceVBO, instances.size() * sizeof(FoliageInstance), "foliage instances");
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(FoliageInstance), (void*)offsetof(FoliageInstance, position));
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(FoliageInstance), (void*)offsetof(FoliageInstance, variant));
+	glVertexAttribDivisor(2, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Foliage::Draw(const Shader& shader) const
+{
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	shader.SetInt("foliageTexture", 0);
+
+	glBindVertexArray(mVAO);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, mInstanceCount);
+	countDraw(2ull * mInstanceCount);
+	glBindVertexArray(0);
+}
+
+std::vector<FoliageInstance> Foliage::Scatter(const std::string& densityMapPath, const glm::vec2& areaMin, const glm::vec2& areaMax, unsigned int count, float minScale, float maxScale, unsigned int seed) const
+{
+	// without a density map the plants are scattered uniformly
+	int width = 1, height = 1, numChannels;
+	unsigned char* densityMap = densityMapPath.empty() ? nullptr : stbi_load(densityMapPath.c_str(), &width, &height, &numChannels, 1);
+	if (!densityMap && !densityMapPath.empty())
+		std::cout << "Error::Foliage::Density map not loaded, scattering uniformly: " << densityMapPath << std::endl;
+
+	// rejection sampling: a random point is kept with the probability given by the density map under it.
+	// The seed keeps the layout the same from run to run.
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<FoliageInstance> instances;
+	instances.reserve(count);
+	for (unsigned int attempt = 0; attempt < 64 * count && instances.size() < count; attempt++)
+	{
+		glm::vec2 uv(unit(rng), unit(rng));
+		float density = 1.0f;
+		if (densityMap)
+		{
+			int x = std::min((int)(uv.x * width), width - 1);
+			int y = std::min((int)(uv.y * height), height - 1);
+			density = densityMap[y * width + x] / 255.0f;
+		}
+		if (unit(rng) >= density)
+			continue;
+
+		FoliageInstance instance;
+		glm::vec2 position = areaMin + uv * (areaMax - areaMin);
+		instance.position = glm::vec3(position.x, 0.0f, position.y);
+		instance.scale = minScale + (maxScale - minScale) * unit(rng);
+		instance.variant = unit(rng);
+		instances.push_back(instance);
+	}
+
+	if (densityMap)
+		stbi_image_free(densityMap);
+	return instances;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm\glm.hpp>
+#include "GlObject.h"
+#include "Shader.h"
+
+// Everything else about a plant is derived from these in shaders/foliage_vs.txt
+struct FoliageInstance
+{
+	glm::vec3 position;
+	float scale;
+	float variant; // in [0, 1): picks the plant's flip and tint, and its rank in the distance fade
+};
+
+// Plants scattered over a rectangle of the XZ plane, placed by a greyscale density map.
+// All the instances are drawn in one instanced call: the vertex shader turns each quad towards
+// the camera around its vertical axis and thins the plants out with distance, and the cut out
+// edges use alpha-to-coverage in the multisampled scene, so nothing needs sorting or blending.
+class Foliage
+{
+public:
+	Foliage() = default;
+	// densityMapPath may be empty for an even scatter; the same seed gives the same layout
+	Foliage(const std::string& densityMapPath, unsigned int texture, const glm::vec2& areaMin, const glm::vec2& areaMax, unsigned int count, float minScale, float maxScale, unsigned int seed);
+
+	void Draw(const Shader& shader) const;
+	unsigned int GetInstanceCount() const { return mInstanceCount; }
+
+private:
+	std::vector<FoliageInstance> Scatter(const std::string& densityMapPath, const glm::vec2& areaMin, const glm::vec2& areaMax, unsigned int count, float minScale, float maxScale, unsigned int seed) const;
+
+	GlVertexArray mVAO;
+	GlBuffer mQuadVBO;
+	GlBuffer mInstanceVBO;
+	unsigned int mTexture = 0; // not owned
+	unsigned int mInstanceCount = 0;
+};
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(size_t capacity)
+{
+	AddBlock(capacity);
+}
+
+void FrameArena::Reset()
+{
+	// last frame overflowed: replace the blocks with a single one that holds all of it
+	if (mBlocks.size() > 1)
+	{
+		size_t capacity = GetCapacity();
+		mBlocks.clear();
+		AddBlock(capacity);
+	}
+	mOffset = 0;
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	Block& block = mBlocks.back();
+	uintptr_t start = (uintptr_t)block.data.get();
+	uintptr_t aligned = (start + mOffset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (aligned + size > start + block.size)
+	{
+		AddBlock(std::max(2 * block.size, size + alignment));
+		return Allocate(size, alignment);
+	}
+	mOffset = aligned + size - start;
+	return (void*)aligned;
+}
+
+size_t FrameArena::GetCapacity() const
+{
+	size_t capacity = 0;
+	for (const Block& block : mBlocks)
+		capacity += block.size;
+	return capacity;
+}
+
+void FrameArena::AddBlock(size_t size)
+{
+	mBlocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+	mOffset = 0;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bump allocator for data that only lives until the end of the frame.
+// Allocate() moves a pointer through one block and Reset(), at the start of each frame, frees everything at
+// once. A frame that needs more than the block spills into extra blocks, and the next Reset() swaps them all for
+// one block big enough for that frame, so once the frames settle the arena doesn't touch the heap.
+// Not thread safe: allocate on the main thread, or before handing the memory to jobs.
+class FrameArena
+{
+public:
+	FrameArena(size_t capacity = 1024 * 1024);
+
+	void Reset();
+	// alignment must be a power of two
+	void* Allocate(size_t size, size_t alignment);
+	template<typename T>
+	T* Allocate(size_t count) { return (T*)Allocate(count * sizeof(T), alignof(T)); }
+
+	size_t GetCapacity() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		size_t size;
+	};
+
+	void AddBlock(size_t size);
+
+	std::vector<Block> mBlocks;
+	size_t mOffset = 0; // into the last block
+};
+
+// Lets standard containers take their storage from a FrameArena; memory is only given back by Reset()
+template<typename T>
+struct ArenaAllocator
+{
+	typedef T value_type;
+
+	ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return arena->Allocate<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	FrameArena* arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+// a vector that lives no longer than the current frame
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
\ No newline at end of file
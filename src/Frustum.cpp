@@ -0,0 +1,44 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// extract the clip planes from the rows of the view-projection matrix
+	glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	mPlanes[0] = row3 + row0;
+	mPlanes[1] = row3 - row0;
+	mPlanes[2] = row3 + row1;
+	mPlanes[3] = row3 - row1;
+	mPlanes[4] = row3 + row2;
+	mPlanes[5] = row3 - row2;
+
+	for (int i = 0; i < 6; i++)
+		mPlanes[i] /= glm::length(glm::vec3(mPlanes[i]));
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& centre, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(mPlanes[i]), centre) + mPlanes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::IntersectsAABB(const glm::vec3& min, const glm::vec3& max) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		// test the corner furthest along the plane normal
+		glm::vec3 positive(mPlanes[i].x >= 0.0f ? max.x : min.x,
+			mPlanes[i].y >= 0.0f ? max.y : min.y,
+			mPlanes[i].z >= 0.0f ? max.z : min.z);
+		if (glm::dot(glm::vec3(mPlanes[i]), positive) + mPlanes[i].w < 0.0f)
+			return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+#include <glm\glm.hpp>
+#include "AABB.h"
+
+class Frustum
+{
+public:
+	Frustum() = default;
+	Frustum(const glm::mat4& viewProjection);
+
+	bool IntersectsSphere(const glm::vec3& centre, float radius) const;
+	bool IntersectsAABB(const glm::vec3& min, const glm::vec3& max) const;
+	bool IntersectsAABB(const AABB& box) const { return IntersectsAABB(box.min, box.max); }
+
+private:
+	// left, right, bottom, top, near, far; normals point inwards
+	glm::vec4 mPlanes[6];
+};
\ No newline at end of file
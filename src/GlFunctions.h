@@ -0,0 +1,48 @@
+#pragma once
+#include <glad\glad.h>
+
+// Every entry point the renderer calls. Only # and ## are applied to the names: glad defines each as a macro.
+#define GL_INTERCEPTED_CORE(X) \
+	X(glActiveTexture) X(glAttachShader) X(glBeginQuery) X(glBindBuffer) X(glBindBufferRange) X(glBindFramebuffer) X(glBindTexture) \
+	X(glBindVertexArray) X(glBlendFunc) X(glBlendFuncSeparate) X(glBufferData) X(glBufferSubData) X(glCheckFramebufferStatus) X(glClear) \
+	X(glClearBufferfv) X(glClearBufferuiv) X(glClearColor) X(glClientWaitSync) X(glColorMask) X(glCompileShader) X(glCreateProgram) \
+	X(glCreateShader) X(glDeleteBuffers) X(glDeleteFramebuffers) X(glDeleteProgram) X(glDeleteQueries) X(glDeleteShader) X(glDeleteSync) \
+	X(glDeleteTextures) X(glDeleteVertexArrays) X(glDepthFunc) X(glDepthMask) X(glDisable) X(glDrawArrays) \
+	X(glDrawArraysInstanced) X(glDrawBuffer) X(glDrawBuffers) X(glDrawElements) X(glEnable) X(glEnableVertexAttribArray) \
+	X(glEndQuery) X(glFenceSync) X(glFinish) X(glFramebufferTexture) X(glFramebufferTexture2D) X(glFramebufferTextureLayer) X(glFrontFace) \
+	X(glGenBuffers) X(glGenFramebuffers) X(glGenQueries) X(glGenTextures) X(glGenVertexArrays) X(glGenerateMipmap) \
+	X(glGetInteger64v) X(glGetIntegerv) X(glGetProgramInfoLog) X(glGetProgramiv) X(glGetQueryObjectiv) \
+	X(glGetQueryObjectui64v) X(glGetShaderInfoLog) X(glGetShaderiv) X(glGetUniformBlockIndex) X(glGetUniformLocation) \
+	X(glLinkProgram) X(glMapBufferRange) X(glPixelStorei) X(glQueryCounter) X(glReadBuffer) X(glReadPixels) \
+	X(glShaderSource) X(glTexBuffer) X(glTexImage2D) X(glTexImage2DMultisample) X(glTexImage3D) X(glTexParameterfv) \
+	X(glTexParameteri) X(glUniform1f) X(glUniform1i) X(glUniform2f) X(glUniform2fv) X(glUniform3f) X(glUniform3fv) \
+	X(glUniform4f) X(glUniform4fv) X(glUniformBlockBinding) X(glUniformMatrix3fv) X(glUniformMatrix4fv) X(glUnmapBuffer) X(glUseProgram) \
+	X(glVertexAttribDivisor) X(glVertexAttribPointer) X(glViewport)
+#ifdef GL_ARB_buffer_storage
+#define GL_INTERCEPTED_BUFFER_STORAGE(X) X(glBufferStorage)
+#else
+#define GL_INTERCEPTED_BUFFER_STORAGE(X)
+#endif
+#ifdef GL_KHR_debug
+#define GL_INTERCEPTED_DEBUG(X) X(glPushDebugGroup) X(glPopDebugGroup)
+#else
+#define GL_INTERCEPTED_DEBUG(X)
+#endif
+#define GL_INTERCEPTED_FUNCTIONS(X) GL_INTERCEPTED_CORE(X) GL_INTERCEPTED_BUFFER_STORAGE(X) GL_INTERCEPTED_DEBUG(X)
+
+enum GlFunction
+{
+#define GL_FUNCTION_ID(name) GlFunction_##name,
+	GL_INTERCEPTED_FUNCTIONS(GL_FUNCTION_ID)
+#undef GL_FUNCTION_ID
+	GL_FUNCTION_COUNT
+};
+extern const char* const GL_FUNCTION_NAMES[];
+
+// A GL capture file: the magic, the version and the width and height of the window it was captured in, then a
+// record per call: its GlFunction as two bytes, then its result and arguments as they were passed, pointers as
+// eight bytes, followed by any data they pointed to. GL_CAPTURE_FRAME_END records end each frame with the time
+// since the capture began, in nanoseconds; the calls before the first are the loading.
+const char GL_CAPTURE_MAGIC[8] = { 'G', 'L', 'C', 'A', 'P', 'T', 'U', 'R' };
+const unsigned int GL_CAPTURE_VERSION = 5;
+const unsigned short GL_CAPTURE_FRAME_END = 0xffff;
\ No newline at end of file
@@ -0,0 +1,714 @@
+#include "GlInterceptor.h"
+#include "GlFunctions.h"
+#include <glad\glad.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+const char* const GL_FUNCTION_NAMES[] =
+{
+#define GL_FUNCTION_NAME(name) #name,
+	GL_INTERCEPTED_FUNCTIONS(GL_FUNCTION_NAME)
+#undef GL_FUNCTION_NAME
+};
+
+struct GlCallCounts
+{
+	unsigned long long calls = 0;
+	unsigned long long redundant = 0;
+	unsigned long long unused = 0;
+	long long nanoseconds = 0;
+};
+
+static bool gInstalled = false;
+static GlCallCounts gCounts[GL_FUNCTION_COUNT];
+static unsigned int gFrames = 0;
+
+// The shadow state: last value set under each key, so a call setting the same value again is redundant.
+// Nothing is known until it's first set, as the state could have been changed before installation.
+static std::unordered_map<unsigned long long, std::vector<unsigned char>> gState;
+static GLuint gProgram = 0;
+static GLenum gActiveTexture = GL_TEXTURE0;
+// a selection made and not yet used by anything
+static bool gVertexArrayUnused = false;
+static bool gActiveTextureUnused = false;
+
+enum StateCategory { StateUniform = 1, StateBinding, StateCapability, StateFixed };
+
+static unsigned long long stateKey(unsigned long long category, unsigned long long a, unsigned long long b = 0)
+{
+	return category << 56 | (a & 0xfffffffull) << 28 | (b & 0xfffffffull);
+}
+
+// stores the value under the key; true if it was already there
+static bool setState(unsigned long long key, const void* data, size_t size)
+{
+	std::vector<unsigned char>& value = gState[key];
+	if (value.size() == size && std::memcmp(value.data(), data, size) == 0)
+		return true;
+	value.assign((const unsigned char*)data, (const unsigned char*)data + size);
+	return false;
+}
+
+template<typename T>
+static bool setState(unsigned long long key, const T& value)
+{
+	return setState(key, &value, sizeof(value));
+}
+
+static bool setUniform(GLint location, const void* data, size_t size)
+{
+	// location -1 is silently ignored by GL, so setting it is always wasted
+	return location < 0 || setState(stateKey(StateUniform, gProgram, location), data, size);
+}
+
+// Per entry point state tracking: returns whether the call changes nothing
+template<int Id, typename... A>
+static bool trackState(A...) { return false; }
+
+template<> bool trackState<GlFunction_glUseProgram>(GLuint program)
+{
+	bool redundant = setState(stateKey(StateBinding, GL_CURRENT_PROGRAM), program);
+	gProgram = program;
+	return redundant;
+}
+
+template<> bool trackState<GlFunction_glLinkProgram>(GLuint program)
+{
+	// linking resets the program's uniforms
+	for (auto it = gState.begin(); it != gState.end();)
+		it = it->first >> 56 == StateUniform && (it->first >> 28 & 0xfffffffull) == program ? gState.erase(it) : ++it;
+	return false;
+}
+
+// Deleting objects unbinds them, and a name freed can come back from the next glGen, so whatever was bound is
+// no longer known. Deletes are rare enough to just forget every binding.
+static void forgetBindings()
+{
+	for (auto it = gState.begin(); it != gState.end();)
+		it = it->first >> 56 == StateBinding ? gState.erase(it) : ++it;
+}
+
+template<> bool trackState<GlFunction_glDeleteBuffers>(GLsizei, const GLuint*) { forgetBindings(); return false; }
+template<> bool trackState<GlFunction_glDeleteTextures>(GLsizei, const GLuint*) { forgetBindings(); return false; }
+template<> bool trackState<GlFunction_glDeleteVertexArrays>(GLsizei, const GLuint*) { forgetBindings(); return false; }
+template<> bool trackState<GlFunction_glDeleteFramebuffers>(GLsizei, const GLuint*) { forgetBindings(); return false; }
+
+template<> bool trackState<GlFunction_glDeleteProgram>(GLuint program)
+{
+	// its name can be reused by a new program, with uniforms of its own
+	trackState<GlFunction_glLinkProgram>(program);
+	forgetBindings();
+	return false;
+}
+
+template<> bool trackState<GlFunction_glBindVertexArray>(GLuint array)
+{
+	bool redundant = setState(stateKey(StateBinding, GL_VERTEX_ARRAY_BINDING), array);
+	if (!redundant && gVertexArrayUnused)
+		gCounts[GlFunction_glBindVertexArray].unused++;
+	gVertexArrayUnused = !redundant || gVertexArrayUnused;
+	return redundant;
+}
+
+template<> bool trackState<GlFunction_glActiveTexture>(GLenum texture)
+{
+	bool redundant = setState(stateKey(StateBinding, GL_ACTIVE_TEXTURE), texture);
+	if (!redundant && gActiveTextureUnused)
+		gCounts[GlFunction_glActiveTexture].unused++;
+	gActiveTextureUnused = !redundant || gActiveTextureUnused;
+	gActiveTexture = texture;
+	return redundant;
+}
+
+template<> bool trackState<GlFunction_glBindTexture>(GLenum target, GLuint texture)
+{
+	return setState(stateKey(StateBinding, target, gActiveTexture), texture);
+}
+
+template<> bool trackState<GlFunction_glBindFramebuffer>(GLenum target, GLuint framebuffer)
+{
+	if (target != GL_FRAMEBUFFER)
+		return setState(stateKey(StateBinding, target), framebuffer);
+	bool draw = setState(stateKey(StateBinding, GL_DRAW_FRAMEBUFFER), framebuffer);
+	bool read = setState(stateKey(StateBinding, GL_READ_FRAMEBUFFER), framebuffer);
+	return draw && read;
+}
+
+template<> bool trackState<GlFunction_glBindBuffer>(GLenum target, GLuint buffer)
+{
+	// the element array binding belongs to the vertex array, so it isn't tracked, and setting it uses the vertex array.
+	// Other targets are context state: binding a uniform or pixel buffer doesn't need the vertex array bound first.
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		gVertexArrayUnused = false;
+		return false;
+	}
+	return setState(stateKey(StateBinding, target), buffer);
+}
+
+template<> bool trackState<GlFunction_glBindBufferRange>(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	// also binds the buffer to the target's general binding point
+	setState(stateKey(StateBinding, target), buffer);
+	long long range[3] = { buffer, (long long)offset, (long long)size };
+	return setState(stateKey(StateBinding, target, index + 1), range);
+}
+
+template<> bool trackState<GlFunction_glEnable>(GLenum cap)
+{
+	return setState(stateKey(StateCapability, cap), true);
+}
+
+template<> bool trackState<GlFunction_glDisable>(GLenum cap)
+{
+	return setState(stateKey(StateCapability, cap), false);
+}
+
+template<> bool trackState<GlFunction_glDepthMask>(GLboolean flag)
+{
+	return setState(stateKey(StateFixed, GL_DEPTH_WRITEMASK), flag);
+}
+
+template<> bool trackState<GlFunction_glDepthFunc>(GLenum func)
+{
+	return setState(stateKey(StateFixed, GL_DEPTH_FUNC), func);
+}
+
+template<> bool trackState<GlFunction_glFrontFace>(GLenum mode)
+{
+	return setState(stateKey(StateFixed, GL_FRONT_FACE), mode);
+}
+
+template<> bool trackState<GlFunction_glColorMask>(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	GLboolean mask[4] = { red, green, blue, alpha };
+	return setState(stateKey(StateFixed, GL_COLOR_WRITEMASK), mask);
+}
+
+// both set the same four factors, so either can make the other redundant
+template<> bool trackState<GlFunction_glBlendFunc>(GLenum sfactor, GLenum dfactor)
+{
+	GLenum factors[4] = { sfactor, dfactor, sfactor, dfactor };
+	return setState(stateKey(StateFixed, GL_BLEND_SRC_RGB), factors);
+}
+
+template<> bool trackState<GlFunction_glBlendFuncSeparate>(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha)
+{
+	GLenum factors[4] = { srcRGB, dstRGB, srcAlpha, dstAlpha };
+	return setState(stateKey(StateFixed, GL_BLEND_SRC_RGB), factors);
+}
+
+template<> bool trackState<GlFunction_glViewport>(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint viewport[4] = { x, y, width, height };
+	return setState(stateKey(StateFixed, GL_VIEWPORT), viewport);
+}
+
+template<> bool trackState<GlFunction_glClearColor>(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	GLfloat colour[4] = { red, green, blue, alpha };
+	return setState(stateKey(StateFixed, GL_COLOR_CLEAR_VALUE), colour);
+}
+
+template<> bool trackState<GlFunction_glUniform1i>(GLint location, GLint v0)
+{
+	return setUniform(location, &v0, sizeof(v0));
+}
+
+template<> bool trackState<GlFunction_glUniform1f>(GLint location, GLfloat v0)
+{
+	return setUniform(location, &v0, sizeof(v0));
+}
+
+template<> bool trackState<GlFunction_glUniform2f>(GLint location, GLfloat v0, GLfloat v1)
+{
+	GLfloat value[2] = { v0, v1 };
+	return setUniform(location, value, sizeof(value));
+}
+
+template<> bool trackState<GlFunction_glUniform3f>(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+	GLfloat value[3] = { v0, v1, v2 };
+	return setUniform(location, value, sizeof(value));
+}
+
+template<> bool trackState<GlFunction_glUniform4f>(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+	GLfloat value[4] = { v0, v1, v2, v3 };
+	return setUniform(location, value, sizeof(value));
+}
+
+template<> bool trackState<GlFunction_glUniform2fv>(GLint location, GLsizei count, const GLfloat* value)
+{
+	return setUniform(location, value, count * 2 * sizeof(GLfloat));
+}
+
+template<> bool trackState<GlFunction_glUniform3fv>(GLint location, GLsizei count, const GLfloat* value)
+{
+	return setUniform(location, value, count * 3 * sizeof(GLfloat));
+}
+
+template<> bool trackState<GlFunction_glUniform4fv>(GLint location, GLsizei count, const GLfloat* value)
+{
+	return setUniform(location, value, count * 4 * sizeof(GLfloat));
+}
+
+template<> bool trackState<GlFunction_glUniformMatrix3fv>(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	// a transposed upload is a different value, so it's kept apart
+	return setUniform(transpose ? -1 : location, value, count * 9 * sizeof(GLfloat)) && !transpose;
+}
+
+template<> bool trackState<GlFunction_glUniformMatrix4fv>(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	return setUniform(transpose ? -1 : location, value, count * 16 * sizeof(GLfloat)) && !transpose;
+}
+
+// calls that use the vertex array or active texture selected before them
+static void noteUse(int id)
+{
+	switch (id)
+	{
+	case GlFunction_glDrawArrays:
+	case GlFunction_glDrawArraysInstanced:
+	case GlFunction_glDrawElements:
+	case GlFunction_glVertexAttribPointer:
+	case GlFunction_glEnableVertexAttribArray:
+	case GlFunction_glVertexAttribDivisor:
+		gVertexArrayUnused = false;
+		break;
+	case GlFunction_glBindTexture:
+	case GlFunction_glTexParameteri:
+	case GlFunction_glTexParameterfv:
+	case GlFunction_glTexImage2D:
+	case GlFunction_glTexImage2DMultisample:
+	case GlFunction_glTexImage3D:
+	case GlFunction_glGenerateMipmap:
+	case GlFunction_glTexBuffer:
+		gActiveTextureUnused = false;
+		break;
+	}
+}
+
+
+// Times the call it lives across
+class GlCallTimer
+{
+public:
+	GlCallTimer(int id) : mId(id), mStart(std::chrono::steady_clock::now()) {}
+	~GlCallTimer() { gCounts[mId].nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStart).count(); }
+
+private:
+	int mId;
+	std::chrono::steady_clock::time_point mStart;
+};
+
+// The capture being written, if any
+struct GlCapture
+{
+	std::ofstream file;
+	std::vector<unsigned char> buffer; // the current frame's records, written out at the end of the frame
+	bool active = false;
+	bool loading = true;
+	unsigned int framesLeft = 0;
+	std::chrono::steady_clock::time_point start;
+	GLint unpackAlignment = 4;
+};
+static GlCapture gCapture;
+
+static void writeBytes(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	gCapture.buffer.insert(gCapture.buffer.end(), bytes, bytes + size);
+}
+
+template<typename T>
+static void writeArg(T value)
+{
+	writeBytes(&value, sizeof(value));
+}
+
+template<typename T>
+static void writeArg(T* pointer)
+{
+	unsigned long long address = (unsigned long long)(uintptr_t)pointer;
+	writeBytes(&address, sizeof(address));
+}
+
+// data a pointer argument points to: its size, ~0 for a null pointer, then the bytes
+static void writeBlob(const void* data, size_t size)
+{
+	unsigned long long blobSize = data ? size : ~0ull;
+	writeBytes(&blobSize, sizeof(blobSize));
+	if (data)
+		writeBytes(data, size);
+}
+
+// bytes of a glTexImage upload under the current unpack alignment
+static size_t imageSize(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type)
+{
+	size_t components = 1;
+	if (format == GL_RG)
+		components = 2;
+	else if (format == GL_RGB || format == GL_BGR)
+		components = 3;
+	else if (format == GL_RGBA || format == GL_BGRA)
+		components = 4;
+	size_t componentSize = 1;
+	if (type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT)
+		componentSize = 2;
+	else if (type == GL_INT || type == GL_UNSIGNED_INT || type == GL_FLOAT || type == GL_UNSIGNED_INT_24_8)
+		componentSize = 4;
+	else if (type == GL_FLOAT_32_UNSIGNED_INT_24_8_REV)
+		componentSize = 8;
+	size_t alignment = gCapture.unpackAlignment;
+	size_t rowSize = (width * components * componentSize + alignment - 1) / alignment * alignment;
+	return rowSize * height * depth;
+}
+
+// Per entry point capture: the record header, the result if there is one, the arguments, then the data behind them
+template<typename... A>
+static void writeRecord(int id, A... args)
+{
+	writeArg((unsigned short)id);
+	int expand[] = { 0, (writeArg(args), 0)... };
+	(void)expand;
+}
+
+template<int Id, typename... A>
+static void captureCall(A... args)
+{
+	writeRecord(Id, args...);
+}
+
+template<> void captureCall<GlFunction_glPixelStorei>(GLenum pname, GLint param)
+{
+	if (pname == GL_UNPACK_ALIGNMENT)
+		gCapture.unpackAlignment = param;
+	writeRecord(GlFunction_glPixelStorei, pname, param);
+}
+
+template<> void captureCall<GlFunction_glBufferData>(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	writeRecord(GlFunction_glBufferData, target, size, data, usage);
+	writeBlob(data, size);
+}
+
+template<> void captureCall<GlFunction_glBufferSubData>(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	writeRecord(GlFunction_glBufferSubData, target, offset, size, data);
+	writeBlob(data, size);
+}
+
+#ifdef GL_ARB_buffer_storage
+template<> void captureCall<GlFunction_glBufferStorage>(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags)
+{
+	writeRecord(GlFunction_glBufferStorage, target, size, data, flags);
+	writeBlob(data, size);
+}
+#endif
+
+template<> void captureCall<GlFunction_glTexImage2D>(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	writeRecord(GlFunction_glTexImage2D, target, level, internalformat, width, height, border, format, type, pixels);
+	writeBlob(pixels, imageSize(width, height, 1, format, type));
+}
+
+template<> void captureCall<GlFunction_glTexImage3D>(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	writeRecord(GlFunction_glTexImage3D, target, level, internalformat, width, height, depth, border, format, type, pixels);
+	writeBlob(pixels, imageSize(width, height, depth, format, type));
+}
+
+template<> void captureCall<GlFunction_glShaderSource>(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length)
+{
+	writeRecord(GlFunction_glShaderSource, shader, count, string, length);
+	for (GLsizei i = 0; i < count; i++)
+		writeBlob(string[i], length && length[i] >= 0 ? length[i] : std::strlen(string[i]));
+}
+
+template<> void captureCall<GlFunction_glUniform2fv>(GLint location, GLsizei count, const GLfloat* value)
+{
+	writeRecord(GlFunction_glUniform2fv, location, count, value);
+	writeBlob(value, count * 2 * sizeof(GLfloat));
+}
+
+template<> void captureCall<GlFunction_glUniform3fv>(GLint location, GLsizei count, const GLfloat* value)
+{
+	writeRecord(GlFunction_glUniform3fv, location, count, value);
+	writeBlob(value, count * 3 * sizeof(GLfloat));
+}
+
+template<> void captureCall<GlFunction_glUniform4fv>(GLint location, GLsizei count, const GLfloat* value)
+{
+	writeRecord(GlFunction_glUniform4fv, location, count, value);
+	writeBlob(value, count * 4 * sizeof(GLfloat));
+}
+
+template<> void captureCall<GlFunction_glUniformMatrix3fv>(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	writeRecord(GlFunction_glUniformMatrix3fv, location, count, transpose, value);
+	writeBlob(value, count * 9 * sizeof(GLfloat));
+}
+
+template<> void captureCall<GlFunction_glUniformMatrix4fv>(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	writeRecord(GlFunction_glUniformMatrix4fv, location, count, transpose, value);
+	writeBlob(value, count * 16 * sizeof(GLfloat));
+}
+
+template<> void captureCall<GlFunction_glDrawBuffers>(GLsizei n, const GLenum* bufs)
+{
+	writeRecord(GlFunction_glDrawBuffers, n, bufs);
+	writeBlob(bufs, n * sizeof(GLenum));
+}
+
+template<> void captureCall<GlFunction_glClearBufferfv>(GLenum buffer, GLint drawbuffer, const GLfloat* value)
+{
+	writeRecord(GlFunction_glClearBufferfv, buffer, drawbuffer, value);
+	writeBlob(value, (buffer == GL_COLOR ? 4 : 1) * sizeof(GLfloat));
+}
+
+template<> void captureCall<GlFunction_glClearBufferuiv>(GLenum buffer, GLint drawbuffer, const GLuint* value)
+{
+	writeRecord(GlFunction_glClearBufferuiv, buffer, drawbuffer, value);
+	writeBlob(value, 4 * sizeof(GLuint));
+}
+
+template<> void captureCall<GlFunction_glTexParameterfv>(GLenum target, GLenum pname, const GLfloat* params)
+{
+	writeRecord(GlFunction_glTexParameterfv, target, pname, params);
+	writeBlob(params, (pname == GL_TEXTURE_BORDER_COLOR ? 4 : 1) * sizeof(GLfloat));
+}
+
+#ifdef GL_KHR_debug
+template<> void captureCall<GlFunction_glPushDebugGroup>(GLenum source, GLuint id, GLsizei length, const GLchar* message)
+{
+	writeRecord(GlFunction_glPushDebugGroup, source, id, length, message);
+	writeBlob(message, (length >= 0 ? length : std::strlen(message)) + 1);
+}
+#endif
+
+template<> void captureCall<GlFunction_glGetUniformLocation>(GLint result, GLuint program, const GLchar* name)
+{
+	writeRecord(GlFunction_glGetUniformLocation, result, program, name);
+	writeBlob(name, std::strlen(name) + 1);
+}
+
+template<> void captureCall<GlFunction_glGetUniformBlockIndex>(GLuint result, GLuint program, const GLchar* uniformBlockName)
+{
+	writeRecord(GlFunction_glGetUniformBlockIndex, result, program, uniformBlockName);
+	writeBlob(uniformBlockName, std::strlen(uniformBlockName) + 1);
+}
+
+// the names generated, so that a replay can map them to its own
+#define GL_CAPTURE_GEN(name) \
+template<> void captureCall<GlFunction_##name>(GLsizei n, GLuint* names) \
+{ \
+	writeRecord(GlFunction_##name, n, names); \
+	writeBlob(names, n * sizeof(GLuint)); \
+}
+GL_CAPTURE_GEN(glGenBuffers)
+GL_CAPTURE_GEN(glGenTextures)
+GL_CAPTURE_GEN(glGenVertexArrays)
+GL_CAPTURE_GEN(glGenFramebuffers)
+GL_CAPTURE_GEN(glGenQueries)
+#undef GL_CAPTURE_GEN
+
+// the names deleted, so that a replay deletes its own and forgets the mapping
+#define GL_CAPTURE_DELETE(name) \
+template<> void captureCall<GlFunction_##name>(GLsizei n, const GLuint* names) \
+{ \
+	writeRecord(GlFunction_##name, n, names); \
+	writeBlob(names, n * sizeof(GLuint)); \
+}
+GL_CAPTURE_DELETE(glDeleteBuffers)
+GL_CAPTURE_DELETE(glDeleteTextures)
+GL_CAPTURE_DELETE(glDeleteVertexArrays)
+GL_CAPTURE_DELETE(glDeleteFramebuffers)
+GL_CAPTURE_DELETE(glDeleteQueries)
+#undef GL_CAPTURE_DELETE
+
+// Makes the call, timed, and captures it afterwards so that what it returned is known
+template<int Id, typename R>
+struct GlInvoke
+{
+	template<typename... A>
+	static R Call(R (APIENTRY* function)(A...), A... args)
+	{
+		R result;
+		{
+			GlCallTimer timer(Id);
+			result = function(args...);
+		}
+		if (gCapture.active)
+			captureCall<Id>(result, args...);
+		return result;
+	}
+};
+
+template<int Id>
+struct GlInvoke<Id, void>
+{
+	template<typename... A>
+	static void Call(void (APIENTRY* function)(A...), A... args)
+	{
+		{
+			GlCallTimer timer(Id);
+			function(args...);
+		}
+		if (gCapture.active)
+			captureCall<Id>(args...);
+	}
+};
+
+// The wrapper for one entry point, which keeps the driver's function pointer it replaced
+template<int Id, typename F>
+struct GlHook;
+
+template<int Id, typename R, typename... A>
+struct GlHook<Id, R (APIENTRY*)(A...)>
+{
+	static R (APIENTRY* original)(A...);
+
+	static R APIENTRY Call(A... args)
+	{
+		GlCallCounts& counts = gCounts[Id];
+		counts.calls++;
+		if (trackState<Id>(args...))
+			counts.redundant++;
+		noteUse(Id);
+		return GlInvoke<Id, R>::Call(original, args...);
+	}
+};
+
+template<int Id, typename R, typename... A>
+R (APIENTRY* GlHook<Id, R (APIENTRY*)(A...)>::original)(A...) = nullptr;
+
+void installGlInterceptor()
+{
+	if (gInstalled)
+		return;
+	// entry points the driver doesn't have are left null
+#define GL_INSTALL_HOOK(name) \
+	if (glad_##name) \
+	{ \
+		GlHook<GlFunction_##name, decltype(glad_##name)>::original = glad_##name; \
+		glad_##name = &GlHook<GlFunction_##name, decltype(glad_##name)>::Call; \
+	}
+	GL_INTERCEPTED_FUNCTIONS(GL_INSTALL_HOOK)
+#undef GL_INSTALL_HOOK
+	gInstalled = true;
+}
+
+bool isGlInterceptorInstalled()
+{
+	return gInstalled;
+}
+
+bool startGlCapture(const std::string& path, unsigned int frames, int width, int height)
+{
+	installGlInterceptor();
+	gCapture.file.open(path, std::ios::binary);
+	if (!gCapture.file)
+	{
+		std::cout << "Error::GlInterceptor::Can't write the capture to " << path << std::endl;
+		return false;
+	}
+	gCapture.file.write(GL_CAPTURE_MAGIC, sizeof(GL_CAPTURE_MAGIC));
+	unsigned int header[3] = { GL_CAPTURE_VERSION, (unsigned int)width, (unsigned int)height };
+	gCapture.file.write((const char*)header, sizeof(header));
+	gCapture.active = true;
+	gCapture.loading = true;
+	gCapture.framesLeft = frames;
+	gCapture.start = std::chrono::steady_clock::now();
+	return true;
+}
+
+static void writeFrameEnd()
+{
+	long long time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - gCapture.start).count();
+	writeArg(GL_CAPTURE_FRAME_END);
+	writeArg(time);
+	gCapture.file.write((const char*)gCapture.buffer.data(), gCapture.buffer.size());
+	gCapture.buffer.clear();
+}
+
+void beginGlInterceptorFrames()
+{
+	for (GlCallCounts& counts : gCounts)
+		counts = GlCallCounts();
+	gFrames = 0;
+	// the loading is replayed untimed, ahead of the frames
+	if (gCapture.active && gCapture.loading)
+	{
+		writeFrameEnd();
+		gCapture.loading = false;
+	}
+}
+
+void endGlInterceptorFrame()
+{
+	if (!gInstalled)
+		return;
+	gFrames++;
+	if (gCapture.active && !gCapture.loading)
+	{
+		writeFrameEnd();
+		if (--gCapture.framesLeft == 0)
+		{
+			gCapture.active = false;
+			gCapture.file.close();
+			std::cout << "GL capture finished" << std::endl;
+		}
+	}
+}
+
+void dumpGlInterceptor(std::ostream& out, unsigned int top)
+{
+	if (!gInstalled || gFrames == 0)
+		return;
+
+	std::vector<int> order;
+	GlCallCounts total;
+	for (int i = 0; i < GL_FUNCTION_COUNT; i++)
+	{
+		if (gCounts[i].calls > 0)
+			order.push_back(i);
+		total.calls += gCounts[i].calls;
+		total.redundant += gCounts[i].redundant;
+		total.unused += gCounts[i].unused;
+		total.nanoseconds += gCounts[i].nanoseconds;
+	}
+	std::sort(order.begin(), order.end(), [](int a, int b) { return gCounts[a].nanoseconds > gCounts[b].nanoseconds; });
+	order.resize(std::min((size_t)top, order.size()));
+
+	double frames = gFrames;
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1);
+	out << "GL calls per frame over " << gFrames << " frames: " << total.calls / frames << " calls, " << total.redundant / frames << " redundant, "
+		<< total.unused / frames << " unused, " << total.nanoseconds / frames / 1000.0 << " us in GL" << std::endl;
+	out << "  " << std::left << std::setw(28) << "entry point" << std::right << std::setw(10) << "calls" << std::setw(11) << "redundant"
+		<< std::setw(9) << "unused" << std::setw(10) << "us" << std::setw(12) << "ns/call" << std::endl;
+	for (int i : order)
+	{
+		const GlCallCounts& counts = gCounts[i];
+		out << "  " << std::left << std::setw(28) << GL_FUNCTION_NAMES[i] << std::right << std::setw(10) << counts.calls / frames
+			<< std::setw(11) << counts.redundant / frames << std::setw(9) << counts.unused / frames << std::setw(10) << counts.nanoseconds / frames / 1000.0
+			<< std::setw(12) << (double)counts.nanoseconds / counts.calls << std::endl;
+	}
+	out.flags(flags);
+	out.precision(precision);
+
+	for (GlCallCounts& counts : gCounts)
+		counts = GlCallCounts();
+	gFrames = 0;
+}
\ No newline at end of file
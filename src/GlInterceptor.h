@@ -0,0 +1,24 @@
+#pragma once
+#include <ostream>
+#include <string>
+
+// Optional wrappers over the glad function pointers that count GL calls.
+// installGlInterceptor() swaps each entry point the renderer uses for a wrapper that counts the call, times it
+// and checks it against a shadow copy of the GL state: a bind, enable or uniform set that doesn't change anything
+// counts as redundant, and a vertex array or active texture selection replaced before anything used it counts as
+// unused. Until it's installed the GL calls go straight to the driver, so it costs nothing when off.
+// GL thread only.
+
+// call once, straight after gladLoadGLLoader
+void installGlInterceptor();
+bool isGlInterceptorInstalled();
+// Records every intercepted call, with the data uploaded, from now until the given number of frames have ended.
+// Call straight after gladLoadGLLoader, so that the capture holds the loading as well; see GlFunctions.h for
+// the format and GlReplay.h to play it back. Installs the interceptor.
+bool startGlCapture(const std::string& path, unsigned int frames, int width, int height);
+// call once loading is done, before the first frame: drops the loading from the counts, and ends the capture's loading
+void beginGlInterceptorFrames();
+// call at the end of each frame
+void endGlInterceptorFrame();
+// per frame averages since the last dump, for the top entry points by time spent in them; then starts again
+void dumpGlInterceptor(std::ostream& out, unsigned int top);
\ No newline at end of file
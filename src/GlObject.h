@@ -0,0 +1,92 @@
+#pragma once
+#include <glad\glad.h>
+#include "GpuMemory.h"
+
+// Sole owner of one GL object: the object is deleted, and dropped from the GPU memory tracker, when its owner is
+// destroyed or given another object. Move only, so a wrapper holding one (a Mesh pushed into a vector, say) can't
+// end up with two copies that both think they own it; moving hands the name over and leaves the source empty.
+// Converts to the name, so it can be passed straight to GL. Destroy it, like any GL call, with the context current.
+template<typename Traits>
+class GlObject
+{
+public:
+	GlObject() = default;
+	explicit GlObject(unsigned int id) : mID(id) {}
+	~GlObject() { Reset(); }
+	GlObject(const GlObject&) = delete;
+	GlObject& operator=(const GlObject&) = delete;
+	GlObject(GlObject&& other) noexcept : mID(other.Release()) {}
+	GlObject& operator=(GlObject&& other) noexcept
+	{
+		if (this != &other)
+			Reset(other.Release());
+		return *this;
+	}
+
+	static GlObject Create() { return GlObject(Traits::Create()); }
+
+	operator unsigned int() const { return mID; }
+	unsigned int Get() const { return mID; }
+	// gives the object up without deleting it
+	unsigned int Release()
+	{
+		unsigned int id = mID;
+		mID = 0;
+		return id;
+	}
+	// deletes the object owned, if any, and takes id instead
+	void Reset(unsigned int id = 0)
+	{
+		if (mID != 0)
+		{
+			untrackGpuResource(Traits::type, mID);
+			Traits::Delete(mID);
+		}
+		mID = id;
+	}
+
+private:
+	unsigned int mID = 0;
+};
+
+struct GlBufferTraits
+{
+	static const GpuResourceType type = GpuResourceType::Buffer;
+	static unsigned int Create() { unsigned int id = 0; glGenBuffers(1, &id); return id; }
+	static void Delete(unsigned int id) { glDeleteBuffers(1, &id); }
+};
+
+struct GlVertexArrayTraits
+{
+	static const GpuResourceType type = GpuResourceType::VertexArray;
+	static unsigned int Create() { unsigned int id = 0; glGenVertexArrays(1, &id); return id; }
+	static void Delete(unsigned int id) { glDeleteVertexArrays(1, &id); }
+};
+
+// any texture target: 2D, multisample and cube map textures are all deleted the same way
+struct GlTextureTraits
+{
+	static const GpuResourceType type = GpuResourceType::Texture;
+	static unsigned int Create() { unsigned int id = 0; glGenTextures(1, &id); return id; }
+	static void Delete(unsigned int id) { glDeleteTextures(1, &id); }
+};
+
+struct GlFramebufferTraits
+{
+	static const GpuResourceType type = GpuResourceType::Framebuffer;
+	static unsigned int Create() { unsigned int id = 0; glGenFramebuffers(1, &id); return id; }
+	static void Delete(unsigned int id) { glDeleteFramebuffers(1, &id); }
+};
+
+struct GlProgramTraits
+{
+	static const GpuResourceType type = GpuResourceType::Program;
+	static unsigned int Create() { return glCreateProgram(); }
+	static void Delete(unsigned int id) { glDeleteProgram(id); }
+};
+
+typedef GlObject<GlBufferTraits> GlBuffer;
+typedef GlObject<GlVertexArrayTraits> GlVertexArray;
+typedef GlObject<GlTextureTraits> GlTexture;
+typedef GlObject<GlFramebufferTraits> GlFramebuffer;
+typedef GlObject<GlProgramTraits> GlProgram;
\ No newline at end of file
@@ -0,0 +1,617 @@
+#include "GlReplay.h"
+#include "GlFunctions.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The capture, read whole into memory so that parsing it costs little next to the GL calls
+class GlReader
+{
+public:
+	GlReader(std::vector<unsigned char>&& data) : mData(std::move(data)) {}
+
+	bool AtEnd() const { return mOffset >= mData.size(); }
+	template<typename T>
+	T Read()
+	{
+		// a truncated file reads as zeroes rather than past the end
+		T value = T();
+		if (const unsigned char* data = Take(sizeof(T)))
+			std::memcpy(&value, data, sizeof(T));
+		return value;
+	}
+	// data behind a pointer argument: null for a null pointer
+	const void* ReadBlob()
+	{
+		size_t size;
+		return ReadBlob(size);
+	}
+	const void* ReadBlob(size_t& size)
+	{
+		unsigned long long recorded = Read<unsigned long long>();
+		size = recorded == ~0ull ? 0 : (size_t)recorded;
+		return recorded == ~0ull ? nullptr : Take(size);
+	}
+
+	// a blob of values, copied out to where they are aligned for their type; valid until the next call
+	template<typename T>
+	const T* ReadArray()
+	{
+		size_t size;
+		const void* data = ReadBlob(size);
+		if (!data)
+			return nullptr;
+		mAligned.resize((size + sizeof(double) - 1) / sizeof(double));
+		std::memcpy(mAligned.data(), data, size);
+		return (const T*)mAligned.data();
+	}
+
+private:
+	const unsigned char* Take(size_t size)
+	{
+		if (size > mData.size() - mOffset)
+		{
+			mOffset = mData.size();
+			return nullptr;
+		}
+		const unsigned char* data = mData.data() + mOffset;
+		mOffset += size;
+		return data;
+	}
+
+	std::vector<unsigned char> mData;
+	size_t mOffset = 0;
+	std::vector<double> mAligned;
+};
+
+// Recorded object names and their counterparts in the replay; 0 stays 0
+class GlNameMap
+{
+public:
+	void Add(unsigned long long recorded, unsigned long long actual) { mNames[recorded] = actual; }
+	// once deleted, the recorded name may be generated again for another object
+	void Remove(unsigned long long recorded) { mNames.erase(recorded); }
+	unsigned long long operator()(unsigned long long recorded) const
+	{
+		auto it = mNames.find(recorded);
+		return it != mNames.end() ? it->second : recorded;
+	}
+
+private:
+	std::unordered_map<unsigned long long, unsigned long long> mNames;
+};
+
+static GlNameMap gBuffers, gTextures, gVertexArrays, gFramebuffers, gQueries, gPrograms, gShaders;
+// keyed by the recorded program in the high half and the recorded location or index in the low
+static GlNameMap gUniformLocations, gUniformBlocks;
+static std::unordered_map<unsigned long long, GLsync> gSyncs;
+static GLuint gRecordedProgram = 0;
+// where calls that return data through a pointer write it
+static unsigned char gScratch[64 * 1024];
+
+static unsigned long long programKey(GLuint program, GLint index)
+{
+	return (unsigned long long)program << 32 | (unsigned int)index;
+}
+
+static GLint uniformLocation(GLint recorded)
+{
+	return recorded < 0 ? recorded : (GLint)gUniformLocations(programKey(gRecordedProgram, recorded));
+}
+
+// Reads one argument: values as they were written, pointers written as addresses turned back into offsets,
+// output pointers aimed at the scratch space, and syncs mapped to the replay's
+template<typename T>
+struct GlArg
+{
+	static T Read(GlReader& in) { return in.Read<T>(); }
+};
+
+template<typename T>
+struct GlArg<const T*>
+{
+	static const T* Read(GlReader& in) { return (const T*)(uintptr_t)in.Read<unsigned long long>(); }
+};
+
+template<typename T>
+struct GlArg<T*>
+{
+	static T* Read(GlReader& in)
+	{
+		in.Read<unsigned long long>();
+		return (T*)gScratch;
+	}
+};
+
+template<>
+struct GlArg<GLsync>
+{
+	static GLsync Read(GlReader& in)
+	{
+		auto it = gSyncs.find(in.Read<unsigned long long>());
+		return it != gSyncs.end() ? it->second : nullptr;
+	}
+};
+
+// a result as recorded, widened to 64 bits
+template<typename R>
+static unsigned long long readResult(GlReader& in, std::false_type) { return (unsigned long long)in.Read<R>(); }
+template<typename R>
+static unsigned long long readResult(GlReader& in, std::true_type) { return in.Read<unsigned long long>(); }
+
+// Per entry point remapping of the arguments that name objects
+template<int Id, typename... A>
+static void remapArgs(std::tuple<A...>&) {}
+
+template<> void remapArgs<GlFunction_glBindBuffer>(std::tuple<GLenum, GLuint>& args) { std::get<1>(args) = (GLuint)gBuffers(std::get<1>(args)); }
+template<> void remapArgs<GlFunction_glBindBufferRange>(std::tuple<GLenum, GLuint, GLuint, GLintptr, GLsizeiptr>& args) { std::get<2>(args) = (GLuint)gBuffers(std::get<2>(args)); }
+template<> void remapArgs<GlFunction_glTexBuffer>(std::tuple<GLenum, GLenum, GLuint>& args) { std::get<2>(args) = (GLuint)gBuffers(std::get<2>(args)); }
+template<> void remapArgs<GlFunction_glBindTexture>(std::tuple<GLenum, GLuint>& args) { std::get<1>(args) = (GLuint)gTextures(std::get<1>(args)); }
+template<> void remapArgs<GlFunction_glFramebufferTexture>(std::tuple<GLenum, GLenum, GLuint, GLint>& args) { std::get<2>(args) = (GLuint)gTextures(std::get<2>(args)); }
+template<> void remapArgs<GlFunction_glFramebufferTexture2D>(std::tuple<GLenum, GLenum, GLenum, GLuint, GLint>& args) { std::get<3>(args) = (GLuint)gTextures(std::get<3>(args)); }
+template<> void remapArgs<GlFunction_glFramebufferTextureLayer>(std::tuple<GLenum, GLenum, GLuint, GLint, GLint>& args) { std::get<2>(args) = (GLuint)gTextures(std::get<2>(args)); }
+template<> void remapArgs<GlFunction_glBindVertexArray>(std::tuple<GLuint>& args) { std::get<0>(args) = (GLuint)gVertexArrays(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glBindFramebuffer>(std::tuple<GLenum, GLuint>& args) { std::get<1>(args) = (GLuint)gFramebuffers(std::get<1>(args)); }
+template<> void remapArgs<GlFunction_glBeginQuery>(std::tuple<GLenum, GLuint>& args) { std::get<1>(args) = (GLuint)gQueries(std::get<1>(args)); }
+template<> void remapArgs<GlFunction_glQueryCounter>(std::tuple<GLuint, GLenum>& args) { std::get<0>(args) = (GLuint)gQueries(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glCompileShader>(std::tuple<GLuint>& args) { std::get<0>(args) = (GLuint)gShaders(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glDeleteShader>(std::tuple<GLuint>& args) { std::get<0>(args) = (GLuint)gShaders(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glGetShaderiv>(std::tuple<GLuint, GLenum, GLint*>& args) { std::get<0>(args) = (GLuint)gShaders(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glGetShaderInfoLog>(std::tuple<GLuint, GLsizei, GLsizei*, GLchar*>& args) { std::get<0>(args) = (GLuint)gShaders(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glLinkProgram>(std::tuple<GLuint>& args) { std::get<0>(args) = (GLuint)gPrograms(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glGetProgramiv>(std::tuple<GLuint, GLenum, GLint*>& args) { std::get<0>(args) = (GLuint)gPrograms(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glGetProgramInfoLog>(std::tuple<GLuint, GLsizei, GLsizei*, GLchar*>& args) { std::get<0>(args) = (GLuint)gPrograms(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glUniform1i>(std::tuple<GLint, GLint>& args) { std::get<0>(args) = uniformLocation(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glUniform1f>(std::tuple<GLint, GLfloat>& args) { std::get<0>(args) = uniformLocation(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glUniform2f>(std::tuple<GLint, GLfloat, GLfloat>& args) { std::get<0>(args) = uniformLocation(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glUniform3f>(std::tuple<GLint, GLfloat, GLfloat, GLfloat>& args) { std::get<0>(args) = uniformLocation(std::get<0>(args)); }
+template<> void remapArgs<GlFunction_glUniform4f>(std::tuple<GLint, GLfloat, GLfloat, GLfloat, GLfloat>& args) { std::get<0>(args) = uniformLocation(std::get<0>(args)); }
+
+template<> void remapArgs<GlFunction_glUseProgram>(std::tuple<GLuint>& args)
+{
+	// uniform locations are looked up by the program in use as it was recorded
+	gRecordedProgram = std::get<0>(args);
+	std::get<0>(args) = (GLuint)gPrograms(std::get<0>(args));
+}
+
+template<> void remapArgs<GlFunction_glDeleteProgram>(std::tuple<GLuint>& args)
+{
+	GLuint recorded = std::get<0>(args);
+	std::get<0>(args) = (GLuint)gPrograms(recorded);
+	gPrograms.Remove(recorded);
+}
+
+template<> void remapArgs<GlFunction_glAttachShader>(std::tuple<GLuint, GLuint>& args)
+{
+	std::get<0>(args) = (GLuint)gPrograms(std::get<0>(args));
+	std::get<1>(args) = (GLuint)gShaders(std::get<1>(args));
+}
+
+template<> void remapArgs<GlFunction_glUniformBlockBinding>(std::tuple<GLuint, GLuint, GLuint>& args)
+{
+	std::get<1>(args) = (GLuint)gUniformBlocks(programKey(std::get<0>(args), std::get<1>(args)));
+	std::get<0>(args) = (GLuint)gPrograms(std::get<0>(args));
+}
+
+// Per entry point use of what a call returned, against what it returned when recorded
+template<int Id, typename R>
+static void noteResult(unsigned long long, R) {}
+
+template<> void noteResult<GlFunction_glCreateProgram>(unsigned long long recorded, GLuint program) { gPrograms.Add(recorded, program); }
+template<> void noteResult<GlFunction_glCreateShader>(unsigned long long recorded, GLuint shader) { gShaders.Add(recorded, shader); }
+template<> void noteResult<GlFunction_glFenceSync>(unsigned long long recorded, GLsync sync) { gSyncs[recorded] = sync; }
+
+template<typename R, typename... A, size_t... I>
+static R callWith(R (APIENTRY* function)(A...), std::tuple<A...>& args, std::index_sequence<I...>)
+{
+	return function(std::get<I>(args)...);
+}
+
+// Replays one call: reads it, remaps it and makes it. Entry points missing from this driver are read and skipped.
+template<int Id, typename R, typename... A>
+struct GlReplayCall
+{
+	static void Replay(GlReader& in, R (APIENTRY* function)(A...))
+	{
+		unsigned long long recorded = readResult<R>(in, std::is_pointer<R>());
+		std::tuple<A...> args{ GlArg<A>::Read(in)... };
+		remapArgs<Id>(args);
+		if (function)
+			noteResult<Id>(recorded, callWith(function, args, std::index_sequence_for<A...>()));
+	}
+};
+
+template<int Id, typename... A>
+struct GlReplayCall<Id, void, A...>
+{
+	static void Replay(GlReader& in, void (APIENTRY* function)(A...))
+	{
+		std::tuple<A...> args{ GlArg<A>::Read(in)... };
+		remapArgs<Id>(args);
+		if (function)
+			callWith(function, args, std::index_sequence_for<A...>());
+	}
+};
+
+template<int Id, typename R, typename... A>
+static void replayCall(GlReader& in, R (APIENTRY* function)(A...))
+{
+	GlReplayCall<Id, R, A...>::Replay(in, function);
+}
+
+// Entry points with data behind their pointers, read in the order startGlCapture() wrote them
+template<> void replayCall<GlFunction_glBufferData>(GlReader& in, PFNGLBUFFERDATAPROC function)
+{
+	GLenum target = in.Read<GLenum>();
+	GLsizeiptr size = in.Read<GLsizeiptr>();
+	in.Read<unsigned long long>();
+	GLenum usage = in.Read<GLenum>();
+	const void* data = in.ReadBlob();
+	if (function)
+		function(target, size, data, usage);
+}
+
+template<> void replayCall<GlFunction_glBufferSubData>(GlReader& in, PFNGLBUFFERSUBDATAPROC function)
+{
+	GLenum target = in.Read<GLenum>();
+	GLintptr offset = in.Read<GLintptr>();
+	GLsizeiptr size = in.Read<GLsizeiptr>();
+	in.Read<unsigned long long>();
+	const void* data = in.ReadBlob();
+	if (function)
+		function(target, offset, size, data);
+}
+
+#ifdef GL_ARB_buffer_storage
+template<> void replayCall<GlFunction_glBufferStorage>(GlReader& in, PFNGLBUFFERSTORAGEPROC function)
+{
+	GLenum target = in.Read<GLenum>();
+	GLsizeiptr size = in.Read<GLsizeiptr>();
+	in.Read<unsigned long long>();
+	GLbitfield flags = in.Read<GLbitfield>();
+	const void* data = in.ReadBlob();
+	if (function)
+		function(target, size, data, flags);
+}
+#endif
+
+template<> void replayCall<GlFunction_glTexImage2D>(GlReader& in, PFNGLTEXIMAGE2DPROC function)
+{
+	GLenum target = in.Read<GLenum>();
+	GLint level = in.Read<GLint>();
+	GLint internalformat = in.Read<GLint>();
+	GLsizei width = in.Read<GLsizei>();
+	GLsizei height = in.Read<GLsizei>();
+	GLint border = in.Read<GLint>();
+	GLenum format = in.Read<GLenum>();
+	GLenum type = in.Read<GLenum>();
+	in.Read<unsigned long long>();
+	const void* pixels = in.ReadBlob();
+	if (function)
+		function(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+template<> void replayCall<GlFunction_glTexImage3D>(GlReader& in, PFNGLTEXIMAGE3DPROC function)
+{
+	GLenum target = in.Read<GLenum>();
+	GLint level = in.Read<GLint>();
+	GLint internalformat = in.Read<GLint>();
+	GLsizei width = in.Read<GLsizei>();
+	GLsizei height = in.Read<GLsizei>();
+	GLsizei depth = in.Read<GLsizei>();
+	GLint border = in.Read<GLint>();
+	GLenum format = in.Read<GLenum>();
+	GLenum type = in.Read<GLenum>();
+	in.Read<unsigned long long>();
+	const void* pixels = in.ReadBlob();
+	if (function)
+		function(target, level, internalformat, width, height, depth, border, format, type, pixels);
+}
+
+template<> void replayCall<GlFunction_glShaderSource>(GlReader& in, PFNGLSHADERSOURCEPROC function)
+{
+	GLuint shader = (GLuint)gShaders(in.Read<GLuint>());
+	GLsizei count = in.Read<GLsizei>();
+	in.Read<unsigned long long>();
+	in.Read<unsigned long long>();
+	std::vector<const GLchar*> strings;
+	std::vector<GLint> lengths;
+	for (GLsizei i = 0; i < count; i++)
+	{
+		size_t length;
+		strings.push_back((const GLchar*)in.ReadBlob(length));
+		lengths.push_back((GLint)length);
+	}
+	if (function)
+		function(shader, count, strings.data(), lengths.data());
+}
+
+template<typename F>
+static void replayUniformVector(GlReader& in, F function)
+{
+	GLint location = uniformLocation(in.Read<GLint>());
+	GLsizei count = in.Read<GLsizei>();
+	in.Read<unsigned long long>();
+	const GLfloat* value = in.ReadArray<GLfloat>();
+	if (function)
+		function(location, count, value);
+}
+
+template<> void replayCall<GlFunction_glUniform2fv>(GlReader& in, PFNGLUNIFORM2FVPROC function) { replayUniformVector(in, function); }
+template<> void replayCall<GlFunction_glUniform3fv>(GlReader& in, PFNGLUNIFORM3FVPROC function) { replayUniformVector(in, function); }
+template<> void replayCall<GlFunction_glUniform4fv>(GlReader& in, PFNGLUNIFORM4FVPROC function) { replayUniformVector(in, function); }
+
+template<typename F>
+static void replayUniformMatrix(GlReader& in, F function)
+{
+	GLint location = uniformLocation(in.Read<GLint>());
+	GLsizei count = in.Read<GLsizei>();
+	GLboolean transpose = in.Read<GLboolean>();
+	in.Read<unsigned long long>();
+	const GLfloat* value = in.ReadArray<GLfloat>();
+	if (function)
+		function(location, count, transpose, value);
+}
+
+template<> void replayCall<GlFunction_glUniformMatrix3fv>(GlReader& in, PFNGLUNIFORMMATRIX3FVPROC function) { replayUniformMatrix(in, function); }
+template<> void replayCall<GlFunction_glUniformMatrix4fv>(GlReader& in, PFNGLUNIFORMMATRIX4FVPROC function) { replayUniformMatrix(in, function); }
+
+template<> void replayCall<GlFunction_glDrawBuffers>(GlReader& in, PFNGLDRAWBUFFERSPROC function)
+{
+	GLsizei n = in.Read<GLsizei>();
+	in.Read<unsigned long long>();
+	const GLenum* bufs = in.ReadArray<GLenum>();
+	if (function)
+		function(n, bufs);
+}
+
+template<> void replayCall<GlFunction_glClearBufferfv>(GlReader& in, PFNGLCLEARBUFFERFVPROC function)
+{
+	GLenum buffer = in.Read<GLenum>();
+	GLint drawbuffer = in.Read<GLint>();
+	in.Read<unsigned long long>();
+	const GLfloat* value = in.ReadArray<GLfloat>();
+	if (function)
+		function(buffer, drawbuffer, value);
+}
+
+template<> void replayCall<GlFunction_glClearBufferuiv>(GlReader& in, PFNGLCLEARBUFFERUIVPROC function)
+{
+	GLenum buffer = in.Read<GLenum>();
+	GLint drawbuffer = in.Read<GLint>();
+	in.Read<unsigned long long>();
+	const GLuint* value = in.ReadArray<GLuint>();
+	if (function)
+		function(buffer, drawbuffer, value);
+}
+
+template<> void replayCall<GlFunction_glTexParameterfv>(GlReader& in, PFNGLTEXPARAMETERFVPROC function)
+{
+	GLenum target = in.Read<GLenum>();
+	GLenum pname = in.Read<GLenum>();
+	in.Read<unsigned long long>();
+	const GLfloat* params = in.ReadArray<GLfloat>();
+	if (function)
+		function(target, pname, params);
+}
+
+#ifdef GL_KHR_debug
+template<> void replayCall<GlFunction_glPushDebugGroup>(GlReader& in, PFNGLPUSHDEBUGGROUPPROC function)
+{
+	GLenum source = in.Read<GLenum>();
+	GLuint id = in.Read<GLuint>();
+	GLsizei length = in.Read<GLsizei>();
+	in.Read<unsigned long long>();
+	const GLchar* message = (const GLchar*)in.ReadBlob();
+	if (function)
+		function(source, id, length, message);
+}
+#endif
+
+template<> void replayCall<GlFunction_glGetUniformLocation>(GlReader& in, PFNGLGETUNIFORMLOCATIONPROC function)
+{
+	GLint recorded = in.Read<GLint>();
+	GLuint program = in.Read<GLuint>();
+	in.Read<unsigned long long>();
+	const GLchar* name = (const GLchar*)in.ReadBlob();
+	if (function && recorded >= 0)
+		gUniformLocations.Add(programKey(program, recorded), (unsigned long long)function((GLuint)gPrograms(program), name));
+}
+
+template<> void replayCall<GlFunction_glGetUniformBlockIndex>(GlReader& in, PFNGLGETUNIFORMBLOCKINDEXPROC function)
+{
+	GLuint recorded = in.Read<GLuint>();
+	GLuint program = in.Read<GLuint>();
+	in.Read<unsigned long long>();
+	const GLchar* name = (const GLchar*)in.ReadBlob();
+	if (function)
+		gUniformBlocks.Add(programKey(program, recorded), function((GLuint)gPrograms(program), name));
+}
+
+template<> void replayCall<GlFunction_glReadPixels>(GlReader& in, PFNGLREADPIXELSPROC function)
+{
+	GLint x = in.Read<GLint>();
+	GLint y = in.Read<GLint>();
+	GLsizei width = in.Read<GLsizei>();
+	GLsizei height = in.Read<GLsizei>();
+	GLenum format = in.Read<GLenum>();
+	GLenum type = in.Read<GLenum>();
+	unsigned long long recorded = in.Read<unsigned long long>();
+	// into a pixel buffer the pointer is an offset, kept as it was
+	GLint packBuffer = 0;
+	glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+	// big enough for four channels of four bytes
+	static std::vector<unsigned char> pixels;
+	pixels.resize(packBuffer ? 0 : (size_t)width * height * 16);
+	if (function)
+		function(x, y, width, height, format, type, packBuffer ? (void*)recorded : pixels.data());
+}
+
+static void replayGen(GlReader& in, void (APIENTRY* function)(GLsizei, GLuint*), GlNameMap& map)
+{
+	GLsizei n = in.Read<GLsizei>();
+	in.Read<unsigned long long>();
+	const GLuint* recorded = in.ReadArray<GLuint>();
+	std::vector<GLuint> names(n);
+	if (function)
+		function(n, names.data());
+	for (GLsizei i = 0; recorded && i < n; i++)
+		map.Add(recorded[i], names[i]);
+}
+
+template<> void replayCall<GlFunction_glGenBuffers>(GlReader& in, PFNGLGENBUFFERSPROC function) { replayGen(in, function, gBuffers); }
+template<> void replayCall<GlFunction_glGenTextures>(GlReader& in, PFNGLGENTEXTURESPROC function) { replayGen(in, function, gTextures); }
+template<> void replayCall<GlFunction_glGenVertexArrays>(GlReader& in, PFNGLGENVERTEXARRAYSPROC function) { replayGen(in, function, gVertexArrays); }
+template<> void replayCall<GlFunction_glGenFramebuffers>(GlReader& in, PFNGLGENFRAMEBUFFERSPROC function) { replayGen(in, function, gFramebuffers); }
+template<> void replayCall<GlFunction_glGenQueries>(GlReader& in, PFNGLGENQUERIESPROC function) { replayGen(in, function, gQueries); }
+
+static void replayDelete(GlReader& in, void (APIENTRY* function)(GLsizei, const GLuint*), GlNameMap& map)
+{
+	GLsizei n = in.Read<GLsizei>();
+	in.Read<unsigned long long>();
+	const GLuint* recorded = in.ReadArray<GLuint>();
+	std::vector<GLuint> names;
+	for (GLsizei i = 0; recorded && i < n; i++)
+	{
+		names.push_back((GLuint)map(recorded[i]));
+		map.Remove(recorded[i]);
+	}
+	if (function && !names.empty())
+		function(names.size(), names.data());
+}
+
+template<> void replayCall<GlFunction_glDeleteBuffers>(GlReader& in, PFNGLDELETEBUFFERSPROC function) { replayDelete(in, function, gBuffers); }
+template<> void replayCall<GlFunction_glDeleteTextures>(GlReader& in, PFNGLDELETETEXTURESPROC function) { replayDelete(in, function, gTextures); }
+template<> void replayCall<GlFunction_glDeleteVertexArrays>(GlReader& in, PFNGLDELETEVERTEXARRAYSPROC function) { replayDelete(in, function, gVertexArrays); }
+template<> void replayCall<GlFunction_glDeleteFramebuffers>(GlReader& in, PFNGLDELETEFRAMEBUFFERSPROC function) { replayDelete(in, function, gFramebuffers); }
+template<> void replayCall<GlFunction_glDeleteQueries>(GlReader& in, PFNGLDELETEQUERIESPROC function) { replayDelete(in, function, gQueries); }
+
+// The application only reads a query's result once GL_QUERY_RESULT_AVAILABLE says it's there, but a replay running
+// ahead of the GPU would block on the same read. It asks whether the result is available instead, so the replay makes
+// as many query calls as were recorded without waiting where the application never did.
+template<typename T>
+static void replayQueryObject(GlReader& in, void (APIENTRY* function)(GLuint, GLenum, T*))
+{
+	GLuint query = (GLuint)gQueries(in.Read<GLuint>());
+	GLenum pname = in.Read<GLenum>();
+	in.Read<unsigned long long>();
+	if (!function)
+		return;
+	if (pname == GL_QUERY_RESULT)
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, (GLint*)gScratch);
+	else
+		function(query, pname, (T*)gScratch);
+}
+
+template<> void replayCall<GlFunction_glGetQueryObjectiv>(GlReader& in, PFNGLGETQUERYOBJECTIVPROC function) { replayQueryObject(in, function); }
+template<> void replayCall<GlFunction_glGetQueryObjectui64v>(GlReader& in, PFNGLGETQUERYOBJECTUI64VPROC function) { replayQueryObject(in, function); }
+
+static bool readCapture(const std::string& path, std::vector<unsigned char>& data, int& width, int& height)
+{
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(GL_CAPTURE_MAGIC)];
+	unsigned int header[3];
+	if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, GL_CAPTURE_MAGIC, sizeof(magic)) != 0 || !file.read((char*)header, sizeof(header)))
+	{
+		std::cout << "Error::GlReplay::Not a GL capture: " << path << std::endl;
+		return false;
+	}
+	if (header[0] != GL_CAPTURE_VERSION)
+	{
+		std::cout << "Error::GlReplay::" << path << " is capture version " << header[0] << ", not " << GL_CAPTURE_VERSION << std::endl;
+		return false;
+	}
+	width = header[1];
+	height = header[2];
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+bool readGlCaptureSize(const std::string& path, int& width, int& height)
+{
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(GL_CAPTURE_MAGIC)];
+	unsigned int header[3];
+	if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, GL_CAPTURE_MAGIC, sizeof(magic)) != 0 || !file.read((char*)header, sizeof(header)))
+		return false;
+	width = header[1];
+	height = header[2];
+	return true;
+}
+
+bool replayGlCapture(const std::string& path, bool paced, const std::function<bool()>& endFrame)
+{
+	std::vector<unsigned char> data;
+	int width, height;
+	if (!readCapture(path, data, width, height))
+		return false;
+	GlReader in(std::move(data));
+
+	// a replayer per entry point, each calling through the glad pointer as it is now, so an installed interceptor sees the calls
+	typedef void (*Replayer)(GlReader&);
+	static const Replayer replayers[] =
+	{
+#define GL_REPLAYER(name) [](GlReader& reader) { replayCall<GlFunction_##name>(reader, glad_##name); },
+		GL_INTERCEPTED_FUNCTIONS(GL_REPLAYER)
+#undef GL_REPLAYER
+	};
+
+	std::vector<double> frameTimes; // milliseconds
+	bool loading = true;
+	long long firstFrameTime = 0;
+	std::chrono::steady_clock::time_point replayStart, frameStart;
+	while (!in.AtEnd())
+	{
+		unsigned short id = in.Read<unsigned short>();
+		if (id == GL_CAPTURE_FRAME_END)
+		{
+			long long time = in.Read<long long>();
+			if (loading)
+			{
+				// the first frame starts when the loading has been replayed
+				glFinish();
+				loading = false;
+				firstFrameTime = time;
+				replayStart = frameStart = std::chrono::steady_clock::now();
+				continue;
+			}
+			if (paced)
+				std::this_thread::sleep_until(replayStart + std::chrono::nanoseconds(time - firstFrameTime));
+			if (!endFrame())
+				break;
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			frameTimes.push_back(std::chrono::duration<double, std::milli>(now - frameStart).count());
+			frameStart = now;
+			continue;
+		}
+		if (id >= GL_FUNCTION_COUNT)
+		{
+			std::cout << "Error::GlReplay::Unknown entry point " << id << " in " << path << std::endl;
+			return false;
+		}
+		replayers[id](in);
+	}
+
+	if (frameTimes.empty())
+	{
+		std::cout << "Replayed the loading of " << path << ", which holds no frames" << std::endl;
+		return true;
+	}
+	std::vector<double> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (double time : frameTimes)
+		total += time;
+	std::cout << "Replayed " << frameTimes.size() << " frames of " << path << (paced ? " at the captured pace" : "") << ": mean " << total / frameTimes.size()
+		<< " ms, p50 " << sorted[sorted.size() / 2] << " ms, p95 " << sorted[std::min(sorted.size() * 95 / 100, sorted.size() - 1)] << " ms, max " << sorted.back() << " ms" << std::endl;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+#include <functional>
+#include <string>
+
+// Reads the window size a capture was made at, to open the replay's window to match
+bool readGlCaptureSize(const std::string& path, int& width, int& height);
+
+// Plays back a capture from startGlCapture() on the current context, with the object names, uniform locations
+// and syncs it creates mapped onto the ones it recorded. The loading runs first, untimed; then each frame ends
+// with endFrame(), which presents it and returns false to stop early. Frames run as fast as they can, or, when
+// paced, no faster than they were captured. Prints the frame times; returns false if the file can't be read.
+bool replayGlCapture(const std::string& path, bool paced, const std::function<bool()>& endFrame);
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "GpuMemory.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+struct GpuResource
+{
+	GpuResourceType type;
+	unsigned int id;
+	unsigned long long bytes;
+	GLenum internalFormat; // textures only
+	int width, height, layers, samples;
+	bool mipmapped;
+	std::string owner;
+	const char* file;
+	int line;
+};
+
+static std::unordered_map<unsigned long long, GpuResource> gResources;
+
+static const char* TYPE_NAMES[] = { "buffer", "texture", "framebuffer", "vertex array", "program" };
+static const unsigned int NUM_TYPES = sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]);
+
+static unsigned long long resourceKey(GpuResourceType type, unsigned int id)
+{
+	return (unsigned long long)type << 32 | id;
+}
+
+struct TextureFormat
+{
+	GLenum internalFormat;
+	const char* name;
+	unsigned int bytesPerTexel;
+};
+
+// the formats the renderer allocates; unsized formats are stored as the sized ones they stand for
+static const TextureFormat TEXTURE_FORMATS[] =
+{
+	{ GL_RED, "RED", 1 }, { GL_R8, "R8", 1 }, { GL_RG8, "RG8", 2 },
+	{ GL_RGB, "RGB", 4 }, { GL_RGB8, "RGB8", 4 }, { GL_SRGB, "SRGB", 4 }, { GL_SRGB8, "SRGB8", 4 },
+	{ GL_RGBA, "RGBA", 4 }, { GL_RGBA8, "RGBA8", 4 }, { GL_SRGB_ALPHA, "SRGB_ALPHA", 4 }, { GL_SRGB8_ALPHA8, "SRGB8_ALPHA8", 4 },
+	{ GL_R16F, "R16F", 2 }, { GL_RG16F, "RG16F", 4 }, { GL_RGB16F, "RGB16F", 8 }, { GL_RGBA16F, "RGBA16F", 8 },
+	{ GL_R32F, "R32F", 4 }, { GL_RG32F, "RG32F", 8 }, { GL_RGBA32F, "RGBA32F", 16 },
+	{ GL_R16UI, "R16UI", 2 }, { GL_RG16UI, "RG16UI", 4 }, { GL_RG32UI, "RG32UI", 8 },
+	{ GL_DEPTH_COMPONENT16, "DEPTH16", 2 }, { GL_DEPTH_COMPONENT24, "DEPTH24", 4 }, { GL_DEPTH_COMPONENT32F, "DEPTH32F", 4 },
+	{ GL_DEPTH24_STENCIL8, "DEPTH24_STENCIL8", 4 }
+};
+
+static const TextureFormat* findTextureFormat(GLenum internalFormat)
+{
+	for (const TextureFormat& format : TEXTURE_FORMATS)
+	{
+		if (format.internalFormat == internalFormat)
+			return &format;
+	}
+	return nullptr;
+}
+
+// the name without its directories: MSVC's __FILE__ is the full path
+static const char* fileName(const char* path)
+{
+	const char* name = path;
+	for (const char* c = path; *c; c++)
+	{
+		if (*c == '/' || *c == '\\')
+			name = c + 1;
+	}
+	return name;
+}
+
+static double megabytes(unsigned long long bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+static GpuResource& addResource(GpuResourceType type, unsigned int id, const std::string& owner, const char* file, int line)
+{
+	// a name seen again is the same object being resized, so it keeps where it was first created
+	auto inserted = gResources.emplace(resourceKey(type, id), GpuResource());
+	GpuResource& resource = inserted.first->second;
+	if (inserted.second)
+	{
+		resource.type = type;
+		resource.id = id;
+		resource.owner = owner;
+		resource.file = file;
+		resource.line = line;
+	}
+	resource.bytes = 0;
+	resource.internalFormat = 0;
+	resource.width = resource.height = resource.layers = resource.samples = 0;
+	resource.mipmapped = false;
+	return resource;
+}
+
+void trackGpuBuffer(unsigned int id, unsigned long long bytes, const std::string& owner, const char* file, int line)
+{
+	addResource(GpuResourceType::Buffer, id, owner, file, line).bytes = bytes;
+}
+
+void trackGpuTexture(unsigned int id, GLenum internalFormat, int width, int height, int layers, int samples, bool mipmapped, const std::string& owner, const char* file, int line)
+{
+	GpuResource& resource = addResource(GpuResourceType::Texture, id, owner, file, line);
+	resource.internalFormat = internalFormat;
+	resource.width = width;
+	resource.height = height;
+	resource.layers = layers;
+	resource.samples = samples;
+	resource.mipmapped = mipmapped;
+
+	const TextureFormat* format = findTextureFormat(internalFormat);
+	if (!format)
+		std::cout << "Error::GpuMemory::Unknown texture format 0x" << std::hex << internalFormat << std::dec << " for " << owner << ", counted as 4 bytes a texel" << std::endl;
+	unsigned long long texels = 0;
+	for (int w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+	{
+		texels += (unsigned long long)w * h;
+		if (!mipmapped || (w == 1 && h == 1))
+			break;
+	}
+	resource.bytes = texels * std::max(layers, 1) * std::max(samples, 1) * (format ? format->bytesPerTexel : 4);
+}
+
+void trackGpuObject(GpuResourceType type, unsigned int id, const std::string& owner, const char* file, int line)
+{
+	addResource(type, id, owner, file, line);
+}
+
+void untrackGpuResource(GpuResourceType type, unsigned int id)
+{
+	gResources.erase(resourceKey(type, id));
+}
+
+unsigned long long getGpuMemoryBytes()
+{
+	unsigned long long bytes = 0;
+	for (const auto& entry : gResources)
+		bytes += entry.second.bytes;
+	return bytes;
+}
+
+static void describe(std::ostream& out, const GpuResource& resource, bool withSite)
+{
+	out << TYPE_NAMES[(int)resource.type] << " " << resource.id;
+	if (resource.type == GpuResourceType::Texture && resource.width > 0)
+	{
+		const TextureFormat* format = findTextureFormat(resource.internalFormat);
+		out << " " << resource.width << "x" << resource.height;
+		if (resource.layers > 1)
+			out << "x" << resource.layers;
+		if (format)
+			out << " " << format->name;
+		else
+			out << " format 0x" << std::hex << resource.internalFormat << std::dec;
+		if (resource.samples > 1)
+			out << " " << resource.samples << "x MSAA";
+		if (resource.mipmapped)
+			out << " mipmapped";
+	}
+	out << ", " << resource.owner;
+	if (withSite)
+		out << " (" << fileName(resource.file) << ":" << resource.line << ")";
+}
+
+void dumpGpuMemory(std::ostream& out, unsigned int largest)
+{
+	unsigned long long bytes[NUM_TYPES] = {};
+	unsigned int counts[NUM_TYPES] = {};
+	std::vector<const GpuResource*> resources;
+	for (const auto& entry : gResources)
+	{
+		bytes[(int)entry.second.type] += entry.second.bytes;
+		counts[(int)entry.second.type]++;
+		resources.push_back(&entry.second);
+	}
+
+	char line[128];
+	std::snprintf(line, sizeof(line), "GPU memory: %.2f MB in %u objects", megabytes(getGpuMemoryBytes()), (unsigned int)gResources.size());
+	out << line << std::endl;
+	for (unsigned int i = 0; i < NUM_TYPES; i++)
+	{
+		std::snprintf(line, sizeof(line), "  %ss: %u, %.2f MB", TYPE_NAMES[i], counts[i], megabytes(bytes[i]));
+		out << line << std::endl;
+	}
+
+	largest = std::min<unsigned int>(largest, resources.size());
+	std::partial_sort(resources.begin(), resources.begin() + largest, resources.end(), [](const GpuResource* a, const GpuResource* b) { return a->bytes > b->bytes; });
+	if (largest > 0)
+		out << "  largest:" << std::endl;
+	for (unsigned int i = 0; i < largest && resources[i]->bytes > 0; i++)
+	{
+		std::snprintf(line, sizeof(line), "    %8.2f MB  ", megabytes(resources[i]->bytes));
+		out << line;
+		describe(out, *resources[i], true);
+		out << std::endl;
+	}
+}
+
+void dumpGpuLeaks(std::ostream& out)
+{
+	if (gResources.empty())
+		return;
+
+	struct Site
+	{
+		GpuResourceType type;
+		unsigned int count;
+		unsigned long long bytes;
+		const GpuResource* example;
+	};
+	std::map<std::pair<std::string, int>, Site> sites;
+	for (const auto& entry : gResources)
+	{
+		const GpuResource& resource = entry.second;
+		auto inserted = sites.emplace(std::make_pair(std::string(fileName(resource.file)), resource.line), Site{ resource.type, 0, 0, &resource });
+		inserted.first->second.count++;
+		inserted.first->second.bytes += resource.bytes;
+	}
+
+	char line[128];
+	std::snprintf(line, sizeof(line), "%u GL objects holding %.2f MB were never deleted:", (unsigned int)gResources.size(), megabytes(getGpuMemoryBytes()));
+	out << line << std::endl;
+	for (const auto& entry : sites)
+	{
+		const Site& site = entry.second;
+		std::snprintf(line, sizeof(line), "  %s:%d: %u %s%s, %.2f MB, e.g. ", entry.first.first.c_str(), entry.first.second, site.count, TYPE_NAMES[(int)site.type], site.count > 1 ? "s" : "", megabytes(site.bytes));
+		out << line;
+		describe(out, *site.example, false);
+		out << std::endl;
+	}
+}
\ No newline at end of file
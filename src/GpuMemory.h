@@ -0,0 +1,33 @@
+#pragma once
+#include <glad\glad.h>
+#include <ostream>
+#include <string>
+
+enum class GpuResourceType { Buffer, Texture, Framebuffer, VertexArray, Program };
+
+// Every GL object the renderer creates, with its size, owner and the place it was created, so that GPU memory can
+// be held to a budget and objects that are never deleted show up.
+// Sizes come from the allocation: buffers from their size, textures from their format, size, layers, samples and
+// mip chain, with three channel formats padded to four bytes a texel as drivers store them. Objects are keyed by
+// type and name, so tracking one again updates it; GlObject (GlObject.h) untracks what it deletes.
+// Only the GL thread may call these.
+
+// Record an object, or update the size of one already recorded; the macros below fill in where it was created
+void trackGpuBuffer(unsigned int id, unsigned long long bytes, const std::string& owner, const char* file, int line);
+void trackGpuTexture(unsigned int id, GLenum internalFormat, int width, int height, int layers, int samples, bool mipmapped, const std::string& owner, const char* file, int line);
+// objects with no storage of their own: framebuffers, vertex arrays, programs and buffer textures
+void trackGpuObject(GpuResourceType type, unsigned int id, const std::string& owner, const char* file, int line);
+// call when the object is deleted
+void untrackGpuResource(GpuResourceType type, unsigned int id);
+
+// bytes held by the objects alive now
+unsigned long long getGpuMemoryBytes();
+// totals by type, then the largest objects
+void dumpGpuMemory(std::ostream& out, unsigned int largest);
+// the objects still alive, grouped by where they were created; at shutdown these are the leaks
+void dumpGpuLeaks(std::ostream& out);
+
+#define TRACK_GPU_BUFFER(id, bytes, owner) trackGpuBuffer(id, bytes, owner, __FILE__, __LINE__)
+#define TRACK_GPU_TEXTURE(id, internalFormat, width, height, layers, samples, mipmapped, owner) \
+	trackGpuTexture(id, internalFormat, width, height, layers, samples, mipmapped, owner, __FILE__, __LINE__)
+#define TRACK_GPU_OBJECT(type, id, owner) trackGpuObject(type, id, owner, __FILE__, __LINE__)
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include <glad\glad.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// weight of the newest frame in the rolling averages
+static const double AVERAGE_WEIGHT = 0.05;
+static const unsigned int NO_SCOPE = ~0u;
+
+void GpuProfiler::BeginFrame()
+{
+	mFrame = (mFrame + 1) % GPU_PROFILER_FRAMES;
+	Frame& frame = mFrames[mFrame];
+	if (frame.pending)
+		Resolve(frame);
+	frame.usedQueries = 0;
+	frame.usedSampleQueries = 0;
+	frame.scopes.clear();
+	frame.pending = false;
+
+	// GL_TIMESTAMP read back now is the GPU's clock at about the same moment, which lines the two clocks up
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	frame.clockOffset = profilerTime() - gpuTime;
+	mInFrame = true;
+	mDepth = 0;
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (mDepth != 0)
+		std::cout << "Error::GpuProfiler::" << mDepth << " scopes still open at the end of the frame" << std::endl;
+	Frame& frame = mFrames[mFrame];
+	frame.pending = !frame.scopes.empty();
+	mInFrame = false;
+}
+
+void GpuProfiler::BeginScope(const char* name)
+{
+#ifdef GL_KHR_debug
+	if (GLAD_GL_KHR_debug)
+		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+#endif
+
+	// scopes outside a frame, or nested too deeply, are only labelled
+	if (!mInFrame || mDepth >= GPU_PROFILER_MAX_DEPTH)
+	{
+		if (mDepth < GPU_PROFILER_MAX_DEPTH)
+			mOpenScopes[mDepth] = NO_SCOPE;
+		mDepth++;
+		return;
+	}
+
+	Frame& frame = mFrames[mFrame];
+	int parent = -1;
+	if (mDepth > 0 && mOpenScopes[mDepth - 1] != NO_SCOPE)
+		parent = frame.scopes[mOpenScopes[mDepth - 1]].stat;
+	Scope scope = { FindStat(name, parent), NextQuery(frame), NO_SCOPE, NO_SCOPE, 1 };
+	glQueryCounter(frame.queries[scope.beginQuery], GL_TIMESTAMP);
+	if (mScreenPixels > 0 && mDepth == 0)
+	{
+		scope.sampleQuery = NextSampleQuery(frame);
+		glBeginQuery(GL_SAMPLES_PASSED, frame.sampleQueries[scope.sampleQuery]);
+	}
+	mOpenScopes[mDepth++] = frame.scopes.size();
+	frame.scopes.push_back(scope);
+}
+
+void GpuProfiler::EndScope()
+{
+	if (mDepth == 0)
+	{
+		std::cout << "Error::GpuProfiler::EndScope without a BeginScope" << std::endl;
+		return;
+	}
+	mDepth--;
+	if (mDepth < GPU_PROFILER_MAX_DEPTH && mOpenScopes[mDepth] != NO_SCOPE)
+	{
+		Frame& frame = mFrames[mFrame];
+		Scope& scope = frame.scopes[mOpenScopes[mDepth]];
+		if (scope.sampleQuery != NO_SCOPE)
+		{
+			glEndQuery(GL_SAMPLES_PASSED);
+			glGetIntegerv(GL_SAMPLES, &scope.samplesPerPixel);
+			scope.samplesPerPixel = std::max(scope.samplesPerPixel, 1);
+		}
+		scope.endQuery = NextQuery(frame);
+		glQueryCounter(frame.queries[scope.endQuery], GL_TIMESTAMP);
+	}
+
+#ifdef GL_KHR_debug
+	if (GLAD_GL_KHR_debug)
+		glPopDebugGroup();
+#endif
+}
+
+void GpuProfiler::Dump(std::ostream& out) const
+{
+	out << "GPU time (average / last frame):" << std::endl;
+	DumpChildren(out, -1);
+	if (mSkippedFrames > 0)
+		out << "  (" << mSkippedFrames << " frames skipped with results not ready)" << std::endl;
+}
+
+double GpuProfiler::GetFrameMilliseconds() const
+{
+	double total = 0.0;
+	for (const GpuScopeStats& stats : mStats)
+	{
+		if (stats.parent < 0)
+			total += stats.lastMilliseconds;
+	}
+	return total;
+}
+
+void GpuProfiler::GetTimeline(std::vector<GpuTimelineEvent>& events) const
+{
+	events.clear();
+	unsigned long long oldest = mTimelineCount > GPU_PROFILER_TIMELINE_EVENTS ? mTimelineCount - GPU_PROFILER_TIMELINE_EVENTS : 0;
+	for (unsigned long long i = oldest; i < mTimelineCount; i++)
+		events.push_back(mTimeline[i % GPU_PROFILER_TIMELINE_EVENTS]);
+}
+
+void GpuProfiler::Clear()
+{
+	for (Frame& frame : mFrames)
+	{
+		if (!frame.queries.empty())
+			glDeleteQueries(frame.queries.size(), frame.queries.data());
+		if (!frame.sampleQueries.empty())
+			glDeleteQueries(frame.sampleQueries.size(), frame.sampleQueries.data());
+		frame = Frame();
+	}
+	mInFrame = false;
+	mDepth = 0;
+}
+
+void GpuProfiler::DumpChildren(std::ostream& out, int parent) const
+{
+	// depth first, so every scope is listed under its parent whatever order they were first seen in
+	for (unsigned int i = 0; i < mStats.size(); i++)
+	{
+		const GpuScopeStats& stats = mStats[i];
+		if (stats.parent != parent)
+			continue;
+		for (unsigned int j = 0; j <= stats.depth; j++)
+			out << "  ";
+		out << stats.name << ": " << std::max(stats.averageMilliseconds, 0.0) << " / " << stats.lastMilliseconds << " ms";
+		if (mScreenPixels > 0 && stats.lastFragments >= 0.0)
+			out << ", " << (unsigned long long)stats.averageFragments << " fragments, " << stats.averageFragments / mScreenPixels << " per pixel";
+		out << std::endl;
+		DumpChildren(out, i);
+	}
+}
+
+void GpuProfiler::Resolve(Frame& frame)
+{
+	// queries complete in order, so if the last one is ready they all are
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		mSkippedFrames++;
+		return;
+	}
+
+	// a scope can run several times a frame (once per shadow casting light, say): its frame time is the sum
+	for (GpuScopeStats& stats : mStats)
+		stats.lastMilliseconds = stats.lastFragments = -1.0;
+	for (const Scope& scope : frame.scopes)
+	{
+		if (scope.endQuery == NO_SCOPE)
+			continue;
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(frame.queries[scope.beginQuery], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.queries[scope.endQuery], GL_QUERY_RESULT, &end);
+		GpuScopeStats& stats = mStats[scope.stat];
+		stats.lastMilliseconds = std::max(stats.lastMilliseconds, 0.0) + (end - begin) / 1.0e6;
+		if (scope.sampleQuery != NO_SCOPE)
+		{
+			GLuint64 samples = 0;
+			glGetQueryObjectui64v(frame.sampleQueries[scope.sampleQuery], GL_QUERY_RESULT, &samples);
+			stats.lastFragments = std::max(stats.lastFragments, 0.0) + (double)samples / scope.samplesPerPixel;
+		}
+
+		if (mTimeline.empty())
+			mTimeline.resize(GPU_PROFILER_TIMELINE_EVENTS);
+		mTimeline[mTimelineCount++ % GPU_PROFILER_TIMELINE_EVENTS] = { stats.name, (long long)begin + frame.clockOffset, (long long)end + frame.clockOffset };
+	}
+	for (GpuScopeStats& stats : mStats)
+	{
+		if (stats.lastFragments >= 0.0)
+			stats.averageFragments = stats.averageFragments < 0.0 ? stats.lastFragments : stats.averageFragments + AVERAGE_WEIGHT * (stats.lastFragments - stats.averageFragments);
+		if (stats.lastMilliseconds < 0.0)
+			stats.lastMilliseconds = 0.0;
+		else if (stats.averageMilliseconds < 0.0)
+			stats.averageMilliseconds = stats.lastMilliseconds;
+		else
+			stats.averageMilliseconds += AVERAGE_WEIGHT * (stats.lastMilliseconds - stats.averageMilliseconds);
+	}
+}
+
+unsigned int GpuProfiler::NextQuery(Frame& frame)
+{
+	if (frame.usedQueries == frame.queries.size())
+	{
+		unsigned int first = frame.queries.size();
+		frame.queries.resize(first + 32);
+		glGenQueries(32, &frame.queries[first]);
+	}
+	return frame.usedQueries++;
+}
+
+unsigned int GpuProfiler::NextSampleQuery(Frame& frame)
+{
+	if (frame.usedSampleQueries == frame.sampleQueries.size())
+	{
+		unsigned int first = frame.sampleQueries.size();
+		frame.sampleQueries.resize(first + 8);
+		glGenQueries(8, &frame.sampleQueries[first]);
+	}
+	return frame.usedSampleQueries++;
+}
+
+unsigned int GpuProfiler::FindStat(const char* name, int parent)
+{
+	for (unsigned int i = 0; i < mStats.size(); i++)
+	{
+		if (mStats[i].parent == parent && std::strcmp(mStats[i].name, name) == 0)
+			return i;
+	}
+	unsigned int depth = parent < 0 ? 0 : mStats[parent].depth + 1;
+	mStats.push_back({ name, parent, depth, 0.0, -1.0, -1.0, -1.0 });
+	return mStats.size() - 1;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+#include <ostream>
+#include <vector>
+
+// frames of queries in flight: results are read this many frames after they were issued
+const unsigned int GPU_PROFILER_FRAMES = 4;
+const unsigned int GPU_PROFILER_MAX_DEPTH = 16;
+// resolved scopes kept for traces
+const unsigned int GPU_PROFILER_TIMELINE_EVENTS = 8192;
+
+// Rolling GPU time of one scope, identified by its name and its parent
+struct GpuScopeStats
+{
+	const char* name;
+	int parent; // index into the stats, -1 at the top level
+	unsigned int depth;
+	double lastMilliseconds;
+	double averageMilliseconds;
+	double lastFragments; // -1 unless counted, see SetFragmentCounting()
+	double averageFragments;
+};
+
+// A resolved scope, with its times moved onto the CPU profiler's clock
+struct GpuTimelineEvent
+{
+	const char* name;
+	long long begin; // nanoseconds, see profilerTime()
+	long long end;
+};
+
+// GPU time per render pass and draw group, from timestamp queries.
+// BeginScope()/EndScope() (or a GpuScope) bracket GL commands with a pair of GL_TIMESTAMP queries, so scopes
+// nest freely, and push a KHR_debug group of the same name for frame debuggers. Each frame's queries come
+// from a ring of GPU_PROFILER_FRAMES sets and are read when the set comes round again, by which time the GPU
+// has long finished with them, so reading never stalls; a frame whose results still aren't ready is skipped.
+// Query objects and stats entries are only created the first time a scope is seen.
+// With fragment counting on, each top level scope also runs a GL_SAMPLES_PASSED query (those can't nest), and
+// the samples that passed the depth test are divided by the sample count of the framebuffer bound at the end of
+// the scope to give the fragments it shaded.
+class GpuProfiler
+{
+public:
+	void BeginFrame();
+	void EndFrame();
+
+	// name must outlive the profiler, e.g. a string literal
+	void BeginScope(const char* name);
+	void EndScope();
+
+	// counts the fragments of the top level scopes begun from now on, reported per screen pixel; 0 stops
+	void SetFragmentCounting(unsigned int screenPixels) { mScreenPixels = screenPixels; }
+	bool IsCountingFragments() const { return mScreenPixels > 0; }
+
+	const std::vector<GpuScopeStats>& GetStats() const { return mStats; }
+	// total of the top level scopes in the last frame resolved
+	double GetFrameMilliseconds() const;
+	// one line per scope, indented by depth
+	void Dump(std::ostream& out) const;
+	// the most recent resolved scopes, oldest first
+	void GetTimeline(std::vector<GpuTimelineEvent>& events) const;
+	// deletes the query objects, dropping any results not yet read; call while the context is current
+	void Clear();
+
+private:
+	struct Scope
+	{
+		unsigned int stat;
+		unsigned int beginQuery; // into the frame's queries
+		unsigned int endQuery;
+		unsigned int sampleQuery; // into the frame's sample queries, if counted
+		int samplesPerPixel;
+	};
+
+	struct Frame
+	{
+		std::vector<unsigned int> queries;
+		unsigned int usedQueries = 0;
+		std::vector<unsigned int> sampleQueries;
+		unsigned int usedSampleQueries = 0;
+		std::vector<Scope> scopes;
+		bool pending = false;
+		long long clockOffset = 0; // CPU clock minus GPU clock when the frame began
+	};
+
+	void Resolve(Frame& frame);
+	void DumpChildren(std::ostream& out, int parent) const;
+	unsigned int NextQuery(Frame& frame);
+	unsigned int NextSampleQuery(Frame& frame);
+	unsigned int FindStat(const char* name, int parent);
+
+	Frame mFrames[GPU_PROFILER_FRAMES];
+	unsigned int mFrame = 0;
+	bool mInFrame = false;
+
+	// scopes open in the current frame, as indices into its scopes
+	unsigned int mOpenScopes[GPU_PROFILER_MAX_DEPTH];
+	unsigned int mDepth = 0;
+
+	std::vector<GpuScopeStats> mStats;
+	std::vector<GpuTimelineEvent> mTimeline;
+	unsigned long long mTimelineCount = 0;
+	unsigned int mSkippedFrames = 0;
+	unsigned int mScreenPixels = 0;
+};
+
+// Times the GL commands issued during its lifetime
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler& profiler, const char* name) : mProfiler(profiler) { mProfiler.BeginScope(name); }
+	~GpuScope() { mProfiler.EndScope(); }
+	GpuScope(const GpuScope&) = delete;
+	GpuScope& operator=(const GpuScope&) = delete;
+
+private:
+	GpuProfiler& mProfiler;
+};
\ No newline at end of file
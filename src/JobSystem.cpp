@@ -0,0 +1,275 @@
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+#include <cstdio>
+
+// worker index of the calling thread: the main thread is 0, the worker threads set theirs when they start
+static thread_local unsigned int tWorkerIndex = 0;
+
+JobSystem::~JobSystem()
+{
+	mQuit = true;
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+	}
+	mWake.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+}
+
+void JobSystem::Start(unsigned int numThreads)
+{
+	tWorkerIndex = 0;
+	for (unsigned int i = 0; i <= numThreads; i++)
+		mWorkers.push_back(std::make_unique<Worker>());
+	mStatsStart = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 1; i <= numThreads; i++)
+		mThreads.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+void JobSystem::Run(const std::function<void()>& job, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter)
+		counter->value++;
+
+	// not started: there is nothing to run the job on, and nothing else can be in flight to depend on
+	if (mWorkers.empty())
+	{
+		job();
+		Finish(counter);
+		return;
+	}
+
+	// checked under the lock Finish() takes to release pending jobs, so a job can't be parked after its release
+	if (dependency)
+	{
+		std::lock_guard<std::mutex> lock(mPendingMutex);
+		if (!dependency->IsDone())
+		{
+			mPendingJobs.push_back({ dependency, { job, counter } });
+			return;
+		}
+	}
+	Push({ job, counter });
+}
+
+void JobSystem::RunOnMainThread(const std::function<void()>& job, JobCounter* counter)
+{
+	if (counter)
+		counter->value++;
+	if (mWorkers.empty())
+	{
+		job();
+		Finish(counter);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mMainThreadMutex);
+	mMainThreadJobs.push_back({ job, counter });
+}
+
+void JobSystem::ExecuteMainThreadJobs()
+{
+	std::vector<Job> jobs;
+	{
+		std::lock_guard<std::mutex> lock(mMainThreadMutex);
+		jobs.swap(mMainThreadJobs);
+	}
+	for (Job& job : jobs)
+	{
+		{
+			CpuScope scope("Main thread job");
+			job.function();
+		}
+		Finish(job.counter);
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	// waiting on the main thread also runs the GL work handed to it, which the counter may be waiting for
+	while (!counter.IsDone())
+	{
+		if (tWorkerIndex == 0)
+			ExecuteMainThreadJobs();
+		if (!TryRunJob(tWorkerIndex))
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int batchSize, const std::function<void(unsigned int, unsigned int)>& body)
+{
+	batchSize = std::max(batchSize, 1u);
+	if (count <= batchSize || mWorkers.size() < 2)
+	{
+		if (count > 0)
+			body(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	for (unsigned int begin = batchSize; begin < count; begin += batchSize)
+	{
+		unsigned int end = std::min(begin + batchSize, count);
+		Run([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+	// the calling thread takes the first batch itself rather than going idle
+	{
+		CpuScope scope("Job");
+		body(0, batchSize);
+	}
+	Wait(counter);
+}
+
+unsigned int JobSystem::GetCurrentWorker()
+{
+	return tWorkerIndex;
+}
+
+void JobSystem::GetStats(std::vector<WorkerStats>& stats) const
+{
+	double elapsed = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - mStatsStart).count();
+	stats.clear();
+	for (const std::unique_ptr<Worker>& worker : mWorkers)
+		stats.push_back({ worker->jobsRun.load(), worker->steals.load(), elapsed > 0.0 ? (float)(worker->busyNanoseconds.load() / elapsed) : 0.0f });
+}
+
+void JobSystem::ResetStats()
+{
+	for (std::unique_ptr<Worker>& worker : mWorkers)
+	{
+		worker->busyNanoseconds = 0;
+		worker->jobsRun = 0;
+		worker->steals = 0;
+	}
+	mStatsStart = std::chrono::high_resolution_clock::now();
+}
+
+void JobSystem::WorkerLoop(unsigned int index)
+{
+	tWorkerIndex = index;
+	char name[32];
+	std::snprintf(name, sizeof(name), "Worker %u", index);
+	setProfilerThreadName(name);
+	while (!mQuit)
+	{
+		if (TryRunJob(index))
+			continue;
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mWake.wait(lock, [this]() { return mQuit || mQueuedJobs > 0; });
+	}
+}
+
+void JobSystem::Push(Job job)
+{
+	Worker& worker = *mWorkers[tWorkerIndex];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.PushBack(std::move(job));
+	}
+	mQueuedJobs++;
+
+	// taking the sleep lock orders the increment before any sleeping worker's predicate check
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+	}
+	mWake.notify_one();
+}
+
+bool JobSystem::TryRunJob(unsigned int index)
+{
+	Job job;
+	bool found = false;
+
+	// newest job from our own deque first: its data is most likely still in cache
+	Worker& self = *mWorkers[index];
+	{
+		std::lock_guard<std::mutex> lock(self.mutex);
+		if (!self.jobs.IsEmpty())
+		{
+			job = self.jobs.PopBack();
+			found = true;
+		}
+	}
+
+	// otherwise steal the oldest job of another worker, which tends to be the biggest piece of work left
+	for (unsigned int i = 1; !found && i < mWorkers.size(); i++)
+	{
+		Worker& victim = *mWorkers[(index + i) % mWorkers.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.IsEmpty())
+		{
+			job = victim.jobs.PopFront();
+			found = true;
+			self.steals++;
+		}
+	}
+	if (!found)
+		return false;
+	mQueuedJobs--;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		CpuScope scope("Job");
+		job.function();
+	}
+	self.busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	self.jobsRun++;
+	Finish(job.counter);
+	return true;
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (!counter || counter->value.fetch_sub(1) != 1)
+		return;
+
+	// the counter reached zero: release the jobs that were waiting on it
+	std::vector<Job> released;
+	{
+		std::lock_guard<std::mutex> lock(mPendingMutex);
+		for (int i = mPendingJobs.size() - 1; i >= 0; i--)
+		{
+			if (mPendingJobs[i].first == counter)
+			{
+				released.push_back(std::move(mPendingJobs[i].second));
+				mPendingJobs.erase(mPendingJobs.begin() + i);
+			}
+		}
+	}
+	for (Job& job : released)
+		Push(std::move(job));
+}
+
+void JobSystem::JobQueue::PushBack(Job job)
+{
+	if (mCount == mJobs.size())
+	{
+		// full: unroll into a ring twice the size
+		std::vector<Job> jobs(std::max(2 * (unsigned int)mJobs.size(), 64u));
+		for (unsigned int i = 0; i < mCount; i++)
+			jobs[i] = std::move(mJobs[(mHead + i) % mJobs.size()]);
+		mJobs.swap(jobs);
+		mHead = 0;
+	}
+	mJobs[(mHead + mCount) % mJobs.size()] = std::move(job);
+	mCount++;
+}
+
+JobSystem::Job JobSystem::JobQueue::PopBack()
+{
+	Job& slot = mJobs[(mHead + mCount - 1) % mJobs.size()];
+	Job job = std::move(slot);
+	slot = Job();
+	mCount--;
+	return job;
+}
+
+JobSystem::Job JobSystem::JobQueue::PopFront()
+{
+	Job& slot = mJobs[mHead];
+	Job job = std::move(slot);
+	slot = Job();
+	mHead = (mHead + 1) % mJobs.size();
+	mCount--;
+	return job;
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished jobs of a group. Jobs can wait on a counter, or be held back until it reaches zero.
+struct JobCounter
+{
+	std::atomic<int> value{ 0 };
+
+	bool IsDone() const { return value.load() == 0; }
+};
+
+struct WorkerStats
+{
+	unsigned int jobs;
+	unsigned int steals;
+	float utilisation; // fraction of the time since the last ResetStats() spent running jobs
+};
+
+// Work-stealing job system.
+// Every worker thread, and the main thread as worker 0, has its own queue: a worker pushes and pops jobs at
+// the back of its own queue and, when that runs dry, steals the oldest job from the front of another's.
+// The main thread runs jobs while it waits on a counter. GL calls must stay on the main thread, so jobs
+// hand them over with RunOnMainThread(); they run whenever the main thread waits or calls
+// ExecuteMainThreadJobs(). Until Start() is called everything runs inline on the calling thread.
+class JobSystem
+{
+public:
+	JobSystem() = default;
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// call from the main thread
+	void Start(unsigned int numThreads);
+
+	// counter (optional) is incremented now and decremented when the job finishes;
+	// the job isn't started before dependency (optional) reaches zero
+	void Run(const std::function<void()>& job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+	void RunOnMainThread(const std::function<void()>& job, JobCounter* counter = nullptr);
+	void ExecuteMainThreadJobs();
+
+	// runs other jobs until the counter reaches zero
+	void Wait(JobCounter& counter);
+	// body(begin, end) over [0, count) in batches of batchSize, returning when all batches are done
+	void ParallelFor(unsigned int count, unsigned int batchSize, const std::function<void(unsigned int, unsigned int)>& body);
+
+	unsigned int GetNumWorkers() const { return std::max((unsigned int)mWorkers.size(), 1u); }
+	// in [0, GetNumWorkers()), for per-worker data written from jobs
+	static unsigned int GetCurrentWorker();
+	// fills stats, one entry per worker
+	void GetStats(std::vector<WorkerStats>& stats) const;
+	void ResetStats();
+
+private:
+	struct Job
+	{
+		std::function<void()> function;
+		JobCounter* counter;
+	};
+
+	// Growable ring of jobs: the owner pushes and pops at the back, thieves take from the front.
+	// It keeps its capacity, so once the frames settle queueing a job doesn't allocate.
+	class JobQueue
+	{
+	public:
+		bool IsEmpty() const { return mCount == 0; }
+		void PushBack(Job job);
+		Job PopBack();
+		Job PopFront();
+
+	private:
+		std::vector<Job> mJobs;
+		unsigned int mHead = 0;
+		unsigned int mCount = 0;
+	};
+
+	struct Worker
+	{
+		JobQueue jobs;
+		std::mutex mutex;
+		std::atomic<long long> busyNanoseconds{ 0 };
+		std::atomic<unsigned int> jobsRun{ 0 };
+		std::atomic<unsigned int> steals{ 0 };
+	};
+
+	void WorkerLoop(unsigned int index);
+	void Push(Job job);
+	bool TryRunJob(unsigned int index);
+	void Finish(JobCounter* counter);
+
+	std::vector<std::unique_ptr<Worker>> mWorkers;
+	std::vector<std::thread> mThreads;
+
+	// idle workers sleep until a job is queued
+	std::atomic<int> mQueuedJobs{ 0 };
+	std::atomic<bool> mQuit{ false };
+	std::mutex mSleepMutex;
+	std::condition_variable mWake;
+
+	// jobs waiting on a dependency, released when its counter reaches zero
+	std::mutex mPendingMutex;
+	std::vector<std::pair<JobCounter*, Job>> mPendingJobs;
+
+	std::mutex mMainThreadMutex;
+	std::vector<Job> mMainThreadJobs;
+
+	std::chrono::high_resolution_clock::time_point mStatsStart;
+};
\ No newline at end of file
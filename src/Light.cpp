@@ -0,0 +1,31 @@
+#include "Light.h"
+#include <algorithm>
+#include <cmath>
+
+float calcLightRadius(const PointLight& light)
+{
+	// distance at which the attenuated diffuse contribution falls below 5/256
+	float maxChannel = std::max(std::max(light.diffuse.x, light.diffuse.y), light.diffuse.z);
+	float threshold = light.constant - maxChannel * (256.0f / 5.0f);
+	if (light.quadratic <= 0.0f)
+		return light.linear > 0.0f ? -threshold / light.linear : 100.0f;
+
+	return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * threshold)) / (2.0f * light.quadratic);
+}
+
+PointLightData packPointLight(const PointLight& light, float farPlane, int shadowTier, int shadowLayer)
+{
+	PointLightData data;
+	data.position = light.position;
+	data.constant = light.constant;
+	data.ambient = light.ambient;
+	data.linear = light.linear;
+	data.diffuse = light.diffuse;
+	data.quadratic = light.quadratic;
+	data.specular = light.specular;
+	data.farPlane = farPlane;
+	data.shadowTier = shadowTier;
+	data.shadowLayer = shadowLayer;
+	data.padding[0] = data.padding[1] = 0;
+	return data;
+}
\ No newline at end of file
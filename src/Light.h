@@ -0,0 +1,48 @@
+#pragma once
+#include <glm\glm.hpp>
+
+// light indices are uploaded as 16 bit values, see LightClusters
+const unsigned int MAX_POINT_LIGHTS = 1024;
+
+struct DirLight
+{
+	glm::vec3 direction;
+
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+};
+
+struct PointLight
+{
+	glm::vec3 position;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+
+	bool castsShadows;
+};
+
+// Five RGBA32F texels per light, unpacked by FetchPointLight in shaders/clustered_lights.txt
+struct PointLightData
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float farPlane;
+	int shadowTier;
+	int shadowLayer;
+	int padding[2];
+};
+
+float calcLightRadius(const PointLight& light);
+PointLightData packPointLight(const PointLight& light, float farPlane, int shadowTier, int shadowLayer);
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "LightClusters.h"
+#include "GpuMemory.h"
+#include <glad\glad.h>
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static GlTexture createTextureBuffer(unsigned int buffer, GLenum format)
+{
+	GlTexture texture = GlTexture::Create();
+	// a view of the stream buffer, which holds the memory
+	TRACK_GPU_OBJECT(GpuResourceType::Texture, texture, "light cluster buffer texture");
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	return texture;
+}
+
+LightClusters::LightClusters(JobSystem& jobs) :
+	mJobs(&jobs)
+{
+	mMinX.resize(NUM_CLUSTERS);
+	mMinY.resize(NUM_CLUSTERS);
+	mMinZ.resize(NUM_CLUSTERS);
+	mMaxX.resize(NUM_CLUSTERS);
+	mMaxY.resize(NUM_CLUSTERS);
+	mMaxZ.resize(NUM_CLUSTERS);
+	mClusterLights.resize(NUM_CLUSTERS * MAX_LIGHTS_PER_CLUSTER);
+	mClusterCounts.resize(NUM_CLUSTERS);
+	mGrid.resize(2 * NUM_CLUSTERS);
+
+	// A texture buffer only reaches GL_MAX_TEXTURE_BUFFER_SIZE texels into its buffer, which GL 3.3 only guarantees to
+	// be 65536, and each view covers every frame of its ring. Full lists for every cluster would be millions of R16UI
+	// texels, so the index lists get a ring of their own holding as many indices as the limit allows.
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	mIndexCapacity = std::min(NUM_CLUSTERS * MAX_LIGHTS_PER_CLUSTER, ((unsigned int)maxTexels / STREAM_BUFFER_FRAMES) & ~7u);
+	mIndices.reserve(mIndexCapacity);
+
+	// room for the most the arrays can hold, so a frame's upload always fits; both sizes are whole 16 byte blocks
+	unsigned int frameSize = MAX_POINT_LIGHTS * sizeof(PointLightData) + mGrid.size() * sizeof(unsigned int) + 2 * 16;
+	if ((unsigned long long)frameSize * STREAM_BUFFER_FRAMES / (2 * sizeof(unsigned int)) > (unsigned int)maxTexels)
+		std::cout << "Error::LightClusters::The light and cluster data need more than the " << maxTexels << " texels a texture buffer can reach" << std::endl;
+	mStream = StreamBuffer(GL_TEXTURE_BUFFER, frameSize);
+	mIndexStream = StreamBuffer(GL_TEXTURE_BUFFER, mIndexCapacity * sizeof(unsigned short));
+
+	// five RGBA32F texels per PointLightData, an RG32UI (offset, count) texel per cluster and an R16UI texel per index
+	mLightTexture = createTextureBuffer(mStream.GetBuffer(), GL_RGBA32F);
+	mGridTexture = createTextureBuffer(mStream.GetBuffer(), GL_RG32UI);
+	mIndexTexture = createTextureBuffer(mIndexStream.GetBuffer(), GL_R16UI);
+}
+
+void LightClusters::Build(const std::vector<PointLight>& lights, const Camera& camera)
+{
+	if (camera.GetFov() != mFov || camera.GetAspectRatio() != mAspectRatio || camera.GetNearPlane() != mNearPlane || camera.GetFarPlane() != mFarPlane)
+		UpdateClusterBounds(camera);
+
+	// light spheres in view space, with depth increasing into the screen to match the cluster bounds
+	glm::mat4 view = camera.GetViewMatrix();
+	unsigned int numLights = std::min((unsigned int)lights.size(), MAX_POINT_LIGHTS);
+	mLightSpheres.resize(numLights);
+	for (unsigned int i = 0; i < numLights; i++)
+	{
+		glm::vec4 centre = view * glm::vec4(lights[i].position, 1.0f);
+		mLightSpheres[i] = glm::vec4(centre.x, centre.y, -centre.z, calcLightRadius(lights[i]));
+	}
+
+	// one job per depth slice, so no two jobs ever write to the same cluster; near slices hold far more
+	// lights than distant ones, and small jobs let idle workers steal the remainder
+	mJobs->ParallelFor(CLUSTER_GRID_Z, 1, [this](unsigned int first, unsigned int last) { AssignLights(first, last); });
+
+	// pack the per cluster lists back to back, nearest slice first, cutting them short once the index capacity is used
+	// up so that any lights lost are in the distant clusters
+	mIndices.clear();
+	bool full = false;
+	for (unsigned int cluster = 0; cluster < NUM_CLUSTERS; cluster++)
+	{
+		const unsigned short* clusterLights = &mClusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+		unsigned int count = std::min(mClusterCounts[cluster], mIndexCapacity - (unsigned int)mIndices.size());
+		full = full || count < mClusterCounts[cluster];
+		mGrid[2 * cluster] = mIndices.size();
+		mGrid[2 * cluster + 1] = count;
+		mIndices.insert(mIndices.end(), clusterLights, clusterLights + count);
+	}
+	if (full && !mReportedFull)
+		std::cout << "Error::LightClusters::More light indices than the " << mIndexCapacity << " a texture buffer can hold: distant clusters lose lights" << std::endl;
+	mReportedFull = mReportedFull || full;
+}
+
+void LightClusters::Upload(const PointLightData* lightData, unsigned int numLights)
+{
+	numLights = std::min(numLights, MAX_POINT_LIGHTS);
+	mStream.BeginFrame();
+	// 16 byte aligned, so every offset is a whole number of texels of each format
+	mLightBase = mStream.Write(lightData, numLights * sizeof(PointLightData), 16) / (4 * sizeof(float));
+	mGridBase = mStream.Write(mGrid.data(), mGrid.size() * sizeof(unsigned int), 16) / (2 * sizeof(unsigned int));
+	mIndexStream.BeginFrame();
+	mIndexBase = mIndexStream.Write(mIndices.data(), mIndices.size() * sizeof(unsigned short), 16) / sizeof(unsigned short);
+}
+
+void LightClusters::EndFrame()
+{
+	mStream.EndFrame();
+	mIndexStream.EndFrame();
+}
+
+void LightClusters::BindTextures(unsigned int firstUnit) const
+{
+	glActiveTexture(GL_TEXTURE0 + firstUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, mLightTexture);
+	glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+	glBindTexture(GL_TEXTURE_BUFFER, mGridTexture);
+	glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+	glBindTexture(GL_TEXTURE_BUFFER, mIndexTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void LightClusters::SetUniforms(const Shader& shader, float screenWidth, float screenHeight) const
+{
+	// slice = log(depth) * scale - bias, the inverse of the exponential slice depths
+	float logDepthRange = std::log(mFarPlane / mNearPlane);
+	shader.SetVec2f("clusterTileSize", screenWidth / CLUSTER_GRID_X, screenHeight / CLUSTER_GRID_Y);
+	shader.SetFloat("clusterScale", CLUSTER_GRID_Z / logDepthRange);
+	shader.SetFloat("clusterBias", CLUSTER_GRID_Z * std::log(mNearPlane) / logDepthRange);
+	shader.SetInt("pointLightBase", mLightBase);
+	shader.SetInt("clusterGridBase", mGridBase);
+	shader.SetInt("clusterIndexBase", mIndexBase);
+}
+
+void LightClusters::UpdateClusterBounds(const Camera& camera)
+{
+	mFov = camera.GetFov();
+	mAspectRatio = camera.GetAspectRatio();
+	mNearPlane = camera.GetNearPlane();
+	mFarPlane = camera.GetFarPlane();
+	mTanHalfFovY = std::tan(glm::radians(mFov) * 0.5f);
+	mTanHalfFovX = mTanHalfFovY * mAspectRatio;
+
+	// exponential slices keep the clusters roughly cube shaped along the view depth
+	for (unsigned int z = 0; z <= CLUSTER_GRID_Z; z++)
+		mSliceDepths[z] = mNearPlane * std::pow(mFarPlane / mNearPlane, (float)z / CLUSTER_GRID_Z);
+
+	for (unsigned int z = 0; z < CLUSTER_GRID_Z; z++)
+	{
+		float nearDepth = mSliceDepths[z];
+		float farDepth = mSliceDepths[z + 1];
+		for (unsigned int y = 0; y < CLUSTER_GRID_Y; y++)
+		{
+			float bottom = (-1.0f + 2.0f * y / CLUSTER_GRID_Y) * mTanHalfFovY;
+			float top = (-1.0f + 2.0f * (y + 1) / CLUSTER_GRID_Y) * mTanHalfFovY;
+			for (unsigned int x = 0; x < CLUSTER_GRID_X; x++)
+			{
+				float left = (-1.0f + 2.0f * x / CLUSTER_GRID_X) * mTanHalfFovX;
+				float right = (-1.0f + 2.0f * (x + 1) / CLUSTER_GRID_X) * mTanHalfFovX;
+
+				// the froxel's corners lie on the tile's corner rays at the slice's near and far depths
+				unsigned int cluster = (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x;
+				mMinX[cluster] = std::min(left * nearDepth, left * farDepth);
+				mMaxX[cluster] = std::max(right * nearDepth, right * farDepth);
+				mMinY[cluster] = std::min(bottom * nearDepth, bottom * farDepth);
+				mMaxY[cluster] = std::max(top * nearDepth, top * farDepth);
+				mMinZ[cluster] = nearDepth;
+				mMaxZ[cluster] = farDepth;
+			}
+		}
+	}
+}
+
+void LightClusters::AssignLights(unsigned int firstSlice, unsigned int lastSlice)
+{
+	unsigned int sliceSize = CLUSTER_GRID_X * CLUSTER_GRID_Y;
+	std::fill(mClusterCounts.begin() + firstSlice * sliceSize, mClusterCounts.begin() + lastSlice * sliceSize, 0);
+
+	float sliceScale = CLUSTER_GRID_Z / std::log(mFarPlane / mNearPlane);
+	auto depthToSlice = [this, sliceScale](float depth) { return (int)std::floor(std::log(std::max(depth, mNearPlane) / mNearPlane) * sliceScale); };
+	auto ndcToTile = [](float ndc, unsigned int tiles) { return (int)std::floor((ndc * 0.5f + 0.5f) * tiles); };
+
+	for (unsigned int i = 0; i < mLightSpheres.size(); i++)
+	{
+		const glm::vec4& sphere = mLightSpheres[i];
+		float nearDepth = std::max(sphere.z - sphere.w, mNearPlane);
+		float farDepth = sphere.z + sphere.w;
+		if (farDepth < mNearPlane || nearDepth > mFarPlane)
+			continue;
+
+		int firstZ = std::max(depthToSlice(nearDepth), (int)firstSlice);
+		int lastZ = std::min(depthToSlice(farDepth), (int)lastSlice - 1);
+		if (firstZ > lastZ)
+			continue;
+
+		// conservative screen rectangle: the extremes of x / depth and y / depth over the sphere's bounding box
+		float minX = sphere.x - sphere.w, maxX = sphere.x + sphere.w;
+		float minY = sphere.y - sphere.w, maxY = sphere.y + sphere.w;
+		int firstX = std::max(ndcToTile((minX < 0.0f ? minX / nearDepth : minX / farDepth) / mTanHalfFovX, CLUSTER_GRID_X), 0);
+		int lastX = std::min(ndcToTile((maxX > 0.0f ? maxX / nearDepth : maxX / farDepth) / mTanHalfFovX, CLUSTER_GRID_X), (int)CLUSTER_GRID_X - 1);
+		int firstY = std::max(ndcToTile((minY < 0.0f ? minY / nearDepth : minY / farDepth) / mTanHalfFovY, CLUSTER_GRID_Y), 0);
+		int lastY = std::min(ndcToTile((maxY > 0.0f ? maxY / nearDepth : maxY / farDepth) / mTanHalfFovY, CLUSTER_GRID_Y), (int)CLUSTER_GRID_Y - 1);
+		if (firstX > lastX || firstY > lastY)
+			continue;
+
+		// sphere against four froxel AABBs at once: squared distance from the centre to the closest point of each box
+		__m128 centreX = _mm_set1_ps(sphere.x);
+		__m128 centreY = _mm_set1_ps(sphere.y);
+		__m128 centreZ = _mm_set1_ps(sphere.z);
+		__m128 radiusSq = _mm_set1_ps(sphere.w * sphere.w);
+		for (int z = firstZ; z <= lastZ; z++)
+		{
+			for (int y = firstY; y <= lastY; y++)
+			{
+				unsigned int row = (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X;
+				for (int x = firstX & ~3; x <= lastX; x += 4)
+				{
+					unsigned int cluster = row + x;
+					__m128 dx = _mm_sub_ps(_mm_max_ps(_mm_loadu_ps(&mMinX[cluster]), _mm_min_ps(centreX, _mm_loadu_ps(&mMaxX[cluster]))), centreX);
+					__m128 dy = _mm_sub_ps(_mm_max_ps(_mm_loadu_ps(&mMinY[cluster]), _mm_min_ps(centreY, _mm_loadu_ps(&mMaxY[cluster]))), centreY);
+					__m128 dz = _mm_sub_ps(_mm_max_ps(_mm_loadu_ps(&mMinZ[cluster]), _mm_min_ps(centreZ, _mm_loadu_ps(&mMaxZ[cluster]))), centreZ);
+					__m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					int hits = _mm_movemask_ps(_mm_cmple_ps(distSq, radiusSq));
+
+					for (int lane = 0; lane < 4; lane++)
+					{
+						if (!(hits & (1 << lane)) || x + lane < firstX || x + lane > lastX)
+							continue;
+						unsigned int& count = mClusterCounts[cluster + lane];
+						if (count < MAX_LIGHTS_PER_CLUSTER)
+							mClusterLights[(cluster + lane) * MAX_LIGHTS_PER_CLUSTER + count++] = i;
+					}
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
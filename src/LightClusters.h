@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include <glm\glm.hpp>
+#include "Light.h"
+#include "Camera.h"
+#include "Shader.h"
+#include "JobSystem.h"
+#include "StreamBuffer.h"
+
+// the lighting library (shaders/clustered_lights.txt) defines the same grid size
+const unsigned int CLUSTER_GRID_X = 16;
+const unsigned int CLUSTER_GRID_Y = 9;
+const unsigned int CLUSTER_GRID_Z = 24;
+const unsigned int NUM_CLUSTERS = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 256;
+
+// Clustered forward lighting.
+// The view frustum is split into screen tiles and exponential depth slices (froxels). Each frame
+// Build() tests every light's sphere of influence against the froxels it could touch, four froxels
+// at a time with SSE, with the depth slices shared out as jobs. Upload() then streams the
+// light data and an (offset, count) pair per cluster into one ring buffer and the packed light
+// index lists into another, read through three texture buffers, so that the shaders only loop over
+// the lights reaching each fragment's cluster. The index ring is sized to what a texture buffer can
+// reach, so with a small GL_MAX_TEXTURE_BUFFER_SIZE the most distant clusters can lose lights.
+// EndFrame() goes after the frame's last lit draw.
+class LightClusters
+{
+public:
+	LightClusters() = default;
+	LightClusters(JobSystem& jobs);
+
+	void Build(const std::vector<PointLight>& lights, const Camera& camera);
+	void Upload(const PointLightData* lightData, unsigned int numLights);
+	void EndFrame();
+	void BindTextures(unsigned int firstUnit) const;
+	void SetUniforms(const Shader& shader, float screenWidth, float screenHeight) const;
+
+	unsigned int GetNumIndices() const { return mIndices.size(); }
+
+private:
+	void UpdateClusterBounds(const Camera& camera);
+	void AssignLights(unsigned int firstSlice, unsigned int lastSlice);
+
+	JobSystem* mJobs = nullptr;
+
+	// the projection the cluster bounds were built for
+	float mFov = 0.0f;
+	float mAspectRatio = 0.0f;
+	float mNearPlane = 0.0f;
+	float mFarPlane = 0.0f;
+
+	// view space bounds of each cluster (depth is positive into the screen), stored as separate
+	// arrays so that four neighbouring clusters in a row load straight into SSE registers
+	std::vector<float> mMinX, mMinY, mMinZ;
+	std::vector<float> mMaxX, mMaxY, mMaxZ;
+	float mSliceDepths[CLUSTER_GRID_Z + 1];
+
+	// this frame's lights as view space spheres (xyz = centre, w = radius)
+	std::vector<glm::vec4> mLightSpheres;
+	float mTanHalfFovX = 0.0f;
+	float mTanHalfFovY = 0.0f;
+
+	// per cluster light lists filled by the jobs, MAX_LIGHTS_PER_CLUSTER entries per cluster
+	std::vector<unsigned short> mClusterLights;
+	std::vector<unsigned int> mClusterCounts;
+
+	// packed for the GPU: offset and count per cluster, then the light indices back to back
+	std::vector<unsigned int> mGrid;
+	std::vector<unsigned short> mIndices;
+	unsigned int mIndexCapacity = 0; // most indices a frame can upload
+	bool mReportedFull = false;
+
+	// the texture buffers view the whole ring, and the shaders add this frame's texel offsets
+	StreamBuffer mStream;
+	StreamBuffer mIndexStream;
+	unsigned int mLightBase = 0;
+	unsigned int mGridBase = 0;
+	unsigned int mIndexBase = 0;
+	GlTexture mLightTexture;
+	GlTexture mGridTexture;
+	GlTexture mIndexTexture;
+};
\ No newline at end of file
@@ -13,6 +13,36 @@
 #include "BasicMeshes.h"
 #include "Utility.h"
 #include "BasicMesh.h"
+#include "Light.h"
+#include "ShadowAtlas.h"
+#include "CascadedShadowMap.h"
+#include "LightClusters.h"
+#include "Foliage.h"
+#include "SceneGraph.h"
+#include "Resources.h"
+#include "EntityStore.h"
+#include "CommandList.h"
+#include "StreamBuffer.h"
+#include "FrameArena.h"
+#include "AllocationTracker.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "RenderStats.h"
+#include "CameraPath.h"
+#include "Regression.h"
+#include "GlInterceptor.h"
+#include "GlReplay.h"
+#include "GpuMemory.h"
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
 
 // create a first-person camera
 Camera camera(0.0f, 1.5f, 2.0f);
@@ -21,34 +51,346 @@ Camera camera(0.0f, 1.5f, 2.0f);
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// window size
+int screenWidth = 1024;
+int screenHeight = 720;
+
 // Game loop functions
 void processInput(GLFWwindow* window);
 void update();
-void render(GLFWwindow* window);
+void render();
+
+// Scene drawing functions
+enum class DrawOrder { Material, FrontToBack, Entity };
+void buildScene();
+void recordDraws(CommandList& commands, const std::vector<unsigned int>& drawList, DrawOrder order);
+void drawOpaqueObjects(Shader& shader);
+void drawShadowCasters(const Shader& shader, const std::function<bool(const AABB&)>& reachesShadowMap);
+bool bindTransform(const glm::mat4& model);
+void drawLightCubes(const Shader& shader);
+void drawWindows(const Shader& shader);
+void drawGlassPanes(const Shader& shader, const Frustum& viewFrustum);
+void drawOverdraw(const Frustum& viewFrustum);
+void drawTextureFeedback();
+unsigned int loadRegisteredTexture(const std::string& path, bool srgb, JobCounter& counter);
+unsigned int loadMaterialTexture(const std::string& path, bool srgb, JobCounter& counter);
+
+// Stress mode functions
+unsigned int spawnStressLights(unsigned int count, unsigned int seed, const glm::vec3& areaMin = glm::vec3(-4.5f, 0.3f, -7.5f), const glm::vec3& areaMax = glm::vec3(4.5f, 2.8f, 1.5f));
+struct StressSceneConfig;
+bool parseStressScene(const std::string& text, StressSceneConfig& config);
+void buildStressScene(const StressSceneConfig& config, unsigned int plantTexture);
+void runEntityBenchmark();
+void checkFrameAllocations(GLFWwindow* window, const AllocationCounts& frameStart);
+void recordBenchmarkFrame(GLFWwindow* window, long long frameStartTime);
+bool writeBenchmarkReport(const std::string& path);
+
+// Resources: registered by name while loading, then only used through their handles
+ResourceRegistry<Shader> shaderRegistry;
+ResourceRegistry<GlTexture, TextureTag> textureRegistry;
+ResourceRegistry<Model> modelRegistry;
+ResourceRegistry<Framebuffer> framebufferRegistry;
+ResourceRegistry<BasicMesh> meshRegistry;
+
+struct
+{
+	ShaderHandle object, lightCube, transparency, window, depth, cascadeDepth, gbuffer, deferredLighting, depthPrepass, oitComposite, foliage;
+	ShaderHandle overdraw, foliageOverdraw, overdrawComposite, textureFeedback;
+} shaders;
+struct
+{
+	MeshHandle cube, glassPane, window, floor, box, invertedCube, parallaxCube;
+} meshes;
+struct
+{
+	ModelHandle nanosuit;
+} models;
+struct
+{
+	TextureHandle skybox;
+} textures;
+struct
+{
+	FramebufferHandle gbuffer, scene, transparency, overdraw;
+} framebuffers;
+
+// Uniform data rewritten every frame, the "Matrices" block and each draw's "Transform", streamed through a ring
+// of frames in flight and bound with glBindBufferRange; 1 MB a frame is 4096 draws at a 256 byte alignment
+StreamBuffer frameUniforms;
+unsigned int uniformBufferAlignment = 256;
+
+// Scene graph nodes of the objects that aren't opaque entities
+struct
+{
+	unsigned int leftWindow, rightWindow, glassPane;
+} nodes;
+
+// Lights
+std::vector<PointLight> pointLights;
+ShadowAtlas shadowAtlas;
+DirLight dirLight;
+CascadedShadowMap cascadedShadowMap;
+LightClusters lightClusters;
 
-// Maps
-std::map<std::string, Shader> shaderMap;
-std::map<std::string, unsigned int> textureMap;
-std::map<std::string, Model> modelMap;
-std::map<std::string, unsigned int> framebufferMap;
-std::map<std::string, unsigned int> uboMap;
+// Scattered plants
+Foliage foliage;
 
-std::map<std::string, BasicMesh> meshMap;
+// Transforms of everything in the scene, rebuilt once per frame where they changed and shared by every pass
+SceneGraph sceneGraph;
+std::vector<unsigned int> rotatingBoxes;
+
+// The opaque objects, the entities each pass draws this frame and the draws recorded for them
+EntityStore entities;
+std::vector<unsigned int> opaqueDrawList;
+std::vector<unsigned int> shadowDrawList;
+CommandList opaqueCommands;
+CommandList shadowCommands;
+
+// Stress mode: "--stress-lights N" adds N animated point lights
+struct StressLightOrbit
+{
+	unsigned int light; // index into pointLights
+	glm::vec3 centre;
+	float radius;
+	float speed;
+	float phase;
+};
+std::vector<StressLightOrbit> stressLightOrbits;
+
+// "--stress-scene S" fills the room and the ground around it with generated objects, to measure how culling,
+// submission and shading scale with the scene: S is a scenario of 10, 1k, 10k or 100k objects, or the counts
+// "crates,nanosuits,plants,panes,lights". Positions, sizes, which objects spin, the plant scatter and the lights'
+// orbits all come from the seed ("--stress-seed N"), so a scenario is the same scene every run.
+struct StressSceneConfig
+{
+	std::string name;
+	unsigned int crates = 0;
+	unsigned int nanosuits = 0;
+	unsigned int plants = 0;
+	unsigned int glassPanes = 0;
+	unsigned int pointLights = 0;
+	unsigned int seed = 1234;
+};
+StressSceneConfig stressScene;
+// the fraction of the crates, nanosuits and panes that spin
+const float STRESS_SPINNING_FRACTION = 0.25f;
+struct StressSpinner
+{
+	unsigned int node;
+	float speed; // radians per second
+	float phase;
+};
+std::vector<StressSpinner> stressSpinners;
+std::vector<unsigned int> stressGlassPanes; // scene graph nodes
+Foliage stressFoliage;
+
+// "--frame-times" (implied by the stress modes) prints the average frame time every two seconds
+bool reportFrameTimes = false;
+float frameTimeSum = 0.0f;
+unsigned int frameCount = 0;
+float lastFrameTimeReport = 0.0f;
+
+// "--check-allocations" runs the scene for a while and exits with 1 if any frame after the warm-up allocated
+// through operator new, 0 otherwise. Use a Release build: the debug runtime allocates for its iterator checks.
+bool checkAllocations = false;
+const unsigned int ALLOCATION_CHECK_WARMUP_FRAMES = 120;
+const unsigned int ALLOCATION_CHECK_FRAMES = 600;
+unsigned int allocationCheckFrame = 0;
+unsigned int allocatingFrames = 0;
+int exitCode = 0;
+
+// "--benchmark N" renders N frames, after a warm-up, in a hidden window without vsync. Time advances by a fixed
+// step per frame and the camera follows a fixed path instead of the input, so every run of the same options draws
+// the same images. The frame time percentiles, draw calls and triangles go to benchmark.json, or to the file
+// given with "--benchmark-report".
+bool benchmark = false;
+const float BENCHMARK_TIMESTEP = 1.0f / 60.0f;
+const unsigned int BENCHMARK_WARMUP_FRAMES = 60;
+unsigned int benchmarkFrames = 0;
+unsigned int benchmarkFrame = 0;
+std::string benchmarkReportPath = "benchmark.json";
+CameraPath benchmarkPath;
+std::vector<double> benchmarkFrameTimes; // milliseconds
+std::vector<RenderStats> benchmarkRenderStats;
+
+// "--regression" draws fixed poses of the scene in a hidden window and checks each against a reference image and
+// its CPU and GPU times against a baseline, exiting with 1 on any failure; "--regression-update" stores new
+// references instead. It is a mode of the executable, so it builds and runs wherever the Visual Studio project does.
+bool regression = false;
+RegressionOptions regressionOptions;
+RegressionTest regressionTest;
+
+// "--uniform-buffer-kb N" starts the per-frame uniforms at N KB a frame instead of the size worked out from the scene,
+// so the first frames overflow and the buffer grows. With "--regression" over a stress scene whose references were
+// stored without it, e.g. "--stress-scene 1k --uniform-buffer-kb 4 --regression", it checks that the scene renders the
+// same once the buffer has grown.
+unsigned int uniformBufferKb = 0;
+
+// "--gl-intercept" wraps the GL entry points to count calls, redundant state changes and time spent in the driver,
+// printed with the frame times, at the end of a benchmark and on F5
+bool interceptGl = false;
+
+// "--capture path N" records every GL call of the loading and the first N frames, with the data they upload, and
+// "--replay path" plays such a capture back on its own, as fast as it can or, with "--replay-paced", at the pace it
+// was recorded, to time the driver without the renderer's CPU work in the way
+std::string captureGlPath;
+unsigned int captureGlFrames = 0;
+std::string replayGlPath;
+bool replayGlPaced = false;
+
+// "--gpu-memory" prints the GPU memory held by each kind of GL object once loading is done, and every object never
+// deleted at exit; F8 prints the memory at any time
+bool reportGpuMemory = false;
+
+// "--texture-budget MB" streams the mips of the opaque objects' material textures into at most MB of texture memory,
+// as a feedback pass finds them needed, instead of loading them whole; F9 prints what each texture has resident
+unsigned int textureBudget = 0;
+TextureStreamer textureStreamer;
+
+// GPU time per pass, printed with the frame times and on F3
+GpuProfiler gpuProfiler;
+
+// Memory for data that only lives until the end of the frame, reset at the top of each frame
+FrameArena frameArena;
+
+// Worker threads for the parallel parts of loading and of each frame; the main thread also runs jobs while it waits
+JobSystem jobSystem;
 
 // uniforms
 float heightScale = 0.1f;
 
-int main()
+// Debug views, cycled with F6 or chosen with "--debug-view overdraw|parallax": the overdraw view shows how many
+// fragments land on each pixel, the parallax view how many layers the parallax mapping steps through (opaque
+// objects are then shaded forward). "--count-fragments" (F7 toggles) adds the fragments each pass shades, from
+// occlusion queries, to the GPU times.
+enum class DebugView { None, Overdraw, ParallaxCost };
+DebugView debugView = DebugView::None;
+bool countFragments = false;
+// the overdraw shown as red
+const float MAX_OVERDRAW = 8.0f;
+
+// renderer: opaque objects are shaded forward, or through the G-buffer when deferred shading is on (F1 toggles)
+bool deferredShading = false;
+// lay down the opaque depth first so that the expensive object shading runs once per pixel (F2 toggles)
+bool depthPrepass = false;
+
+int main(int argc, char* argv[])
 {
+	setProfilerThreadName("Main thread");
+	jobSystem.Start(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+	unsigned int stressLights = 0;
+	unsigned int foliageCount = 3000;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--stress-lights" && i + 1 < argc)
+		{
+			stressLights = std::stoi(argv[++i]);
+			reportFrameTimes = true;
+		}
+		else if (arg == "--deferred")
+			deferredShading = true;
+		else if (arg == "--depth-prepass")
+			depthPrepass = true;
+		else if (arg == "--foliage" && i + 1 < argc)
+			foliageCount = std::stoi(argv[++i]);
+		else if (arg == "--stress-scene" && i + 1 < argc)
+		{
+			if (!parseStressScene(argv[++i], stressScene))
+			{
+				std::cout << "Error::Main::Unknown stress scene " << argv[i] << ": use 10, 1k, 10k, 100k or crates,nanosuits,plants,panes,lights" << std::endl;
+				return -1;
+			}
+			reportFrameTimes = true;
+		}
+		else if (arg == "--stress-seed" && i + 1 < argc)
+			stressScene.seed = std::stoi(argv[++i]);
+		else if (arg == "--frame-times")
+			reportFrameTimes = true;
+		else if (arg == "--check-allocations")
+			checkAllocations = true;
+		else if (arg == "--gl-intercept")
+			interceptGl = true;
+		else if (arg == "--debug-view" && i + 1 < argc)
+		{
+			std::string view = argv[++i];
+			if (view == "overdraw")
+				debugView = DebugView::Overdraw;
+			else if (view == "parallax")
+				debugView = DebugView::ParallaxCost;
+			else
+			{
+				std::cout << "Error::Main::Unknown debug view " << view << ": use overdraw or parallax" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--count-fragments")
+			countFragments = true;
+		else if (arg == "--gpu-memory")
+			reportGpuMemory = true;
+		else if (arg == "--texture-budget" && i + 1 < argc)
+			textureBudget = std::max(std::stoi(argv[++i]), 1);
+		else if (arg == "--capture" && i + 2 < argc)
+		{
+			captureGlPath = argv[++i];
+			captureGlFrames = std::max(std::stoi(argv[++i]), 1);
+		}
+		else if (arg == "--replay" && i + 1 < argc)
+			replayGlPath = argv[++i];
+		else if (arg == "--replay-paced")
+			replayGlPaced = true;
+		else if (arg == "--benchmark" && i + 1 < argc)
+		{
+			benchmark = true;
+			benchmarkFrames = std::max(std::stoi(argv[++i]), 1);
+		}
+		else if (arg == "--benchmark-report" && i + 1 < argc)
+			benchmarkReportPath = argv[++i];
+		else if (arg == "--regression")
+			regression = true;
+		else if (arg == "--regression-update")
+			regression = regressionOptions.update = true;
+		else if (arg == "--regression-dir" && i + 1 < argc)
+			regressionOptions.directory = argv[++i];
+		else if (arg == "--regression-pixel-threshold" && i + 1 < argc)
+			regressionOptions.pixelThreshold = std::stof(argv[++i]);
+		else if (arg == "--regression-max-changed" && i + 1 < argc)
+			regressionOptions.maxChangedPixels = std::stof(argv[++i]);
+		else if (arg == "--regression-time-threshold" && i + 1 < argc)
+			regressionOptions.timeThreshold = std::stof(argv[++i]);
+		else if (arg == "--uniform-buffer-kb" && i + 1 < argc)
+			uniformBufferKb = std::max(std::stoi(argv[++i]), 1);
+		else if (arg == "--entity-benchmark")
+		{
+			runEntityBenchmark();
+			return 0;
+		}
+		else if (arg == "--resolution" && i + 1 < argc)
+		{
+			// e.g. "--resolution 1920x1080"
+			std::string resolution = argv[++i];
+			screenWidth = std::stoi(resolution.substr(0, resolution.find('x')));
+			screenHeight = std::stoi(resolution.substr(resolution.find('x') + 1));
+			camera.SetAspectRatio((float)screenWidth / screenHeight);
+		}
+	}
+
 	// Initialise GLFW
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_SAMPLES, 4);
+	if (!replayGlPath.empty() && !readGlCaptureSize(replayGlPath, screenWidth, screenHeight))
+	{
+		std::cout << "Error::Main::Can't read GL capture " << replayGlPath << std::endl;
+		return -1;
+	}
+	if (benchmark || regression || !replayGlPath.empty())
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 
 	// Create window
-	GLFWwindow* window = glfwCreateWindow(1024, 720, "OpenGL", NULL, NULL);
+	GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "OpenGL", NULL, NULL);
 	if (!window)
 	{
 		std::cout << "Failed to create window" << std::endl;
@@ -59,8 +401,11 @@ int main()
 	// Set callback functions
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
-	// Capture cursor within window
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	// Capture cursor within window; a benchmark runs as fast as it can instead
+	if (benchmark || regression || !replayGlPath.empty())
+		glfwSwapInterval(0);
+	else
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	// Load OpenGL function pointers
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -68,9 +413,34 @@ int main()
 		std::cout << "Failed to initialise GLAD" << std::endl;
 		return -1;
 	}
+	if (interceptGl)
+		installGlInterceptor();
+
+	if (!replayGlPath.empty())
+	{
+		bool replayed = replayGlCapture(replayGlPath, replayGlPaced, [window]()
+		{
+			glfwSwapBuffers(window);
+			endGlInterceptorFrame();
+			glfwPollEvents();
+			return !glfwWindowShouldClose(window);
+		});
+		if (interceptGl)
+			dumpGlInterceptor(std::cout, 20);
+		glfwTerminate();
+		return replayed ? 0 : 1;
+	}
+	if (!captureGlPath.empty())
+	{
+		// uploads through persistently mapped buffers would never reach the capture, so stream through glBufferData
+#ifdef GL_ARB_buffer_storage
+		GLAD_GL_ARB_buffer_storage = 0;
+#endif
+		startGlCapture(captureGlPath, captureGlFrames, screenWidth, screenHeight);
+	}
 
 	// Set default viewport
-	glViewport(0, 0, 1024, 720);
+	glViewport(0, 0, screenWidth, screenHeight);
 
 	// Enable depth testing
 	glEnable(GL_DEPTH_TEST);
@@ -78,44 +448,103 @@ int main()
 	// Enable face culling
 	glEnable(GL_CULL_FACE);
 
-	// MSAA
+	// MSAA, on the offscreen scene framebuffer
 	glEnable(GL_MULTISAMPLE);
 
 	// Load shaders and set the uniforms that will not change each frame
-	shaderMap["object"] = Shader("shaders/object_vs.txt", "shaders/object_fs.txt");
-	shaderMap["light cube"] = Shader("shaders/object_vs.txt", "shaders/light_cube_fs.txt");
-	shaderMap["transparency"] = Shader("shaders/object_vs.txt", "shaders/transparency_fs.txt");
-	shaderMap["window"] = Shader("shaders/window_vs.txt", "shaders/window_fs.txt");
-	shaderMap["depth"] = Shader("shaders/depth_map_vs.txt", "shaders/depth_map_fs.txt", "shaders/depth_map_gs.txt");
-
-	shaderMap["object"].Use();
-	shaderMap["object"].SetInt("depthMap", 4);
-	shaderMap["object"].SetFloat("material.shininess", 32.0f);
-	shaderMap["object"].SetFloat("pointLight.constant", 1.0f);
-	shaderMap["object"].SetFloat("pointLight.linear", 0.22f);
-	shaderMap["object"].SetFloat("pointLight.quadratic", 0.20f);
-	shaderMap["object"].SetVec3f("pointLight.ambient", 0.05f, 0.05f, 0.05f);
-	shaderMap["object"].SetVec3f("pointLight.diffuse", 0.96f, 0.75f, 0.26f);
-	shaderMap["object"].SetVec3f("pointLight.specular", 1.0f, 1.0f, 1.0f);
-	shaderMap["object"].SetFloat("heightScale", 0.1f);
-	shaderMap["transparency"].Use();
-	shaderMap["transparency"].SetFloat("material.shininess", 32.0f);
-	shaderMap["transparency"].SetFloat("pointLight.constant", 1.0f);
-	shaderMap["transparency"].SetFloat("pointLight.linear", 0.22f);
-	shaderMap["transparency"].SetFloat("pointLight.quadratic", 0.20f);
-	shaderMap["transparency"].SetVec3f("pointLight.ambient", 0.05f, 0.05f, 0.05f);
-	shaderMap["transparency"].SetVec3f("pointLight.diffuse", 0.96f, 0.75f, 0.26f);
-	shaderMap["transparency"].SetVec3f("pointLight.specular", 1.0f, 1.0f, 1.0f);
-	shaderMap["window"].Use();
-	shaderMap["window"].SetFloat("material.shininess", 32.0f);
-	shaderMap["window"].SetFloat("pointLight.constant", 1.0f);
-	shaderMap["window"].SetFloat("pointLight.linear", 0.22f);
-	shaderMap["window"].SetFloat("pointLight.quadratic", 0.20f);
-	shaderMap["window"].SetVec3f("pointLight.ambient", 0.05f, 0.05f, 0.05f);
-	shaderMap["window"].SetVec3f("pointLight.diffuse", 0.96f, 0.75f, 0.26f);
-	shaderMap["window"].SetVec3f("pointLight.specular", 1.0f, 1.0f, 1.0f);
-
-	// Load textures
+	shaders.object = shaderRegistry.Add("object", Shader("shaders/object_vs.txt", "shaders/object_fs.txt"));
+	shaders.lightCube = shaderRegistry.Add("light cube", Shader("shaders/object_vs.txt", "shaders/light_cube_fs.txt"));
+	shaders.transparency = shaderRegistry.Add("transparency", Shader("shaders/object_vs.txt", "shaders/transparency_fs.txt"));
+	shaders.window = shaderRegistry.Add("window", Shader("shaders/window_vs.txt", "shaders/window_fs.txt"));
+	shaders.depth = shaderRegistry.Add("depth", Shader("shaders/depth_map_vs.txt", "shaders/depth_map_fs.txt", "shaders/depth_map_gs.txt"));
+	shaders.cascadeDepth = shaderRegistry.Add("cascade depth", Shader("shaders/cascade_depth_vs.txt", "shaders/cascade_depth_fs.txt"));
+	shaders.gbuffer = shaderRegistry.Add("gbuffer", Shader("shaders/object_vs.txt", "shaders/gbuffer_fs.txt"));
+	shaders.deferredLighting = shaderRegistry.Add("deferred lighting", Shader("shaders/fullscreen_vs.txt", "shaders/deferred_lighting_fs.txt"));
+	shaders.depthPrepass = shaderRegistry.Add("depth prepass", Shader("shaders/depth_prepass_vs.txt", "shaders/cascade_depth_fs.txt"));
+	shaders.oitComposite = shaderRegistry.Add("oit composite", Shader("shaders/fullscreen_vs.txt", "shaders/oit_composite_fs.txt"));
+	shaders.foliage = shaderRegistry.Add("foliage", Shader("shaders/foliage_vs.txt", "shaders/foliage_fs.txt"));
+	shaders.overdraw = shaderRegistry.Add("overdraw", Shader("shaders/object_vs.txt", "shaders/overdraw_fs.txt"));
+	shaders.foliageOverdraw = shaderRegistry.Add("foliage overdraw", Shader("shaders/foliage_vs.txt", "shaders/overdraw_fs.txt"));
+	shaders.overdrawComposite = shaderRegistry.Add("overdraw composite", Shader("shaders/fullscreen_vs.txt", "shaders/overdraw_composite_fs.txt"));
+	shaders.textureFeedback = shaderRegistry.Add("texture feedback", Shader("shaders/object_vs.txt", "shaders/texture_feedback_fs.txt"));
+
+	shaderRegistry[shaders.object].Use();
+	shaderRegistry[shaders.object].SetInt("shadowMaps[0]", 4);
+	shaderRegistry[shaders.object].SetInt("shadowMaps[1]", 5);
+	shaderRegistry[shaders.object].SetInt("shadowMaps[2]", 6);
+	shaderRegistry[shaders.object].SetInt("cascadeShadowMap", 7);
+	shaderRegistry[shaders.object].SetFloat("material.shininess", 32.0f);
+	shaderRegistry[shaders.object].SetFloat("heightScale", 0.1f);
+	shaderRegistry[shaders.transparency].Use();
+	shaderRegistry[shaders.transparency].SetFloat("material.shininess", 32.0f);
+	shaderRegistry[shaders.window].Use();
+	shaderRegistry[shaders.window].SetFloat("material.shininess", 32.0f);
+	shaderRegistry[shaders.deferredLighting].Use();
+	shaderRegistry[shaders.deferredLighting].SetInt("gAlbedo", 0);
+	shaderRegistry[shaders.deferredLighting].SetInt("gNormal", 1);
+	shaderRegistry[shaders.deferredLighting].SetInt("gDepth", 2);
+	shaderRegistry[shaders.deferredLighting].SetInt("gSpecular", 3);
+	shaderRegistry[shaders.deferredLighting].SetInt("shadowMaps[0]", 4);
+	shaderRegistry[shaders.deferredLighting].SetInt("shadowMaps[1]", 5);
+	shaderRegistry[shaders.deferredLighting].SetInt("shadowMaps[2]", 6);
+	shaderRegistry[shaders.deferredLighting].SetInt("cascadeShadowMap", 7);
+	shaderRegistry[shaders.deferredLighting].SetFloat("shininess", 32.0f);
+	shaderRegistry[shaders.oitComposite].Use();
+	shaderRegistry[shaders.oitComposite].SetInt("sceneColour", 0);
+	shaderRegistry[shaders.oitComposite].SetInt("accumColourTexture", 1);
+	shaderRegistry[shaders.oitComposite].SetInt("accumAlphaTexture", 2);
+	shaderRegistry[shaders.oitComposite].SetInt("numSamples", 4);
+	shaderRegistry[shaders.foliage].Use();
+	shaderRegistry[shaders.foliage].SetFloat("fadeStart", 4.0f);
+	shaderRegistry[shaders.foliage].SetFloat("fadeEnd", 9.0f);
+	shaderRegistry[shaders.foliageOverdraw].Use();
+	shaderRegistry[shaders.foliageOverdraw].SetFloat("fadeStart", 4.0f);
+	shaderRegistry[shaders.foliageOverdraw].SetFloat("fadeEnd", 9.0f);
+	shaderRegistry[shaders.overdrawComposite].Use();
+	shaderRegistry[shaders.overdrawComposite].SetInt("overdraw", 0);
+	shaderRegistry[shaders.overdrawComposite].SetFloat("maxOverdraw", MAX_OVERDRAW);
+	ShaderHandle litShaders[] = { shaders.object, shaders.transparency, shaders.window, shaders.deferredLighting, shaders.foliage };
+	for (ShaderHandle handle : litShaders)
+	{
+		Shader& shader = shaderRegistry[handle];
+		shader.Use();
+		shader.SetInt("pointLightData", 8);
+		shader.SetInt("clusterGrid", 9);
+		shader.SetInt("clusterLightIndices", 10);
+	}
+
+	// Lights
+	PointLight light;
+	light.position = glm::vec3(2.0f, 2.0f, -2.0f);
+	light.constant = 1.0f;
+	light.linear = 0.22f;
+	light.quadratic = 0.20f;
+	light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	light.diffuse = glm::vec3(0.96f, 0.75f, 0.26f);
+	light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	light.castsShadows = true;
+	pointLights.push_back(light);
+	spawnStressLights(stressLights, stressScene.seed);
+
+	dirLight.direction = glm::vec3(-0.4f, -1.0f, -0.3f);
+	dirLight.ambient = glm::vec3(0.02f, 0.02f, 0.025f);
+	dirLight.diffuse = glm::vec3(0.25f, 0.25f, 0.3f);
+	dirLight.specular = glm::vec3(0.3f, 0.3f, 0.3f);
+	for (ShaderHandle handle : litShaders)
+	{
+		Shader& shader = shaderRegistry[handle];
+		shader.Use();
+		shader.SetBool("dirLightEnabled", true);
+		shader.SetVec3f("dirLight.direction", dirLight.direction);
+		shader.SetVec3f("dirLight.ambient", dirLight.ambient);
+		shader.SetVec3f("dirLight.diffuse", dirLight.diffuse);
+		shader.SetVec3f("dirLight.specular", dirLight.specular);
+	}
+
+	// Load textures: decoded by jobs while the meshes and models load, uploaded on this thread
+	JobCounter textureLoads;
+	if (textureBudget > 0)
+		textureStreamer.Init(jobSystem, screenWidth, screenHeight, textureBudget * 1024ull * 1024);
 	std::vector<std::string> skyboxTextures =
 	{
 		"textures/skybox/right.jpg",
@@ -125,349 +554,1178 @@ int main()
 		"textures/skybox/front.jpg",
 		"textures/skybox/back.jpg"
 	};
-	textureMap["skybox"] = loadCubemap(skyboxTextures);
+	textures.skybox = textureRegistry.Add("skybox", loadCubemap(skyboxTextures));
 
 	std::vector<Texture> wallTextures =
 	{
-		{loadTextureSRGB("textures/wall_diffuse.jpg"), "texture_diffuse"},
-		{loadTexture("textures/wall_specular.jpg"), "texture_specular"},
-		{loadTexture("textures/wall_normal.jpg"), "texture_normal"}
+		{loadMaterialTexture("textures/wall_diffuse.jpg", true, textureLoads), "texture_diffuse"},
+		{loadMaterialTexture("textures/wall_specular.jpg", false, textureLoads), "texture_specular"},
+		{loadMaterialTexture("textures/wall_normal.jpg", false, textureLoads), "texture_normal"}
 	};
 
 	std::vector<Texture> floorTextures =
 	{
-		{loadTextureSRGB("textures/wood_floor_diffuse.jpg"), "texture_diffuse"},
-		{loadTexture("textures/wood_floor_specular.jpg"), "texture_specular"},
-		{loadTexture("textures/wood_floor_normal.jpg"), "texture_normal"}
+		{loadMaterialTexture("textures/wood_floor_diffuse.jpg", true, textureLoads), "texture_diffuse"},
+		{loadMaterialTexture("textures/wood_floor_specular.jpg", false, textureLoads), "texture_specular"},
+		{loadMaterialTexture("textures/wood_floor_normal.jpg", false, textureLoads), "texture_normal"}
 	};
 
 	std::vector<Texture> glassPaneTextures =
 	{
-		{loadTextureSRGB("textures/glass.png"), "texture_diffuse"},
-		{0, "texture_specular"}
-	};
-
-	std::vector<Texture> plantTextures =
-	{
-		{loadTextureSRGB("textures/tree.png"), "texture_diffuse"},
+		{loadRegisteredTexture("textures/glass.png", true, textureLoads), "texture_diffuse"},
 		{0, "texture_specular"}
 	};
 
 	std::vector<Texture> windowTextures =
 	{
-		{loadTextureSRGB("textures/window.png"), "texture_diffuse"},
+		{loadRegisteredTexture("textures/window.png", true, textureLoads), "texture_diffuse"},
 		{0, "texture_specular"}
 	};
 
 	std::vector<Texture> brickTextures =
 	{
-		{loadTextureSRGB("textures/bricks.jpg"), "texture_diffuse"},
+		{loadRegisteredTexture("textures/bricks.jpg", true, textureLoads), "texture_diffuse"},
 		{0, "texture_specular"},
-		{loadTexture("textures/toy_box_normal.png"), "texture_normal"},
-		{loadTexture("textures/toy_box_displacement.png"), "texture_displacement"}
+		{loadRegisteredTexture("textures/toy_box_normal.png", false, textureLoads), "texture_normal"},
+		{loadRegisteredTexture("textures/toy_box_displacement.png", false, textureLoads), "texture_displacement"}
 	};
 
 	std::vector<Texture> crateTextures =
 	{
-		{loadTextureSRGB("textures/wood2_diffuse.jpg"), "texture_diffuse"},
-		{loadTexture("textures/wood2_specular.jpg"), "texture_specular"},
-		{loadTexture("textures/wood2_normal.jpg"), "texture_normal"},
-		{loadTexture("textures/wood2_displacement_inverted.png"), "texture_displacement"}
+		{loadMaterialTexture("textures/wood2_diffuse.jpg", true, textureLoads), "texture_diffuse"},
+		{loadMaterialTexture("textures/wood2_specular.jpg", false, textureLoads), "texture_specular"},
+		{loadMaterialTexture("textures/wood2_normal.jpg", false, textureLoads), "texture_normal"},
+		{loadMaterialTexture("textures/wood2_displacement_inverted.png", false, textureLoads), "texture_displacement"}
 	};
 
 	std::vector<Texture> metalTextures =
 	{
-		{loadTextureSRGB("textures/metal_diffuse.jpg"), "texture_diffuse"},
-		{loadTexture("textures/metal_specular.jpg"), "texture_specular"},
-		{loadTexture("textures/metal_normal.jpg"), "texture_normal"},
-		{loadTexture("textures/metal_displacement_inverted.png"), "texture_displacement"}
+		{loadMaterialTexture("textures/metal_diffuse.jpg", true, textureLoads), "texture_diffuse"},
+		{loadMaterialTexture("textures/metal_specular.jpg", false, textureLoads), "texture_specular"},
+		{loadMaterialTexture("textures/metal_normal.jpg", false, textureLoads), "texture_normal"},
+		{loadMaterialTexture("textures/metal_displacement_inverted.png", false, textureLoads), "texture_displacement"}
 	};
 
 	// Create basic meshes
-	meshMap["cube"] = BasicMesh(BasicMeshes::Cube::Vertices, BasicMeshes::Cube::Indices);
-	meshMap["plant"] = BasicMesh(BasicMeshes::Quad::Vertices, BasicMeshes::Quad::Indices, plantTextures);
-	meshMap["glass pane"] = BasicMesh(BasicMeshes::Quad::Vertices, BasicMeshes::Quad::Indices, glassPaneTextures);
-	meshMap["window"] = BasicMesh(BasicMeshes::Quad::Vertices, BasicMeshes::Quad::Indices, windowTextures);
-	meshMap["floor"] = BasicMesh(BasicMeshes::Quad::Vertices, BasicMeshes::Quad::Indices, floorTextures);
-	meshMap["box"] = BasicMesh(BasicMeshes::Cube::Vertices, BasicMeshes::Cube::Indices, crateTextures);
-	meshMap["inverted cube"] = BasicMesh(BasicMeshes::CubeInvertedNormals::Vertices, BasicMeshes::CubeInvertedNormals::Indices, wallTextures);
-	meshMap["parallax cube"] = BasicMesh(BasicMeshes::Cube::Vertices, BasicMeshes::Cube::Indices, metalTextures);
+	meshes.cube = meshRegistry.Add("cube", BasicMesh(BasicMeshes::Cube::Vertices, BasicMeshes::Cube::Indices));
+	meshes.glassPane = meshRegistry.Add("glass pane", BasicMesh(BasicMeshes::Quad::Vertices, BasicMeshes::Quad::Indices, glassPaneTextures));
+	meshes.window = meshRegistry.Add("window", BasicMesh(BasicMeshes::Quad::Vertices, BasicMeshes::Quad::Indices, windowTextures));
+	meshes.floor = meshRegistry.Add("floor", BasicMesh(BasicMeshes::Quad::Vertices, BasicMeshes::Quad::Indices, floorTextures));
+	meshes.box = meshRegistry.Add("box", BasicMesh(BasicMeshes::Cube::Vertices, BasicMeshes::Cube::Indices, crateTextures));
+	meshes.invertedCube = meshRegistry.Add("inverted cube", BasicMesh(BasicMeshes::CubeInvertedNormals::Vertices, BasicMeshes::CubeInvertedNormals::Indices, wallTextures));
+	meshes.parallaxCube = meshRegistry.Add("parallax cube", BasicMesh(BasicMeshes::Cube::Vertices, BasicMeshes::Cube::Indices, metalTextures));
 
 	// Load models
-	modelMap["nanosuit"] = Model("models/nanosuit/nanosuit.obj");
+	models.nanosuit = modelRegistry.Add("nanosuit", Model("models/nanosuit/nanosuit.obj"));
+
+	// Scatter the plants over the floor, densest along the walls
+	unsigned int plantTexture = loadRegisteredTexture("textures/tree.png", true, textureLoads);
+	foliage = Foliage("textures/foliage_density.png", plantTexture, glm::vec2(-4.8f, -7.8f), glm::vec2(4.8f, 1.8f), foliageCount, 0.15f, 0.45f, 42);
+
+	jobSystem.Wait(textureLoads);
+
+	// Place the objects in the scene graph
+	buildScene();
+	if (!stressScene.name.empty())
+		buildStressScene(stressScene, plantTexture);
 
 	// Uniform buffer objects
-	// 1. "Matrices" uniform block
-	// Set the uniform block of the vertex shaders equal to binding point 0
-	bindUniformBlockToPoint(shaderMap["object"], "Matrices", 0);
-	bindUniformBlockToPoint(shaderMap["light cube"], "Matrices", 0);
-	bindUniformBlockToPoint(shaderMap["window"], "Matrices", 0);
-	bindUniformBlockToPoint(shaderMap["transparency"], "Matrices", 0);
-	// Create uniform buffer object and bind it to binding point 0
-	unsigned int uboMatrices;
-	glGenBuffers(1, &uboMatrices);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-	uboMap["matrices"] = uboMatrices;
-	glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMap["matrices"], 0, 2 * sizeof(glm::mat4));
-	// Put the projection matrix into the uniform buffer
-	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1024.0f / 720.0f, 0.1f, 100.0f);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMap["matrices"]);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-	// Depth cubemap setup
-	unsigned int depthMapFBO;
-	glGenFramebuffers(1, &depthMapFBO);
-	unsigned int depthCubemap;
-	glGenTextures(1, &depthCubemap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-	for (int i = 0; i < 6; ++i)
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	framebufferMap["depth"] = depthMapFBO;
-	textureMap["depth"] = depthCubemap;
+	// 1. "Matrices" uniform block, binding point 0
+	bindUniformBlockToPoint(shaderRegistry[shaders.object], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.lightCube], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.window], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.transparency], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.gbuffer], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.depthPrepass], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.foliage], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.overdraw], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.foliageOverdraw], "Matrices", 0);
+	bindUniformBlockToPoint(shaderRegistry[shaders.textureFeedback], "Matrices", 0);
+	// 2. "Transform" uniform block, binding point 1
+	bindUniformBlockToPoint(shaderRegistry[shaders.object], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.lightCube], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.window], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.transparency], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.gbuffer], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.depthPrepass], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.depth], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.cascadeDepth], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.overdraw], "Transform", 1);
+	bindUniformBlockToPoint(shaderRegistry[shaders.textureFeedback], "Transform", 1);
+	// Both are written into the stream buffer each frame, at offsets the driver can bind
+	int alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	uniformBufferAlignment = std::max(alignment, 16);
+
+	// G-buffer for the deferred renderer: gamma encoded albedo, octahedral encoded normals, the specular colour,
+	// and the depth buffer to reconstruct positions from
+	framebuffers.gbuffer = framebufferRegistry.Add("gbuffer", createFramebuffer("gbuffer", screenWidth, screenHeight, { { GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE }, { GL_RG16F, GL_RG, GL_FLOAT }, { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE } }));
+
+	// The scene is drawn multisampled offscreen. The transparent surfaces accumulate into their own targets,
+	// depth tested against the opaque scene, and are composited over it while resolving to the window.
+	framebuffers.scene = framebufferRegistry.Add("scene", createFramebuffer("scene", screenWidth, screenHeight, { { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE } }, 4));
+	framebuffers.transparency = framebufferRegistry.Add("transparency", createFramebuffer("transparency", screenWidth, screenHeight, { { GL_RGBA16F, GL_RGBA, GL_FLOAT }, { GL_R16F, GL_RED, GL_FLOAT } }, 4, framebufferRegistry[framebuffers.scene].depthTexture));
+	// The overdraw view's fragment count per pixel, added up by blending
+	framebuffers.overdraw = framebufferRegistry.Add("overdraw", createFramebuffer("overdraw", screenWidth, screenHeight, { { GL_R16F, GL_RED, GL_FLOAT } }));
+	if (countFragments)
+		gpuProfiler.SetFragmentCounting(screenWidth * screenHeight);
+
+	// Point light clusters, assigned by the job system
+	lightClusters = LightClusters(jobSystem);
+
+	// Shadow atlas shared by the point lights: fixed shadow memory and at most 8 lights re-rendered per frame
+	std::vector<ShadowTier> shadowTiers =
+	{
+		{1024, 2, 1},
+		{512, 6, 2},
+		{256, 24, 4}
+	};
+	shadowAtlas = ShadowAtlas(shadowTiers, 8);
+	std::cout << "Shadow atlas: " << shadowAtlas.GetMemoryUsage() / (1024 * 1024) << " MB of point light shadow maps" << std::endl;
+
+	// Cascaded shadow map for the directional light: four 2048x2048 cascades covering the first 50 units of view depth
+	cascadedShadowMap = CascadedShadowMap(2048, 4, 50.0f, 0.75f, 20.0f);
+
+	// The per-frame uniforms: room for one transform per entity in the camera pass, the depth pre-pass and each cascade,
+	// the point light shadows only drawing the few entities near each light. A frame that draws more (many shadowed
+	// lights over a big stress scene) skips the draws that don't fit, and the buffer grows to what that frame needed.
+	size_t uniformDraws = (size_t)entities.GetNumEntities() * (3 + cascadedShadowMap.GetNumCascades()) + stressGlassPanes.size() + pointLights.size() + 1024;
+	size_t uniformFrameSize = std::min(std::max(uniformDraws * uniformBufferAlignment, (size_t)1024 * 1024), (size_t)256 * 1024 * 1024);
+	if (uniformBufferKb > 0)
+		uniformFrameSize = ((size_t)uniformBufferKb * 1024 + uniformBufferAlignment - 1) / uniformBufferAlignment * uniformBufferAlignment;
+	frameUniforms = StreamBuffer(GL_UNIFORM_BUFFER, (unsigned int)uniformFrameSize, true);
+	if (!frameUniforms.IsPersistent())
+		std::cout << "ARB_buffer_storage unavailable: per-frame uniforms fall back to buffer orphaning" << std::endl;
+
+	// The benchmark's camera path: a loop round the room, looking across it at the objects
+	if (benchmark)
+	{
+		std::vector<CameraKey> keys =
+		{
+			{ glm::vec3(0.0f, 1.5f, 1.5f), glm::vec3(0.0f, 1.0f, -3.0f) },
+			{ glm::vec3(3.5f, 2.0f, 0.0f), glm::vec3(-0.5f, 1.0f, -3.0f) },
+			{ glm::vec3(3.5f, 1.2f, -5.0f), glm::vec3(-1.0f, 1.0f, -1.0f) },
+			{ glm::vec3(0.0f, 3.0f, -5.5f), glm::vec3(0.0f, 0.5f, -1.0f) },
+			{ glm::vec3(-3.5f, 2.5f, -5.0f), glm::vec3(1.0f, 1.0f, -0.5f) },
+			{ glm::vec3(-3.5f, 1.0f, 0.5f), glm::vec3(2.0f, 1.0f, -3.0f) }
+		};
+		benchmarkPath = CameraPath(keys, 20.0f);
+		benchmarkFrameTimes.reserve(benchmarkFrames);
+		benchmarkRenderStats.reserve(benchmarkFrames);
+	}
+
+	// The regression test's poses, each at its own point in the animation
+	if (regression)
+	{
+		std::vector<RegressionPose> poses =
+		{
+			{ "entrance", { glm::vec3(0.0f, 1.5f, 1.5f), glm::vec3(0.0f, 1.0f, -3.0f) }, 0.0f },
+			{ "boxes", { glm::vec3(3.0f, 1.0f, -1.0f), glm::vec3(0.0f, 0.5f, -4.0f) }, 1.0f },
+			{ "nanosuit", { glm::vec3(-1.0f, 2.0f, -1.0f), glm::vec3(0.0f, 1.0f, -4.0f) }, 2.5f },
+			{ "windows", { glm::vec3(0.0f, 1.5f, -3.0f), glm::vec3(0.0f, 1.5f, 2.0f) }, 4.0f },
+			{ "overhead", { glm::vec3(-4.0f, 3.5f, 1.5f), glm::vec3(1.0f, 0.0f, -4.0f) }, 6.0f }
+		};
+		regressionTest = RegressionTest(regressionOptions, poses);
+	}
+
+	if (reportGpuMemory)
+		dumpGpuMemory(std::cout, 10);
 
 	// render loop
+	beginGlInterceptorFrames();
 	while (!glfwWindowShouldClose(window))
 	{
+		frameArena.Reset();
+		markCpuFrame();
+		CpuScope frameScope("Frame");
+		long long frameStartTime = profilerTime();
+		AllocationCounts frameStart = getAllocationCounts();
+		resetRenderStats();
 		processInput(window);
 		update();
-		render(window);
+		render();
+		if (regression)
+		{
+			regressionTest.EndFrame((profilerTime() - frameStartTime) / 1.0e6, gpuProfiler.GetFrameMilliseconds(), screenWidth, screenHeight);
+			if (regressionTest.IsFinished())
+			{
+				exitCode = regressionTest.Report() ? 0 : 1;
+				glfwSetWindowShouldClose(window, true);
+			}
+		}
+		{
+			CpuScope swapScope("glfwSwapBuffers");
+			glfwSwapBuffers(window);
+		}
+		endGlInterceptorFrame();
+		if (checkAllocations)
+			checkFrameAllocations(window, frameStart);
+		if (benchmark)
+			recordBenchmarkFrame(window, frameStartTime);
 	}
 
-	// Clean up resources and exit
+	// Clean up resources and exit. Everything holding GL objects is emptied while the context is current: the globals
+	// themselves are only destroyed after main returns, so anything left would be reported by dumpGpuLeaks.
+	textureStreamer.Clear();
+	modelRegistry.Clear();
+	meshRegistry.Clear();
+	shaderRegistry.Clear();
+	textureRegistry.Clear();
+	framebufferRegistry.Clear();
+	foliage = Foliage();
+	stressFoliage = Foliage();
+	shadowAtlas = ShadowAtlas();
+	cascadedShadowMap = CascadedShadowMap();
+	lightClusters = LightClusters();
+	frameUniforms = StreamBuffer();
+	gpuProfiler.Clear();
+	releaseFullscreenTriangle();
+	if (reportGpuMemory)
+		dumpGpuLeaks(std::cout);
 	glfwTerminate();
-	return 0;
+	return exitCode;
 }
 
 void processInput(GLFWwindow* window)
 {
-	glfwPollEvents();
+	CpuScope scope("processInput");
+	{
+		CpuScope pollScope("glfwPollEvents");
+		glfwPollEvents();
+	}
 
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
+	// nothing else may change what a benchmark or regression test draws
+	if (benchmark || regression)
+		return;
+
+	// F1 switches between the forward and deferred renderers
+	static bool rendererKeyDown = false;
+	bool keyDown = glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS;
+	if (keyDown && !rendererKeyDown)
+		deferredShading = !deferredShading;
+	rendererKeyDown = keyDown;
+
+	// F2 switches the depth pre-pass on and off
+	static bool prepassKeyDown = false;
+	keyDown = glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS;
+	if (keyDown && !prepassKeyDown)
+		depthPrepass = !depthPrepass;
+	prepassKeyDown = keyDown;
+
+	// F3 prints the GPU time of each pass
+	static bool profileKeyDown = false;
+	keyDown = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+	if (keyDown && !profileKeyDown)
+		gpuProfiler.Dump(std::cout);
+	profileKeyDown = keyDown;
+
+	// F5 prints the GL call counts since the last time, with --gl-intercept
+	static bool glCallsKeyDown = false;
+	keyDown = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+	if (keyDown && !glCallsKeyDown)
+		dumpGlInterceptor(std::cout, 20);
+	glCallsKeyDown = keyDown;
+
+	// F6 cycles through the debug views
+	static bool debugViewKeyDown = false;
+	keyDown = glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS;
+	if (keyDown && !debugViewKeyDown)
+	{
+		const char* names[] = { "none", "overdraw", "parallax cost" };
+		debugView = (DebugView)(((int)debugView + 1) % 3);
+		std::cout << "Debug view: " << names[(int)debugView] << std::endl;
+	}
+	debugViewKeyDown = keyDown;
+
+	// F7 switches the fragment counts in the GPU times on and off
+	static bool fragmentsKeyDown = false;
+	keyDown = glfwGetKey(window, GLFW_KEY_F7) == GLFW_PRESS;
+	if (keyDown && !fragmentsKeyDown)
+		gpuProfiler.SetFragmentCounting(gpuProfiler.IsCountingFragments() ? 0 : screenWidth * screenHeight);
+	fragmentsKeyDown = keyDown;
+
+	// F8 prints the GPU memory held by each kind of GL object, and the largest objects
+	static bool gpuMemoryKeyDown = false;
+	keyDown = glfwGetKey(window, GLFW_KEY_F8) == GLFW_PRESS;
+	if (keyDown && !gpuMemoryKeyDown)
+		dumpGpuMemory(std::cout, 10);
+	gpuMemoryKeyDown = keyDown;
+
+	// F9 prints the mips each streamed texture has resident and needs
+	static bool streamingKeyDown = false;
+	keyDown = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+	if (keyDown && !streamingKeyDown && textureStreamer.IsStreaming())
+		textureStreamer.Dump(std::cout);
+	streamingKeyDown = keyDown;
+
+	// F4 writes a Chrome trace of the last 120 frames, CPU and GPU, to trace.json
+	static bool traceKeyDown = false;
+	keyDown = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+	if (keyDown && !traceKeyDown && writeChromeTrace("trace.json", 120, &gpuProfiler))
+		std::cout << "Wrote trace.json" << std::endl;
+	traceKeyDown = keyDown;
+
 	camera.ProcessInput(window);
 }
 
 void update()
 {
+	CpuScope scope("update");
+	// GL work handed over by jobs since the last frame
+	jobSystem.ExecuteMainThreadJobs();
+	// read the texture feedback that has come back, and stream mips in or out to suit it
+	if (textureStreamer.IsStreaming())
+		textureStreamer.Update();
+
 	float currentFrame = glfwGetTime();
+	if (benchmark)
+		currentFrame = benchmarkFrame * BENCHMARK_TIMESTEP;
+	else if (regression)
+		currentFrame = regressionTest.GetPose().time;
 	deltaTime = currentFrame - lastFrame;
+	if (reportFrameTimes)
+	{
+		frameTimeSum += deltaTime;
+		frameCount++;
+		if (currentFrame - lastFrameTimeReport >= 2.0f)
+		{
+			std::cout << screenWidth << "x" << screenHeight << (deferredShading ? " deferred" : " forward") << (depthPrepass ? " with depth pre-pass" : "")
+				<< ", point lights: " << pointLights.size() << ", average frame time: " << 1000.0f * frameTimeSum / frameCount << " ms" << std::endl;
+			static std::vector<WorkerStats> workerStats;
+			jobSystem.GetStats(workerStats);
+			std::cout << "worker utilisation:";
+			for (const WorkerStats& stats : workerStats)
+				std::cout << " " << (int)(100.0f * stats.utilisation) << "% (" << stats.jobs << " jobs, " << stats.steals << " stolen)";
+			std::cout << std::endl;
+			gpuProfiler.Dump(std::cout);
+			dumpGlInterceptor(std::cout, 20);
+			jobSystem.ResetStats();
+			frameTimeSum = 0.0f;
+			frameCount = 0;
+			lastFrameTimeReport = currentFrame;
+		}
+	}
 	if (deltaTime > 0.05f)
 		deltaTime = 0.05f;
 	lastFrame = currentFrame;
 
-	camera.Update(deltaTime);
+	if (benchmark)
+	{
+		CameraKey key = benchmarkPath.Evaluate(currentFrame);
+		camera.LookAt(key.position, key.target);
+	}
+	else if (regression)
+		camera.LookAt(regressionTest.GetPose().camera.position, regressionTest.GetPose().camera.target);
+	else
+		camera.Update(deltaTime);
+
+	pointLights[0].position = glm::vec3(2.0f * cosf(currentFrame), 2.0f, -2.0f);
+	for (int i = 0; i < stressLightOrbits.size(); i++)
+	{
+		const StressLightOrbit& orbit = stressLightOrbits[i];
+		float angle = orbit.phase + orbit.speed * currentFrame;
+		pointLights[orbit.light].position = orbit.centre + glm::vec3(orbit.radius * cosf(angle), 0.3f * sinf(2.0f * angle), orbit.radius * sinf(angle));
+	}
+
+	// only the rotating boxes and the stress scene's spinners move, so theirs are the only world matrices rebuilt
+	CpuScope sceneScope("Scene graph update");
+	glm::quat boxRotation = glm::angleAxis(glm::radians(50.0f * currentFrame), glm::vec3(0.0f, 1.0f, 0.0f));
+	for (unsigned int node : rotatingBoxes)
+		sceneGraph.SetRotation(node, boxRotation);
+	for (const StressSpinner& spinner : stressSpinners)
+		sceneGraph.SetRotation(spinner.node, glm::angleAxis(spinner.phase + spinner.speed * currentFrame, glm::vec3(0.0f, 1.0f, 0.0f)));
+	sceneGraph.Update(jobSystem);
+	entities.UpdateBounds(sceneGraph, jobSystem);
 }
 
-void render(GLFWwindow* window)
+void render()
 {
-	glm::vec3 lightCubePos(2.0f * cosf(glfwGetTime()), 2.0f, -2.0f);
-	glm::mat4 model(1.0f);
+	CpuScope scope("render");
+	frameUniforms.BeginFrame();
+	gpuProfiler.BeginFrame();
+	// the camera matrices are the frame's first write, so they always fit however many transforms follow
+	glm::mat4 view = camera.GetViewMatrix();
+	glm::mat4 matrices[2] = { camera.GetProjectionMatrix(), view };
+	unsigned int matricesOffset = frameUniforms.Write(matrices, sizeof(matrices), uniformBufferAlignment);
 
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-	// First render pass: render to depth map from light's perspective
-	float nearPlane = 1.0f, farPlane = 25.0f, aspect = 1.0f;
-	glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), aspect, nearPlane, farPlane);
-	std::vector<glm::mat4> shadowTransforms;
-	shadowTransforms.push_back(shadowProj * glm::lookAt(lightCubePos, lightCubePos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-	shadowTransforms.push_back(shadowProj * glm::lookAt(lightCubePos, lightCubePos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-	shadowTransforms.push_back(shadowProj * glm::lookAt(lightCubePos, lightCubePos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-	shadowTransforms.push_back(shadowProj * glm::lookAt(lightCubePos, lightCubePos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
-	shadowTransforms.push_back(shadowProj * glm::lookAt(lightCubePos, lightCubePos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-	shadowTransforms.push_back(shadowProj * glm::lookAt(lightCubePos, lightCubePos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-	glViewport(0, 0, 1024, 1024);
-	glBindFramebuffer(GL_FRAMEBUFFER, framebufferMap["depth"]);
-	glClear(GL_DEPTH_BUFFER_BIT);
-	shaderMap["depth"].Use();
-	for (int i = 0; i < 6; ++i)
-		shaderMap["depth"].SetMat4f("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-	shaderMap["depth"].SetFloat("farPlane", farPlane);
-	shaderMap["depth"].SetVec3f("lightPos", lightCubePos);
-	// Rotating boxes
-	for (int i = -1; i < 2; i++)
+	// First render pass: re-render the shadow maps of the lights picked by the shadow atlas this frame
+	gpuProfiler.BeginScope("Point light shadows");
+	shadowAtlas.Allocate(pointLights, camera, frameArena);
+	shaderRegistry[shaders.depth].Use();
+	for (unsigned int lightIndex : shadowAtlas.GetUpdateList())
 	{
-		glm::vec3 pos(i * 2.5f, 1.0f, -7.0f);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, pos);
-		float angle = 50.0f * glfwGetTime();
-		model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-		shaderMap["depth"].SetMat4f("model", model);
+		GpuScope lightScope(gpuProfiler, "Light");
+		shadowAtlas.BeginUpdate(lightIndex, pointLights[lightIndex], shaderRegistry[shaders.depth]);
+		const glm::vec3& lightPos = pointLights[lightIndex].position;
+		float radius = shadowAtlas.GetFarPlane(lightIndex);
+		drawShadowCasters(shaderRegistry[shaders.depth], [&lightPos, radius](const AABB& bounds) { return sphereIntersectsAABB(lightPos, radius, bounds); });
+	}
+	gpuProfiler.EndScope();
 
-		meshMap["box"].Draw(shaderMap["depth"]);
+	// Directional light shadows: one pass per cascade, drawing only the casters that reach that cascade
+	gpuProfiler.BeginScope("Cascaded shadows");
+	cascadedShadowMap.Update(camera, dirLight.direction);
+	shaderRegistry[shaders.cascadeDepth].Use();
+	for (int i = 0; i < cascadedShadowMap.GetNumCascades(); i++)
+	{
+		GpuScope cascadeScope(gpuProfiler, "Cascade");
+		cascadedShadowMap.BeginCascade(i, shaderRegistry[shaders.cascadeDepth]);
+		const Frustum& frustum = cascadedShadowMap.GetCascadeFrustum(i);
+		drawShadowCasters(shaderRegistry[shaders.cascadeDepth], [&frustum](const AABB& bounds) { return frustum.IntersectsAABB(bounds); });
+	}
+	gpuProfiler.EndScope();
+
+	// Assign the lights to clusters and upload them now that their shadow slots are known
+	{
+		CpuScope clusterScope("Light clusters");
+		lightClusters.Build(pointLights, camera);
+		PointLightData* lightData = frameArena.Allocate<PointLightData>(pointLights.size());
+		for (int i = 0; i < pointLights.size(); i++)
+			lightData[i] = packPointLight(pointLights[i], shadowAtlas.GetFarPlane(i), shadowAtlas.GetTier(i), shadowAtlas.GetLayer(i));
+		lightClusters.Upload(lightData, pointLights.size());
+		lightClusters.BindTextures(8);
 	}
-	// parallax cube
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(2.0f, 0.5f, -2.0f));
-	shaderMap["depth"].SetMat4f("model", model);
-	meshMap["parallax cube"].Draw(shaderMap["depth"]);
-	// Nanosuit model
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(0.0f, 0.0f, -5.5f));
-	model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-	shaderMap["depth"].SetMat4f("model", model);
-	modelMap["nanosuit"].Draw(shaderMap["depth"]);
-	// Plants
-	// first
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(4.0f, 0.9f, -7.0f));
-	model = glm::rotate(model, billboard(camera.GetPosition(), glm::vec3(4.0f, 0.9f, -7.0f)), glm::vec3(0.0f, 1.0f, 0.0f));
-	model = glm::scale(model, glm::vec3(0.3f, 2.0f, 1.0f));
-	shaderMap["depth"].SetMat4f("model", model);
-	meshMap["plant"].Draw(shaderMap["depth"]);
-	// second
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-4.0f, 0.9f, -7.0f));
-	model = glm::rotate(model, billboard(camera.GetPosition(), glm::vec3(-4.0f, 0.9f, -7.0f)), glm::vec3(0.0f, 1.0f, 0.0f));
-	model = glm::scale(model, glm::vec3(0.3f, 2.0f, 1.0f));
-	shaderMap["depth"].SetMat4f("model", model);
-	meshMap["plant"].Draw(shaderMap["depth"]);
 
 
 	// Second render pass: render the scene as normal
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, 1024, 720);
+	gpuProfiler.BeginScope("Opaque");
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferRegistry[framebuffers.scene].id);
+	glViewport(0, 0, screenWidth, screenHeight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glm::mat4 view = camera.GetViewMatrix();
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMap["matrices"]);
-	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-	// Light source
-	shaderMap["light cube"].Use();
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, lightCubePos);
-	model = glm::scale(model, glm::vec3(0.1f));
-	shaderMap["light cube"].SetMat4f("model", model);
-	meshMap["cube"].Draw(shaderMap["light cube"]);
-
-	// Rotating boxes
-	shaderMap["object"].Use();
-	shaderMap["object"].SetFloat("heightScale", heightScale);
-	shaderMap["object"].SetBool("parallaxMapping", true);
-	shaderMap["object"].SetBool("normalMapping", true);
-	shaderMap["object"].SetFloat("farPlane", farPlane);
-	shaderMap["object"].SetVec2f("textureScale", 1.0f, 1.0f);
-	shaderMap["object"].SetVec3f("viewPos", camera.GetPosition());
-	shaderMap["object"].SetVec3f("lightPos", lightCubePos);
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureMap["depth"]);
-	for (int i = -1; i < 2; i++)
+	glBindBufferRange(GL_UNIFORM_BUFFER, 0, frameUniforms.GetBuffer(), matricesOffset, sizeof(glm::mat4) * 2);
+
+	shadowAtlas.BindTextures(4);
+	cascadedShadowMap.BindTexture(7);
+	{
+		CpuScope recordScope("Gather and record opaque draws");
+		entities.GatherVisible(Frustum(camera.GetProjectionMatrix() * view), opaqueDrawList, jobSystem);
+		recordDraws(opaqueCommands, opaqueDrawList, depthPrepass ? DrawOrder::FrontToBack : DrawOrder::Material);
+	}
+	if (deferredShading && debugView != DebugView::ParallaxCost)
+	{
+		// Geometry pass: the parallax and normal mapped materials are sampled once into the G-buffer
+		gpuProfiler.BeginScope("G-buffer");
+		glBindFramebuffer(GL_FRAMEBUFFER, framebufferRegistry[framebuffers.gbuffer].id);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glEnable(GL_FRAMEBUFFER_SRGB);
+		shaderRegistry[shaders.gbuffer].Use();
+		shaderRegistry[shaders.gbuffer].SetFloat("heightScale", heightScale);
+		shaderRegistry[shaders.gbuffer].SetVec3f("viewPos", camera.GetPosition());
+		drawOpaqueObjects(shaderRegistry[shaders.gbuffer]);
+		glDisable(GL_FRAMEBUFFER_SRGB);
+		gpuProfiler.EndScope();
+
+		// Lighting pass: one full-screen pass over the clustered lights, which also copies the G-buffer depth
+		gpuProfiler.BeginScope("Deferred lighting");
+		glBindFramebuffer(GL_FRAMEBUFFER, framebufferRegistry[framebuffers.scene].id);
+		glDepthFunc(GL_ALWAYS);
+		const Framebuffer& gBuffer = framebufferRegistry[framebuffers.gbuffer];
+		shaderRegistry[shaders.deferredLighting].Use();
+		shaderRegistry[shaders.deferredLighting].SetVec3f("viewPos", camera.GetPosition());
+		shaderRegistry[shaders.deferredLighting].SetMat4f("inverseView", glm::inverse(view));
+		shaderRegistry[shaders.deferredLighting].SetMat4f("inverseProjection", glm::inverse(camera.GetProjectionMatrix()));
+		lightClusters.SetUniforms(shaderRegistry[shaders.deferredLighting], screenWidth, screenHeight);
+		cascadedShadowMap.SetUniforms(shaderRegistry[shaders.deferredLighting]);
+		bindTextureMaps(gBuffer.colourTextures[0], gBuffer.colourTextures[1], gBuffer.depthTexture);
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, gBuffer.colourTextures[2]);
+		glActiveTexture(GL_TEXTURE0);
+		drawFullscreenTriangle();
+		glDepthFunc(GL_LESS);
+		gpuProfiler.EndScope();
+	}
+	else
+	{
+		shaderRegistry[shaders.object].Use();
+		shaderRegistry[shaders.object].SetFloat("heightScale", heightScale);
+		shaderRegistry[shaders.object].SetVec3f("viewPos", camera.GetPosition());
+		shaderRegistry[shaders.object].SetBool("parallaxHeatmap", debugView == DebugView::ParallaxCost);
+		lightClusters.SetUniforms(shaderRegistry[shaders.object], screenWidth, screenHeight);
+		cascadedShadowMap.SetUniforms(shaderRegistry[shaders.object]);
+		drawOpaqueObjects(shaderRegistry[shaders.object]);
+	}
+	gpuProfiler.EndScope();
+
+	// Light sources
+	gpuProfiler.BeginScope("Light cubes");
+	shaderRegistry[shaders.lightCube].Use();
+	drawLightCubes(shaderRegistry[shaders.lightCube]);
+	gpuProfiler.EndScope();
+
+	// Windows: every texel is either the opaque frame or refracted sky, so they are drawn with the opaque scene
+	gpuProfiler.BeginScope("Windows");
+	shaderRegistry[shaders.window].Use();
+	shaderRegistry[shaders.window].SetBool("specular", false);
+	shaderRegistry[shaders.window].SetVec3f("viewPos", camera.GetPosition());
+	lightClusters.SetUniforms(shaderRegistry[shaders.window], screenWidth, screenHeight);
+	shaderRegistry[shaders.window].SetInt("skybox", 2);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureRegistry[textures.skybox]);
+	drawWindows(shaderRegistry[shaders.window]);
+	gpuProfiler.EndScope();
+
+	// Foliage: billboarded and thinned out on the GPU, cut out with alpha-to-coverage instead of blending
+	gpuProfiler.BeginScope("Foliage");
+	glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+	shaderRegistry[shaders.foliage].Use();
+	shaderRegistry[shaders.foliage].SetVec3f("viewPos", camera.GetPosition());
+	lightClusters.SetUniforms(shaderRegistry[shaders.foliage], screenWidth, screenHeight);
+	foliage.Draw(shaderRegistry[shaders.foliage]);
+	if (stressFoliage.GetInstanceCount() > 0)
+		stressFoliage.Draw(shaderRegistry[shaders.foliage]);
+	glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+	gpuProfiler.EndScope();
+
+	// Transparent surfaces: accumulated in any order, tested against the opaque depth without writing to it
+	gpuProfiler.BeginScope("Transparency");
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferRegistry[framebuffers.transparency].id);
+	const float clearAccum[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const float clearAlpha[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, clearAccum);
+	glClearBufferfv(GL_COLOR, 1, clearAlpha);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+
+	// Glass pane
+	shaderRegistry[shaders.transparency].Use();
+	shaderRegistry[shaders.transparency].SetVec2f("textureScale", 1.0f, 1.0f);
+	shaderRegistry[shaders.transparency].SetVec3f("viewPos", camera.GetPosition());
+	lightClusters.SetUniforms(shaderRegistry[shaders.transparency], screenWidth, screenHeight);
+	shaderRegistry[shaders.transparency].SetBool("specular", true);
+	shaderRegistry[shaders.transparency].SetVec3f("material.specular", 0.5f, 0.5f, 0.5f);
+	shaderRegistry[shaders.transparency].SetFloat("material.shininess", 32.0f);
+	Frustum viewFrustum(camera.GetProjectionMatrix() * view);
+	drawGlassPanes(shaderRegistry[shaders.transparency], viewFrustum);
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	gpuProfiler.EndScope();
+
+	// Composite the transparent surfaces over the opaque scene into the window, or show the overdraw instead. The
+	// overdraw view still draws the frame as normal first, so that the pass times and fragment counts are the real ones.
+	if (debugView == DebugView::Overdraw)
+		drawOverdraw(viewFrustum);
+	else
 	{
-		glm::vec3 pos(i * 2.5f, 1.0f, -7.0f);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, pos);
-		float angle = 50.0f * glfwGetTime();
-		model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-		shaderMap["object"].SetMat4f("model", model);
+		gpuProfiler.BeginScope("Composite");
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDisable(GL_DEPTH_TEST);
+		shaderRegistry[shaders.oitComposite].Use();
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, framebufferRegistry[framebuffers.scene].colourTextures[0]);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, framebufferRegistry[framebuffers.transparency].colourTextures[0]);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, framebufferRegistry[framebuffers.transparency].colourTextures[1]);
+		glActiveTexture(GL_TEXTURE0);
+		drawFullscreenTriangle();
+		glEnable(GL_DEPTH_TEST);
+		gpuProfiler.EndScope();
+	}
 
-		meshMap["box"].Draw(shaderMap["object"]);
+	if (textureStreamer.IsStreaming())
+		drawTextureFeedback();
+
+	// fence this frame's streamed data behind the commands that read it
+	frameUniforms.EndFrame();
+	lightClusters.EndFrame();
+	gpuProfiler.EndFrame();
+}
+
+void buildScene()
+{
+	glm::quat noRotation(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
+
+	// Materials: texture tiling, normal mapping, parallax mapping, inside out
+	unsigned int parallaxMaterial = entities.AddMaterial({ glm::vec2(1.0f), true, true, false });
+	unsigned int modelMaterial = entities.AddMaterial({ glm::vec2(1.0f), false, false, false });
+	unsigned int floorMaterial = entities.AddMaterial({ glm::vec2(10.0f), true, false, false });
+	unsigned int wallMaterial = entities.AddMaterial({ glm::vec2(5.0f), true, false, true });
+
+	// Rotating boxes, spun about their own centres in update()
+	unsigned int boxRow = sceneGraph.AddNode(-1, glm::vec3(0.0f, 1.0f, -7.0f));
+	for (int i = -1; i < 2; i++)
+	{
+		unsigned int box = sceneGraph.AddNode(boxRow, glm::vec3(i * 2.5f, 0.0f, 0.0f));
+		rotatingBoxes.push_back(box);
+		entities.CreateEntity(box, meshes.box, ModelHandle(), parallaxMaterial, meshRegistry[meshes.box].GetBounds(), true);
 	}
 	// parallax cube
-	shaderMap["object"].SetBool("normalMapping", true);
-	shaderMap["object"].SetBool("parallaxMapping", true);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(2.0f, 0.5f, -2.0f));
-	shaderMap["object"].SetMat4f("model", model);
-	meshMap["parallax cube"].Draw(shaderMap["object"]);
+	unsigned int parallaxCube = sceneGraph.AddNode(-1, glm::vec3(2.0f, 0.5f, -2.0f));
+	entities.CreateEntity(parallaxCube, meshes.parallaxCube, ModelHandle(), parallaxMaterial, meshRegistry[meshes.parallaxCube].GetBounds(), true);
 	// Nanosuit model
-	shaderMap["object"].SetBool("normalMapping", false);
-	shaderMap["object"].SetBool("parallaxMapping", false);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(0.0f, 0.0f, -5.5f));
-	model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-	shaderMap["object"].SetMat4f("model", model);
-	modelMap["nanosuit"].Draw(shaderMap["object"]);
-	// Floor
-	shaderMap["object"].SetBool("normalMapping", true);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(0.0f, 0.0f, -3.0f));
-	model = glm::scale(model, glm::vec3(10.0f));
-	model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	shaderMap["object"].SetMat4f("model", model);
-	shaderMap["object"].SetVec2f("textureScale", 10.0f, 10.0f);
-	meshMap["floor"].Draw(shaderMap["object"]);
-	// Walls and ceiling
-	glFrontFace(GL_CW);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(0.0f, 0.0f, -3.0f));
-	model = glm::scale(model, glm::vec3(10.0f, 7.0f, 10.0f));
-	shaderMap["object"].SetMat4f("model", model);
-	shaderMap["object"].SetVec2f("textureScale", 5.0f, 5.0f);
-	meshMap["inverted cube"].Draw(shaderMap["object"]);
-	glFrontFace(GL_CCW);
-
-	// Plants
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	shaderMap["transparency"].Use();
-	shaderMap["transparency"].SetBool("specular", false);
-	shaderMap["transparency"].SetVec2f("textureScale", 1.0f, 1.0f);
-	shaderMap["transparency"].SetVec3f("viewPos", camera.GetPosition());
-	shaderMap["transparency"].SetVec3f("pointLight.position", lightCubePos);
-	// first
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(4.0f, 0.9f, -7.0f));
-	model = glm::rotate(model, billboard(camera.GetPosition(), glm::vec3(4.0f, 0.9f, -7.0f)), glm::vec3(0.0f, 1.0f, 0.0f));
-	model = glm::scale(model, glm::vec3(1.0f, 2.0f, 1.0f));
-	shaderMap["transparency"].SetMat4f("model", model);
-	meshMap["plant"].Draw(shaderMap["transparency"]);
-	// second
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-4.0f, 0.9f, -7.0f));
-	model = glm::rotate(model, billboard(camera.GetPosition(), glm::vec3(-4.0f, 0.9f, -7.0f)), glm::vec3(0.0f, 1.0f, 0.0f));
-	model = glm::scale(model, glm::vec3(1.0f, 2.0f, 1.0f));
-	shaderMap["transparency"].SetMat4f("model", model);
-	meshMap["plant"].Draw(shaderMap["transparency"]);
+	unsigned int nanosuit = sceneGraph.AddNode(-1, glm::vec3(0.0f, 0.0f, -5.5f), noRotation, glm::vec3(0.1f));
+	entities.CreateEntity(nanosuit, MeshHandle(), models.nanosuit, modelMaterial, modelRegistry[models.nanosuit].GetBounds(), true);
 
+	// the room: floor, walls and ceiling
+	unsigned int room = sceneGraph.AddNode(-1, glm::vec3(0.0f, 0.0f, -3.0f));
+	unsigned int floor = sceneGraph.AddNode(room, glm::vec3(0.0f), glm::angleAxis(glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(10.0f));
+	entities.CreateEntity(floor, meshes.floor, ModelHandle(), floorMaterial, meshRegistry[meshes.floor].GetBounds(), false);
+	unsigned int walls = sceneGraph.AddNode(room, glm::vec3(0.0f), noRotation, glm::vec3(10.0f, 7.0f, 10.0f));
+	entities.CreateEntity(walls, meshes.invertedCube, ModelHandle(), wallMaterial, meshRegistry[meshes.invertedCube].GetBounds(), false);
+	// windows set into the side walls
+	nodes.leftWindow = sceneGraph.AddNode(room, glm::vec3(-4.95f, 1.5f, 0.0f), glm::angleAxis(glm::radians(90.0f), yAxis), glm::vec3(1.5f, 1.5f, 1.0f));
+	nodes.rightWindow = sceneGraph.AddNode(room, glm::vec3(4.95f, 1.5f, 0.0f), glm::angleAxis(glm::radians(-90.0f), yAxis), glm::vec3(1.5f, 1.5f, 1.0f));
 
 	// Glass pane
-	shaderMap["transparency"].SetBool("specular", true);
-	shaderMap["transparency"].SetVec3f("material.specular", 0.5f, 0.5f, 0.5f);
-	shaderMap["transparency"].SetFloat("material.shininess", 32.0f);
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(0.0f, 1.0f, -6.0f));
-	model = glm::scale(model, glm::vec3(10.0f, 2.0f, 1.0f));
-	shaderMap["transparency"].SetMat4f("model", model);
-	meshMap["glass pane"].Draw(shaderMap["transparency"]);
+	nodes.glassPane = sceneGraph.AddNode(-1, glm::vec3(0.0f, 1.0f, -6.0f), noRotation, glm::vec3(10.0f, 2.0f, 1.0f));
+
+	sceneGraph.Update(jobSystem);
+	entities.UpdateBounds(sceneGraph, jobSystem);
+}
+
+void recordDraws(CommandList& commands, const std::vector<unsigned int>& drawList, DrawOrder order)
+{
+	// the packets are built by jobs; nothing here touches GL
+	glm::vec3 viewPos = camera.GetPosition();
+	glm::vec3 viewDir = camera.GetFront();
+	float farPlane = camera.GetFarPlane();
+	commands.Begin(jobSystem.GetNumWorkers());
+	jobSystem.ParallelFor(drawList.size(), 256, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++)
+		{
+			unsigned int entity = drawList[i];
+			const Material& material = entities.GetMaterial(entity);
+			const AABB& bounds = entities.GetWorldBounds(entity);
+			float depth = glm::dot(0.5f * (bounds.min + bounds.max) - viewPos, viewDir);
+
+			unsigned int state = 0;
+			if (order == DrawOrder::Material)
+				state = entities.GetMaterialIndex(entity);
+			else if (order == DrawOrder::FrontToBack)
+				state = material.insideOut ? 1 : 0; // the inside out room shell behind everything
+			else
+				depth = 0.0f;
+			commands.Record({ makeSortKey(state, depth, farPlane, entity), &sceneGraph.GetWorldMatrix(entities.GetNode(entity)), entity, entities.GetMaterialIndex(entity) });
+		}
+	});
+	commands.Merge();
+}
+
+static void drawGeometry(const Shader& shader, unsigned int entity)
+{
+	if (entities.GetMesh(entity).IsValid())
+		meshRegistry[entities.GetMesh(entity)].Draw(shader);
+	else
+		modelRegistry[entities.GetModel(entity)].Draw(shader);
+}
+
+// material uniforms are only set when the material changes from the previous packet's
+static void drawOpaqueObject(const Shader& shader, const DrawPacket& packet, int& currentMaterial)
+{
+	const Material& material = entities.GetMaterial(packet.entity);
+	if ((int)packet.material != currentMaterial)
+	{
+		shader.SetBool("normalMapping", material.normalMapping);
+		shader.SetBool("parallaxMapping", material.parallaxMapping);
+		shader.SetVec2f("textureScale", material.textureScale);
+		currentMaterial = packet.material;
+	}
+	if (!bindTransform(*packet.transform))
+		return;
+	if (material.insideOut)
+		glFrontFace(GL_CW);
+	drawGeometry(shader, packet.entity);
+	if (material.insideOut)
+		glFrontFace(GL_CCW);
+}
+
+void drawOpaqueObjects(Shader& shader)
+{
+	// recorded in material order, or nearest first with the room shell last when the depth pre-pass is on
+	const std::vector<DrawPacket>& packets = opaqueCommands.GetPackets();
+	int currentMaterial = -1;
+	if (!depthPrepass)
+	{
+		for (const DrawPacket& packet : packets)
+			drawOpaqueObject(shader, packet, currentMaterial);
+		return;
+	}
+
+	// Depth pre-pass: position only, for the surfaces that never discard
+	gpuProfiler.BeginScope("Depth pre-pass");
+	shaderRegistry[shaders.depthPrepass].Use();
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	for (const DrawPacket& packet : packets)
+	{
+		const Material& material = entities.GetMaterial(packet.entity);
+		if (material.parallaxMapping)
+			continue;
+		if (!bindTransform(*packet.transform))
+			continue;
+		if (material.insideOut)
+			glFrontFace(GL_CW);
+		drawGeometry(shaderRegistry[shaders.depthPrepass], packet.entity);
+		if (material.insideOut)
+			glFrontFace(GL_CCW);
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	gpuProfiler.EndScope();
+
+	// parallax mapped surfaces are shaded with the normal depth test: their hidden fragments are rejected by the
+	// pre-pass depth, and the depth they write keeps the pre-passed surfaces they cover from being shaded
+	gpuProfiler.BeginScope("Parallax surfaces");
+	shader.Use();
+	for (const DrawPacket& packet : packets)
+	{
+		if (entities.GetMaterial(packet.entity).parallaxMapping)
+			drawOpaqueObject(shader, packet, currentMaterial);
+	}
+	gpuProfiler.EndScope();
+
+	// everything else is shaded only where its own pre-pass depth survived
+	gpuProfiler.BeginScope("Pre-passed surfaces");
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+	for (const DrawPacket& packet : packets)
+	{
+		if (!entities.GetMaterial(packet.entity).parallaxMapping)
+			drawOpaqueObject(shader, packet, currentMaterial);
+	}
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	gpuProfiler.EndScope();
+}
+
+void drawShadowCasters(const Shader& shader, const std::function<bool(const AABB&)>& reachesShadowMap)
+{
+	CpuScope scope("Shadow casters");
+	entities.GatherShadowCasters(reachesShadowMap, shadowDrawList, jobSystem);
+	recordDraws(shadowCommands, shadowDrawList, DrawOrder::Entity);
+	for (const DrawPacket& packet : shadowCommands.GetPackets())
+	{
+		if (bindTransform(*packet.transform))
+			drawGeometry(shader, packet.entity);
+	}
+}
+
+// false when the frame's uniforms are full, in which case the draw must be skipped
+bool bindTransform(const glm::mat4& model)
+{
+	unsigned int offset = frameUniforms.Write(glm::value_ptr(model), sizeof(glm::mat4), uniformBufferAlignment);
+	if (offset == STREAM_BUFFER_FULL)
+		return false;
+	glBindBufferRange(GL_UNIFORM_BUFFER, 1, frameUniforms.GetBuffer(), offset, sizeof(glm::mat4));
+	return true;
+}
+
+void drawLightCubes(const Shader& shader)
+{
+	for (int i = 0; i < pointLights.size(); i++)
+	{
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, pointLights[i].position);
+		model = glm::scale(model, glm::vec3(0.1f));
+		if (bindTransform(model))
+			meshRegistry[meshes.cube].Draw(shader);
+	}
+}
+
+void drawWindows(const Shader& shader)
+{
+	if (bindTransform(sceneGraph.GetWorldMatrix(nodes.leftWindow)))
+		meshRegistry[meshes.window].Draw(shader);
+	if (bindTransform(sceneGraph.GetWorldMatrix(nodes.rightWindow)))
+		meshRegistry[meshes.window].Draw(shader);
+}
+
+void drawGlassPanes(const Shader& shader, const Frustum& viewFrustum)
+{
+	if (bindTransform(sceneGraph.GetWorldMatrix(nodes.glassPane)))
+		meshRegistry[meshes.glassPane].Draw(shader);
+	// the stress scene's panes, culled to the view; they accumulate in any order like the one above
+	const AABB& paneBounds = meshRegistry[meshes.glassPane].GetBounds();
+	for (unsigned int node : stressGlassPanes)
+	{
+		if (!viewFrustum.IntersectsAABB(transformAABB(paneBounds, sceneGraph.GetWorldMatrix(node))))
+			continue;
+		if (bindTransform(sceneGraph.GetWorldMatrix(node)))
+			meshRegistry[meshes.glassPane].Draw(shader);
+	}
+}
+
+// Draws everything the frame drew again, without the depth test, adding one per fragment into the overdraw
+// framebuffer, and shows the counts in the window as a heat map. Foliage counts whole quads, cut-outs included.
+void drawOverdraw(const Frustum& viewFrustum)
+{
+	GpuScope scope(gpuProfiler, "Overdraw");
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferRegistry[framebuffers.overdraw].id);
+	const float clearCount[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, clearCount);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	Shader& shader = shaderRegistry[shaders.overdraw];
+	shader.Use();
+	for (const DrawPacket& packet : opaqueCommands.GetPackets())
+	{
+		bool insideOut = entities.GetMaterial(packet.entity).insideOut;
+		if (!bindTransform(*packet.transform))
+			continue;
+		if (insideOut)
+			glFrontFace(GL_CW);
+		drawGeometry(shader, packet.entity);
+		if (insideOut)
+			glFrontFace(GL_CCW);
+	}
+	drawLightCubes(shader);
+	drawWindows(shader);
+	drawGlassPanes(shader, viewFrustum);
+
+	shaderRegistry[shaders.foliageOverdraw].Use();
+	shaderRegistry[shaders.foliageOverdraw].SetVec3f("viewPos", camera.GetPosition());
+	foliage.Draw(shaderRegistry[shaders.foliageOverdraw]);
+	if (stressFoliage.GetInstanceCount() > 0)
+		stressFoliage.Draw(shaderRegistry[shaders.foliageOverdraw]);
 	glDisable(GL_BLEND);
 
-	// Windows
-	shaderMap["window"].Use();
-	shaderMap["window"].SetBool("specular", false);
-	shaderMap["window"].SetVec3f("viewPos", camera.GetPosition());
-	shaderMap["window"].SetVec3f("pointLight.position", lightCubePos);
-	shaderMap["window"].SetInt("skybox", 2);
-	// first
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-4.95f, 1.5f, -3.0f));
-	model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.0f));
-	shaderMap["window"].SetMat4f("model", model);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureMap["skybox"]);
-	meshMap["window"].Draw(shaderMap["window"]);
-	// second
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(4.95f, 1.5f, -3.0f));
-	model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.0f));
-	shaderMap["window"].SetMat4f("model", model);
-	meshMap["window"].Draw(shaderMap["window"]);
-
-	glfwSwapBuffers(window);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	shaderRegistry[shaders.overdrawComposite].Use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, framebufferRegistry[framebuffers.overdraw].colourTextures[0]);
+	drawFullscreenTriangle();
+	glEnable(GL_DEPTH_TEST);
+}
+
+// Draws the opaque objects again into the streamer's feedback buffer, each draw tagged with the streamed textures its
+// mesh samples, so that it can tell which mips they need. Models and the other passes use textures loaded whole.
+void drawTextureFeedback()
+{
+	GpuScope scope(gpuProfiler, "Texture feedback");
+	textureStreamer.BeginFeedback();
+	Shader& shader = shaderRegistry[shaders.textureFeedback];
+	shader.Use();
+	int currentMaterial = -1;
+	for (const DrawPacket& packet : opaqueCommands.GetPackets())
+	{
+		const Material& material = entities.GetMaterial(packet.entity);
+		if ((int)packet.material != currentMaterial)
+		{
+			shader.SetVec2f("textureScale", material.textureScale);
+			currentMaterial = packet.material;
+		}
+		MeshHandle mesh = entities.GetMesh(packet.entity);
+		if (!bindTransform(*packet.transform))
+			continue;
+		shader.SetInt("feedbackId", mesh.IsValid() ? textureStreamer.AddFeedbackDraw(meshRegistry[mesh].GetTextures()) : 0);
+		if (material.insideOut)
+			glFrontFace(GL_CW);
+		drawGeometry(shader, packet.entity);
+		if (material.insideOut)
+			glFrontFace(GL_CCW);
+	}
+	textureStreamer.EndFeedback();
+	glViewport(0, 0, screenWidth, screenHeight);
+}
+
+// the texture registry owns the texture, under its path; meshes and foliage only keep the name
+unsigned int loadRegisteredTexture(const std::string& path, bool srgb, JobCounter& counter)
+{
+	return textureRegistry[textureRegistry.Add(path, loadTextureAsync(jobSystem, path, srgb, counter))];
+}
+
+unsigned int loadMaterialTexture(const std::string& path, bool srgb, JobCounter& counter)
+{
+	if (textureStreamer.IsStreaming())
+		return textureStreamer.Load(path, srgb, counter);
+	return loadRegisteredTexture(path, srgb, counter);
+}
+
+// returns how many were added: no more than MAX_POINT_LIGHTS in all
+unsigned int spawnStressLights(unsigned int count, unsigned int seed, const glm::vec3& areaMin, const glm::vec3& areaMax)
+{
+	// seeded so that runs with the same light count are comparable
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	count = std::min(count, MAX_POINT_LIGHTS - (unsigned int)pointLights.size());
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// small, brightly coloured lights scattered through the room, each with a short radius
+		PointLight light;
+		light.position = glm::vec3(0.0f);
+		light.constant = 1.0f;
+		light.linear = 0.7f;
+		light.quadratic = 1.8f;
+		glm::vec3 colour = glm::vec3(unit(rng), unit(rng), unit(rng));
+		colour /= std::max(std::max(colour.x, colour.y), colour.z);
+		light.ambient = 0.02f * colour;
+		light.diffuse = colour;
+		light.specular = colour;
+		light.castsShadows = true;
+		pointLights.push_back(light);
+
+		StressLightOrbit orbit;
+		orbit.light = pointLights.size() - 1;
+		glm::vec3 offset(unit(rng), unit(rng), unit(rng));
+		orbit.centre = areaMin + offset * (areaMax - areaMin);
+		orbit.radius = 0.5f + unit(rng);
+		orbit.speed = 0.2f + 0.8f * unit(rng);
+		orbit.phase = 6.2831853f * unit(rng);
+		stressLightOrbits.push_back(orbit);
+	}
+	return count;
+}
+
+bool parseStressScene(const std::string& text, StressSceneConfig& config)
+{
+	// scenarios by total object count: mostly crates, then plants, with a few nanosuits, panes and lights
+	struct Scenario
+	{
+		const char* name;
+		unsigned int crates, nanosuits, plants, glassPanes, pointLights;
+	};
+	const Scenario scenarios[] =
+	{
+		{ "10", 6, 1, 2, 1, 2 },
+		{ "1k", 600, 50, 300, 50, 10 },
+		{ "10k", 6000, 500, 3000, 500, 100 },
+		{ "100k", 60000, 5000, 30000, 5000, 1000 }
+	};
+	for (const Scenario& scenario : scenarios)
+	{
+		if (text == scenario.name)
+		{
+			config.name = scenario.name;
+			config.crates = scenario.crates;
+			config.nanosuits = scenario.nanosuits;
+			config.plants = scenario.plants;
+			config.glassPanes = scenario.glassPanes;
+			config.pointLights = scenario.pointLights;
+			return true;
+		}
+	}
+
+	// or the counts themselves
+	unsigned int counts[5];
+	std::istringstream stream(text);
+	for (int i = 0; i < 5; i++)
+	{
+		char comma = ',';
+		if (!(stream >> counts[i]) || (i < 4 && (!(stream >> comma) || comma != ',')))
+			return false;
+	}
+	config.name = text;
+	config.crates = counts[0];
+	config.nanosuits = counts[1];
+	config.plants = counts[2];
+	config.glassPanes = counts[3];
+	config.pointLights = counts[4];
+	return true;
+}
+
+void buildStressScene(const StressSceneConfig& config, unsigned int plantTexture)
+{
+	// A square centred on the room, sized for about one object per 4 square metres; the smallest scenes fit in the room
+	unsigned int total = config.crates + config.nanosuits + config.plants + config.glassPanes;
+	float halfSize = std::max(5.0f, sqrtf((float)total));
+	glm::vec2 centre(0.0f, -3.0f);
+	glm::vec2 areaMin = centre - glm::vec2(halfSize);
+	glm::vec2 areaMax = centre + glm::vec2(halfSize);
+
+	std::mt19937 rng(config.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	auto randomPoint = [&]() { float x = unit(rng); float z = unit(rng); return areaMin + glm::vec2(x, z) * (areaMax - areaMin); };
+	auto randomYaw = [&]() { return glm::angleAxis(6.2831853f * unit(rng), glm::vec3(0.0f, 1.0f, 0.0f)); };
+	auto maybeSpin = [&](unsigned int node) {
+		if (unit(rng) < STRESS_SPINNING_FRACTION)
+		{
+			float speed = 0.2f + 1.8f * unit(rng);
+			float phase = 6.2831853f * unit(rng);
+			stressSpinners.push_back({ node, speed, phase });
+		}
+	};
+
+	unsigned int crateMaterial = entities.AddMaterial({ glm::vec2(1.0f), true, true, false });
+	unsigned int nanosuitMaterial = entities.AddMaterial({ glm::vec2(1.0f), false, false, false });
+	for (unsigned int i = 0; i < config.crates; i++)
+	{
+		glm::vec2 position = randomPoint();
+		float size = 0.3f + 0.7f * unit(rng);
+		unsigned int node = sceneGraph.AddNode(-1, glm::vec3(position.x, 0.5f * size, position.y), randomYaw(), glm::vec3(size));
+		entities.CreateEntity(node, meshes.box, ModelHandle(), crateMaterial, meshRegistry[meshes.box].GetBounds(), true);
+		maybeSpin(node);
+	}
+	for (unsigned int i = 0; i < config.nanosuits; i++)
+	{
+		glm::vec2 position = randomPoint();
+		unsigned int node = sceneGraph.AddNode(-1, glm::vec3(position.x, 0.0f, position.y), randomYaw(), glm::vec3(0.1f));
+		entities.CreateEntity(node, MeshHandle(), models.nanosuit, nanosuitMaterial, modelRegistry[models.nanosuit].GetBounds(), true);
+		maybeSpin(node);
+	}
+	for (unsigned int i = 0; i < config.glassPanes; i++)
+	{
+		glm::vec2 position = randomPoint();
+		unsigned int node = sceneGraph.AddNode(-1, glm::vec3(position.x, 1.0f, position.y), randomYaw(), glm::vec3(2.0f, 2.0f, 1.0f));
+		stressGlassPanes.push_back(node);
+		maybeSpin(node);
+	}
+	if (config.plants > 0)
+		stressFoliage = Foliage("", plantTexture, areaMin, areaMax, config.plants, 0.15f, 0.45f, config.seed + 1);
+	unsigned int pointLightCount = spawnStressLights(config.pointLights, config.seed + 2, glm::vec3(areaMin.x, 0.3f, areaMin.y), glm::vec3(areaMax.x, 2.8f, areaMax.y));
+
+	sceneGraph.Update(jobSystem);
+	entities.UpdateBounds(sceneGraph, jobSystem);
+	std::cout << "Stress scene " << config.name << ": " << config.crates << " crates, " << config.nanosuits << " nanosuits, " << config.plants << " plants, "
+		<< config.glassPanes << " glass panes, " << pointLightCount << " point lights over " << 2.0f * halfSize << " m square" << std::endl;
+	if (pointLightCount < config.pointLights)
+		std::cout << "Error::Main::Only " << pointLightCount << " of the scene's " << config.pointLights << " point lights fit under MAX_POINT_LIGHTS" << std::endl;
+}
+
+void runEntityBenchmark()
+{
+	// Times the per-frame CPU work on the entities (transform and bounds updates, then gathering the camera
+	// and a shadow pass's draw lists) with every transform changing each frame, at increasing entity counts.
+	// The cost per entity should stay flat as the count grows.
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	Frustum cameraFrustum(camera.GetProjectionMatrix() * camera.GetViewMatrix());
+	glm::vec3 lightPos(0.0f, 2.0f, -20.0f);
+	const int frames = 20;
+
+	std::cout << "entities, ms per frame, ns per entity" << std::endl;
+	for (unsigned int count = 1000; count <= 100000; count *= 10)
+	{
+		SceneGraph graph;
+		EntityStore store;
+		unsigned int material = store.AddMaterial({ glm::vec2(1.0f), false, false, false });
+		AABB unitCube = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+		for (unsigned int i = 0; i < count; i++)
+		{
+			glm::vec3 position(-50.0f + 100.0f * unit(rng), 10.0f * unit(rng), -100.0f + 100.0f * unit(rng));
+			unsigned int node = graph.AddNode(-1, position);
+			store.CreateEntity(node, MeshHandle(), ModelHandle(), material, unitCube, i % 2 == 0);
+		}
+
+		std::vector<unsigned int> visible;
+		std::vector<unsigned int> casters;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			glm::quat rotation = glm::angleAxis(0.1f * frame, glm::vec3(0.0f, 1.0f, 0.0f));
+			for (unsigned int node = 0; node < count; node++)
+				graph.SetRotation(node, rotation);
+			graph.Update(jobSystem);
+			store.UpdateBounds(graph, jobSystem);
+			store.GatherVisible(cameraFrustum, visible, jobSystem);
+			store.GatherShadowCasters([&lightPos](const AABB& bounds) { return sphereIntersectsAABB(lightPos, 25.0f, bounds); }, casters, jobSystem);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+		std::cout << count << ", " << ms << ", " << 1e6 * ms / count << std::endl;
+	}
+}
+
+void checkFrameAllocations(GLFWwindow* window, const AllocationCounts& frameStart)
+{
+	allocationCheckFrame++;
+	if (allocationCheckFrame <= ALLOCATION_CHECK_WARMUP_FRAMES)
+		return;
+
+	AllocationCounts frameEnd = getAllocationCounts();
+	if (frameEnd.allocations != frameStart.allocations)
+	{
+		std::cout << "Error::Main::Frame " << allocationCheckFrame << " made " << frameEnd.allocations - frameStart.allocations
+			<< " heap allocations (" << frameEnd.bytes - frameStart.bytes << " bytes)" << std::endl;
+		allocatingFrames++;
+	}
+
+	if (allocationCheckFrame == ALLOCATION_CHECK_WARMUP_FRAMES + ALLOCATION_CHECK_FRAMES)
+	{
+		if (allocatingFrames == 0)
+			std::cout << "Allocation check passed: no heap allocations in " << ALLOCATION_CHECK_FRAMES << " frames" << std::endl;
+		else
+			std::cout << "Allocation check failed: " << allocatingFrames << " of " << ALLOCATION_CHECK_FRAMES << " frames allocated" << std::endl;
+		exitCode = allocatingFrames == 0 ? 0 : 1;
+		glfwSetWindowShouldClose(window, true);
+	}
+}
+
+void recordBenchmarkFrame(GLFWwindow* window, long long frameStartTime)
+{
+	benchmarkFrame++;
+	if (benchmarkFrame <= BENCHMARK_WARMUP_FRAMES)
+		return;
+
+	benchmarkFrameTimes.push_back((profilerTime() - frameStartTime) / 1.0e6);
+	benchmarkRenderStats.push_back(getRenderStats());
+	if (benchmarkFrameTimes.size() == benchmarkFrames)
+	{
+		exitCode = writeBenchmarkReport(benchmarkReportPath) ? 0 : 1;
+		dumpGlInterceptor(std::cout, 20);
+		glfwSetWindowShouldClose(window, true);
+	}
+}
+
+// the scene name comes from the command line, so quotes and backslashes in it are escaped
+static std::string jsonString(const std::string& text)
+{
+	std::string escaped = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped + "\"";
+}
+
+bool writeBenchmarkReport(const std::string& path)
+{
+	std::vector<double> sorted = benchmarkFrameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	// nearest rank percentiles
+	auto percentile = [&sorted](double p) { return sorted[std::max((size_t)std::ceil(p / 100.0 * sorted.size()), (size_t)1) - 1]; };
+	double meanTime = 0.0;
+	for (double time : sorted)
+		meanTime += time / sorted.size();
+	double meanDrawCalls = 0.0, meanTriangles = 0.0;
+	unsigned long long maxDrawCalls = 0, maxTriangles = 0;
+	unsigned int overflowFrames = 0;
+	for (const RenderStats& stats : benchmarkRenderStats)
+	{
+		if (stats.streamOverflows > 0)
+			overflowFrames++;
+		meanDrawCalls += (double)stats.drawCalls / benchmarkRenderStats.size();
+		meanTriangles += (double)stats.triangles / benchmarkRenderStats.size();
+		maxDrawCalls = std::max(maxDrawCalls, stats.drawCalls);
+		maxTriangles = std::max(maxTriangles, stats.triangles);
+	}
+
+	std::cout << "Benchmark: " << sorted.size() << " frames, mean " << meanTime << " ms, p50 " << percentile(50.0) << " ms, p95 " << percentile(95.0)
+		<< " ms, p99 " << percentile(99.0) << " ms, max " << sorted.back() << " ms" << std::endl;
+	// frames that skipped draws for want of stream buffer space didn't draw the scene, so their times mean nothing
+	if (overflowFrames > 0)
+		std::cout << "Error::Main::" << overflowFrames << " benchmark frames ran out of stream buffer space and skipped draws" << std::endl;
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cout << "Error::Main::Can't write the benchmark report to " << path << std::endl;
+		return false;
+	}
+	file << "{" << std::endl;
+	file << "\t\"frames\": " << sorted.size() << "," << std::endl;
+	file << "\t\"warmupFrames\": " << BENCHMARK_WARMUP_FRAMES << "," << std::endl;
+	file << "\t\"timestep\": " << BENCHMARK_TIMESTEP << "," << std::endl;
+	file << "\t\"resolution\": \"" << screenWidth << "x" << screenHeight << "\"," << std::endl;
+	file << "\t\"renderer\": \"" << (deferredShading ? "deferred" : "forward") << "\"," << std::endl;
+	file << "\t\"depthPrepass\": " << (depthPrepass ? "true" : "false") << "," << std::endl;
+	file << "\t\"scene\": " << jsonString(stressScene.name.empty() ? "default" : stressScene.name) << "," << std::endl;
+	file << "\t\"entities\": " << entities.GetNumEntities() << "," << std::endl;
+	file << "\t\"pointLights\": " << pointLights.size() << "," << std::endl;
+	file << "\t\"gpuMemoryBytes\": " << getGpuMemoryBytes() << "," << std::endl;
+	file << "\t\"shadowAtlasBytes\": " << shadowAtlas.GetMemoryUsage() << "," << std::endl;
+	file << "\t\"frameTimeMs\": { \"mean\": " << meanTime << ", \"p50\": " << percentile(50.0) << ", \"p95\": " << percentile(95.0)
+		<< ", \"p99\": " << percentile(99.0) << ", \"max\": " << sorted.back() << " }," << std::endl;
+	file << "\t\"drawCalls\": { \"mean\": " << meanDrawCalls << ", \"max\": " << maxDrawCalls << " }," << std::endl;
+	file << "\t\"triangles\": { \"mean\": " << meanTriangles << ", \"max\": " << maxTriangles << " }," << std::endl;
+	file << "\t\"streamOverflowFrames\": " << overflowFrames << std::endl;
+	file << "}" << std::endl;
+	return overflowFrames == 0;
 }
\ No newline at end of file
@@ -1,26 +1,42 @@
 #include "Mesh.h"
+#include "GpuMemory.h"
+#include "RenderStats.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) :
-	mVertices(vertices),
-	mIndices(indices),
-	mTextures(textures)
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, CpuGeometry cpuGeometry) :
+	mVertices(std::move(vertices)),
+	mIndices(std::move(indices)),
+	mTextures(std::move(textures)),
+	mSamplerNames(makeSamplerNames(mTextures)),
+	mIndexCount(mIndices.size())
 {
 	SetupMesh();
+	if (cpuGeometry == CpuGeometry::Release)
+	{
+		std::vector<Vertex>().swap(mVertices);
+		std::vector<unsigned int>().swap(mIndices);
+	}
 }
 
 void Mesh::SetupMesh()
 {
-	glGenVertexArrays(1, &mVAO);
-	glGenBuffers(1, &mVBO);
-	glGenBuffers(1, &mEBO);
+	mBounds = AABB{ mVertices[0].Position, mVertices[0].Position };
+	for (int i = 1; i < mVertices.size(); i++)
+		mBounds = AABB{ glm::min(mBounds.min, mVertices[i].Position), glm::max(mBounds.max, mVertices[i].Position) };
+
+	mVAO = GlVertexArray::Create();
+	mVBO = GlBuffer::Create();
+	mEBO = GlBuffer::Create();
+	TRACK_GPU_OBJECT(GpuResourceType::VertexArray, mVAO, "model mesh");
 
 	glBindVertexArray(mVAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * mVertices.size(), &mVertices[0], GL_STATIC_DRAW);
+	TRACK_GPU_BUFFER(mVBO, sizeof(Vertex) * mVertices.size(), "model mesh vertices");
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * mIndices.size(), &mIndices[0], GL_STATIC_DRAW);
+	TRACK_GPU_BUFFER(mEBO, sizeof(unsigned int) * mIndices.size(), "model mesh indices");
 
 	// Positions
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -41,32 +57,44 @@ void Mesh::SetupMesh()
 	glBindVertexArray(0);
 }
 
-void Mesh::Draw(Shader shader)
+void Mesh::Draw(const Shader& shader)
 {
-	/* CONVENTION: */
-	// assume that each sampler2D in the shader is called either texture_diffuseN or
-	// texture_specularN, where N ranges from 1 to the maximum number of texture units allowed
-	int diffuseNum = 1, specularNum = 1, normalNum = 1;
 	for (int i = 0; i < mTextures.size(); i++)
 	{
 		glActiveTexture(GL_TEXTURE0 + i);
-		std::string number;
-		std::string name = mTextures[i].type;
-		if (name == "texture_diffuse")
-			number = std::to_string(diffuseNum++);
-		else if (name == "texture_specular")
-			number = std::to_string(specularNum++);
-		else if (name == "texture_normal")
-			number = std::to_string(normalNum++);
-
-		shader.SetInt(("material." + name + number).c_str(), i);
+		shader.SetInt(mSamplerNames[i].c_str(), i);
 		glBindTexture(GL_TEXTURE_2D, mTextures[i].id);
 	}
 
 	// Draw
 	glBindVertexArray(mVAO);
-	glDrawElements(GL_TRIANGLES, mIndices.size(), GL_UNSIGNED_INT, 0);
+	glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, 0);
+	countDraw(mIndexCount / 3);
 	glBindVertexArray(0);
 
 	glActiveTexture(GL_TEXTURE0);
+}
+
+std::vector<std::string> makeSamplerNames(const std::vector<Texture>& textures)
+{
+	/* CONVENTION: */
+	// assume that each sampler2D in the shader is called texture_<type>N,
+	// where N ranges from 1 to the maximum number of texture units allowed
+	int diffuseNum = 1, specularNum = 1, normalNum = 1, displacementNum = 1;
+	std::vector<std::string> names;
+	for (const Texture& texture : textures)
+	{
+		std::string number;
+		const std::string& name = texture.type;
+		if (name == "texture_diffuse")
+			number = std::to_string(diffuseNum++);
+		else if (name == "texture_specular")
+			number = std::to_string(specularNum++);
+		else if (name == "texture_normal")
+			number = std::to_string(normalNum++);
+		else if (name == "texture_displacement")
+			number = std::to_string(displacementNum++);
+		names.push_back("material." + name + number);
+	}
+	return names;
 }
\ No newline at end of file
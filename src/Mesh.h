@@ -3,6 +3,8 @@
 #include <string>
 #include "Shader.h"
 #include <vector>
+#include "AABB.h"
+#include "GlObject.h"
 
 struct Vertex
 {
@@ -20,11 +22,28 @@ struct Texture
 	std::string path;
 };
 
+// The sampler uniform of each texture: "material." + type + N, where N counts the textures of that type from 1.
+// Built once per mesh, so that drawing doesn't assemble strings.
+std::vector<std::string> makeSamplerNames(const std::vector<Texture>& textures);
+
+// Whether a mesh holds on to its vertices and indices once they are in GL buffers. Drawing only needs the
+// buffers and the bounds are kept either way, so only meshes that are culled or picked per triangle need them.
+enum class CpuGeometry { Release, Keep };
+
 class Mesh
 {
 public:
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-	void Draw(Shader shader);
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, CpuGeometry cpuGeometry = CpuGeometry::Release);
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
+
+	void Draw(const Shader& shader);
+	const AABB& GetBounds() const { return mBounds; }
+	// empty unless the mesh was made with CpuGeometry::Keep
+	const std::vector<Vertex>& GetVertices() const { return mVertices; }
+	const std::vector<unsigned int>& GetIndices() const { return mIndices; }
 
 private:
 	void SetupMesh();
@@ -32,5 +51,9 @@ private:
 	std::vector<Vertex> mVertices;
 	std::vector<unsigned int> mIndices;
 	std::vector<Texture> mTextures;
-	unsigned int mVAO, mVBO, mEBO;
+	std::vector<std::string> mSamplerNames;
+	GlVertexArray mVAO;
+	GlBuffer mVBO, mEBO;
+	unsigned int mIndexCount = 0;
+	AABB mBounds;
 };
\ No newline at end of file
@@ -1,13 +1,15 @@
 #include "Model.h"
 #include <iostream>
 #include "stb_image.h"
+#include "CpuProfiler.h"
+#include "GpuMemory.h"
 
-Model::Model(const std::string& path)
+Model::Model(const std::string& path, CpuGeometry cpuGeometry) : mCpuGeometry(cpuGeometry)
 {
 	LoadModel(path);
 }
 
-void Model::Draw(Shader shader)
+void Model::Draw(const Shader& shader)
 {
 	for (int i = 0; i < mMeshes.size(); i++)
 		mMeshes[i].Draw(shader);
@@ -16,7 +18,11 @@ void Model::Draw(Shader shader)
 void Model::LoadModel(std::string path)
 {
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	const aiScene* scene;
+	{
+		CpuScope scope("Assimp import");
+		scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	}
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
@@ -26,7 +32,15 @@ void Model::LoadModel(std::string path)
 
 	mDirectory = path.substr(0, path.find_last_of('/'));
 
+	CpuScope scope("Model meshes and textures");
 	ProcessNode(scene->mRootNode, scene);
+
+	if (!mMeshes.empty())
+	{
+		mBounds = mMeshes[0].GetBounds();
+		for (int i = 1; i < mMeshes.size(); i++)
+			mBounds = mergeAABB(mBounds, mMeshes[i].GetBounds());
+	}
 }
 
 void Model::ProcessNode(aiNode* node, const aiScene* scene)
@@ -34,7 +48,7 @@ void Model::ProcessNode(aiNode* node, const aiScene* scene)
 	for (int i = 0; i < node->mNumMeshes; i++)
 	{
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		mMeshes.push_back(ProcessMesh(mesh, scene));
+		ProcessMesh(mesh, scene);
 	}
 
 	for (int i = 0; i < node->mNumChildren; i++)
@@ -43,7 +57,7 @@ void Model::ProcessNode(aiNode* node, const aiScene* scene)
 	}
 }
 
-Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
+void Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 {
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
@@ -111,7 +125,7 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 	}
 	
-	return Mesh(vertices, indices, textures);
+	mMeshes.emplace_back(std::move(vertices), std::move(indices), std::move(textures), mCpuGeometry);
 }
 
 std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* material, aiTextureType type, std::string typeName)
@@ -134,11 +148,9 @@ std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* material, aiTexture
 		}
 		if (!skip)
 		{
+			mTextureObjects.push_back(TextureFromFile(str.C_Str(), mDirectory, typeName == "texture_diffuse"));
 			Texture texture;
-			if(typeName == "texture_diffuse")
-				texture.id = TextureFromFile(str.C_Str(), mDirectory, true);
-			else
-				texture.id = TextureFromFile(str.C_Str(), mDirectory, false);
+			texture.id = mTextureObjects.back();
 			texture.type = typeName;
 			texture.path = str.C_Str();
 			textures.push_back(texture);
@@ -148,13 +160,13 @@ std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* material, aiTexture
 	return textures;
 }
 
-unsigned int TextureFromFile(const char* path, const std::string& directory, bool gammaCorrection)
+GlTexture TextureFromFile(const char* path, const std::string& directory, bool gammaCorrection)
 {
+	CpuScope scope("Model texture load");
 	std::string filename(path);
 	filename = directory + '/' + filename;
 
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	GlTexture textureID = GlTexture::Create();
 	stbi_set_flip_vertically_on_load(false);
 	int width, height, numChannels;
 	unsigned char* image = stbi_load(filename.c_str(), &width, &height, &numChannels, 0);
@@ -177,6 +189,7 @@ unsigned int TextureFromFile(const char* path, const std::string& directory, boo
 		glBindTexture(GL_TEXTURE_2D, textureID);
 		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, image);
 		glGenerateMipmap(GL_TEXTURE_2D);
+		TRACK_GPU_TEXTURE(textureID, internalFormat, width, height, 1, 1, true, filename);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -11,18 +11,27 @@ class Model
 {
 public:
 	Model() = default;
-	Model(const std::string& path);
-	void Draw(Shader shader);
+	Model(const std::string& path, CpuGeometry cpuGeometry = CpuGeometry::Release);
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+	Model(Model&&) = default;
+	Model& operator=(Model&&) = default;
+
+	void Draw(const Shader& shader);
+	const AABB& GetBounds() const { return mBounds; }
 
 private:
 	void LoadModel(std::string path);
 	void ProcessNode(aiNode* node, const aiScene* scene);
-	Mesh ProcessMesh(aiMesh* mesh, const aiScene* scene);
+	void ProcessMesh(aiMesh* mesh, const aiScene* scene);
 	std::vector<Texture> LoadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
 
 	std::vector<Mesh> mMeshes;
 	std::string mDirectory;
 	std::vector<Texture> mLoadedTextures;
+	std::vector<GlTexture> mTextureObjects; // the textures in mLoadedTextures, which the meshes only refer to
+	CpuGeometry mCpuGeometry = CpuGeometry::Release;
+	AABB mBounds;
 };
 
-unsigned int TextureFromFile(const char* path, const std::string& directory, bool gammaCorrection);
\ No newline at end of file
+GlTexture TextureFromFile(const char* path, const std::string& directory, bool gammaCorrection);
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "Regression.h"
+#include "RenderStats.h"
+#include "Utility.h"
+#include "stb_image.h"
+#include <glad\glad.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const unsigned int WARMUP_FRAMES = 10;
+static const unsigned int MEASURED_FRAMES = 30;
+// largest possible YIQ difference, between black and white
+static const double MAX_YIQ_DELTA = 35215.0;
+
+static double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+// squared difference of two RGB colours in YIQ space, weighted towards brightness
+static double yiqDelta(const unsigned char* a, const unsigned char* b)
+{
+	double dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+	double y = 0.29889531 * dr + 0.58662247 * dg + 0.11448223 * db;
+	double i = 0.59597799 * dr - 0.27417610 * dg - 0.32180189 * db;
+	double q = 0.21147017 * dr - 0.52261711 * dg + 0.31114694 * db;
+	return 0.5053 * y * y + 0.299 * i * i + 0.1957 * q * q;
+}
+
+RegressionTest::RegressionTest(const RegressionOptions& options, const std::vector<RegressionPose>& poses) :
+	mOptions(options),
+	mPoses(poses)
+{
+	mResults.reserve(mPoses.size());
+	mCpuTimes.reserve(MEASURED_FRAMES);
+	mGpuTimes.reserve(MEASURED_FRAMES);
+}
+
+void RegressionTest::EndFrame(double cpuMilliseconds, double gpuMilliseconds, int width, int height)
+{
+	if (IsFinished())
+		return;
+	mFrame++;
+	if (mFrame <= WARMUP_FRAMES)
+		return;
+	mCpuTimes.push_back(cpuMilliseconds);
+	mGpuTimes.push_back(gpuMilliseconds);
+	mStreamOverflows += getRenderStats().streamOverflows;
+	if (mFrame < WARMUP_FRAMES + MEASURED_FRAMES)
+		return;
+
+	// read the frame back top row first, the way images are stored
+	std::vector<unsigned char> pixels(width * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	std::vector<unsigned char> flipped(pixels.size());
+	for (int y = 0; y < height; y++)
+		std::copy(pixels.begin() + y * width * 3, pixels.begin() + (y + 1) * width * 3, flipped.begin() + (height - 1 - y) * width * 3);
+
+	Result result = { median(mCpuTimes), median(mGpuTimes), true, 0.0, mStreamOverflows };
+	const std::string referencePath = mOptions.directory + "/" + GetPose().name + ".png";
+	if (mOptions.update)
+		result.imagePassed = writePng(referencePath, flipped.data(), width, height, 3);
+	else
+		CheckImage(flipped, width, height, result);
+	mResults.push_back(result);
+
+	mPose++;
+	mFrame = 0;
+	mCpuTimes.clear();
+	mGpuTimes.clear();
+	mStreamOverflows = 0;
+}
+
+void RegressionTest::CheckImage(const std::vector<unsigned char>& pixels, int width, int height, Result& result) const
+{
+	const std::string referencePath = mOptions.directory + "/" + GetPose().name + ".png";
+	int referenceWidth, referenceHeight, numChannels;
+	unsigned char* reference = stbi_load(referencePath.c_str(), &referenceWidth, &referenceHeight, &numChannels, 3);
+	if (!reference)
+	{
+		std::cout << "Error::RegressionTest::No reference image at " << referencePath << " (run with --regression-update to make one)" << std::endl;
+		result.imagePassed = false;
+		result.changedPixels = 1.0;
+	}
+	else if (referenceWidth != width || referenceHeight != height)
+	{
+		std::cout << "Error::RegressionTest::" << referencePath << " is " << referenceWidth << "x" << referenceHeight << ", not " << width << "x" << height << std::endl;
+		result.imagePassed = false;
+		result.changedPixels = 1.0;
+	}
+	else
+	{
+		double maxDelta = MAX_YIQ_DELTA * mOptions.pixelThreshold * mOptions.pixelThreshold;
+		unsigned int changed = 0;
+		for (int i = 0; i < width * height; i++)
+		{
+			if (yiqDelta(&pixels[i * 3], &reference[i * 3]) > maxDelta)
+				changed++;
+		}
+		result.changedPixels = (double)changed / (width * height);
+		result.imagePassed = result.changedPixels <= mOptions.maxChangedPixels;
+	}
+	stbi_image_free(reference);
+
+	// keep what was drawn next to the reference, to look at
+	if (!result.imagePassed)
+		writePng(mOptions.directory + "/" + GetPose().name + "_actual.png", pixels.data(), width, height, 3);
+}
+
+bool RegressionTest::Report() const
+{
+	const std::string baselinePath = mOptions.directory + "/baseline.txt";
+	if (mOptions.update)
+	{
+		// one line per pose: name, CPU milliseconds, GPU milliseconds
+		std::ofstream file(baselinePath);
+		for (unsigned int i = 0; i < mResults.size(); i++)
+			file << mPoses[i].name << " " << mResults[i].cpuMilliseconds << " " << mResults[i].gpuMilliseconds << std::endl;
+		bool passed = (bool)file;
+		for (const Result& result : mResults)
+			passed = passed && result.imagePassed && result.streamOverflows == 0;
+		std::cout << (passed ? "Regression references updated in " : "Error::RegressionTest::Couldn't write the references to ") << mOptions.directory << std::endl;
+		return passed;
+	}
+
+	std::ifstream file(baselinePath);
+	if (!file)
+		std::cout << "Error::RegressionTest::No timing baseline at " << baselinePath << " (run with --regression-update to make one)" << std::endl;
+	std::vector<std::string> names;
+	std::vector<double> baselineCpu, baselineGpu;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string name;
+		double cpu, gpu;
+		if (stream >> name >> cpu >> gpu)
+		{
+			names.push_back(name);
+			baselineCpu.push_back(cpu);
+			baselineGpu.push_back(gpu);
+		}
+	}
+
+	bool passed = true;
+	double limit = 1.0 + mOptions.timeThreshold;
+	for (unsigned int i = 0; i < mResults.size(); i++)
+	{
+		const Result& result = mResults[i];
+		auto baseline = std::find(names.begin(), names.end(), mPoses[i].name);
+		bool hasBaseline = baseline != names.end();
+		double cpu = hasBaseline ? baselineCpu[baseline - names.begin()] : 0.0;
+		double gpu = hasBaseline ? baselineGpu[baseline - names.begin()] : 0.0;
+		bool cpuPassed = hasBaseline && result.cpuMilliseconds <= cpu * limit;
+		bool gpuPassed = hasBaseline && result.gpuMilliseconds <= gpu * limit;
+		passed = passed && result.imagePassed && result.streamOverflows == 0 && cpuPassed && gpuPassed;
+
+		std::cout << mPoses[i].name << ": image " << (result.imagePassed ? "ok" : "CHANGED") << " (" << 100.0 * result.changedPixels << "% of pixels differ)"
+			<< (result.streamOverflows == 0 ? "" : ", DRAWS SKIPPED (stream buffer full)")
+			<< ", CPU " << result.cpuMilliseconds << " ms (baseline " << cpu << ")" << (cpuPassed ? "" : " SLOWER")
+			<< ", GPU " << result.gpuMilliseconds << " ms (baseline " << gpu << ")" << (gpuPassed ? "" : " SLOWER") << std::endl;
+	}
+	std::cout << "Regression test " << (passed ? "passed" : "failed") << std::endl;
+	return passed;
+}
\ No newline at end of file
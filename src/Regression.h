@@ -0,0 +1,67 @@
+#pragma once
+#include "CameraPath.h"
+#include <string>
+#include <vector>
+
+// A fixed view of the scene: where the camera is and the moment of the animation it sees
+struct RegressionPose
+{
+	const char* name;
+	CameraKey camera;
+	float time;
+};
+
+struct RegressionOptions
+{
+	// holds <pose>.png references and baseline.txt timings; must exist
+	std::string directory = "regression";
+	// store the images and timings of this run as the new references instead of checking against them
+	bool update = false;
+	// perceptual colour difference (0 to 1) above which a pixel counts as changed
+	float pixelThreshold = 0.1f;
+	// fraction of an image's pixels that may change before it fails
+	float maxChangedPixels = 0.001f;
+	// how much slower than the baseline a pose's CPU or GPU time may get before it fails, e.g. 0.25 for 25%
+	float timeThreshold = 0.25f;
+};
+
+// Golden image and timing checks over a list of poses.
+// Each pose is drawn for a number of warm-up frames, so that time dependent state such as the shadow atlas
+// settles, then for a number of measured frames; the median CPU and GPU frame times are kept, and the last frame is
+// read back and compared with the pose's reference image. A measured frame that skipped draws because a stream buffer
+// was full fails its pose. Report() then compares the timings with the baseline.
+// Images are compared in YIQ space, which weights colour differences roughly as the eye does.
+class RegressionTest
+{
+public:
+	RegressionTest() = default;
+	RegressionTest(const RegressionOptions& options, const std::vector<RegressionPose>& poses);
+
+	bool IsFinished() const { return mPose >= mPoses.size(); }
+	const RegressionPose& GetPose() const { return mPoses[mPose]; }
+	// call once a frame is drawn to the default framebuffer, before it is presented
+	void EndFrame(double cpuMilliseconds, double gpuMilliseconds, int width, int height);
+	// prints the results, or stores the references when updating; returns false if anything failed
+	bool Report() const;
+
+private:
+	struct Result
+	{
+		double cpuMilliseconds;
+		double gpuMilliseconds;
+		bool imagePassed;
+		double changedPixels; // fraction
+		unsigned long long streamOverflows; // stream buffer writes that didn't fit, over the measured frames
+	};
+
+	void CheckImage(const std::vector<unsigned char>& pixels, int width, int height, Result& result) const;
+
+	RegressionOptions mOptions;
+	std::vector<RegressionPose> mPoses;
+	std::vector<Result> mResults;
+	unsigned int mPose = 0;
+	unsigned int mFrame = 0;
+	std::vector<double> mCpuTimes;
+	std::vector<double> mGpuTimes;
+	unsigned long long mStreamOverflows = 0;
+};
\ No newline at end of file
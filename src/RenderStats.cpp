@@ -0,0 +1,24 @@
+#include "RenderStats.h"
+
+static RenderStats gStats = { 0, 0, 0 };
+
+void countDraw(unsigned long long triangles)
+{
+	gStats.drawCalls++;
+	gStats.triangles += triangles;
+}
+
+void countStreamOverflow()
+{
+	gStats.streamOverflows++;
+}
+
+RenderStats getRenderStats()
+{
+	return gStats;
+}
+
+void resetRenderStats()
+{
+	gStats = { 0, 0, 0 };
+}
\ No newline at end of file
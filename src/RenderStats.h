@@ -0,0 +1,16 @@
+#pragma once
+
+// Draw calls and triangles submitted since the last resetRenderStats(), counted where the draws are issued, and the
+// writes a stream buffer had no room for: the draws needing those were skipped, so the frame is incomplete.
+// Only the GL thread draws, so the counts aren't synchronised.
+struct RenderStats
+{
+	unsigned long long drawCalls;
+	unsigned long long triangles;
+	unsigned long long streamOverflows;
+};
+
+void countDraw(unsigned long long triangles);
+void countStreamOverflow();
+RenderStats getRenderStats();
+void resetRenderStats();
\ No newline at end of file
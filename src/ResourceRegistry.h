@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Index into a ResourceRegistry plus the generation of the slot it was issued for. Removing a resource
+// bumps its slot's generation, so handles kept from before are recognised as stale. The tag keeps
+// handles of different resource types from being mixed up, including types that share a C++ type.
+template<typename Tag>
+struct Handle
+{
+	unsigned int index = ~0u;
+	unsigned int generation = 0;
+
+	bool IsValid() const { return index != ~0u; }
+	bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+// Resources stored contiguously and looked up by handle.
+// Names are only for resolving handles while loading: the render loop indexes the array directly.
+// Debug builds check every access against the slot's generation.
+// Resources are moved in and owned by the registry, so move only types (GL object wrappers) can be stored.
+template<typename T, typename Tag = T>
+class ResourceRegistry
+{
+public:
+	Handle<Tag> Add(const std::string& name, T resource)
+	{
+		if (mNames.count(name))
+			std::cout << "Error::ResourceRegistry::A resource is already called " << name << std::endl;
+
+		Handle<Tag> handle;
+		if (!mFreeSlots.empty())
+		{
+			handle.index = mFreeSlots.back();
+			mFreeSlots.pop_back();
+			mResources[handle.index] = std::move(resource);
+		}
+		else
+		{
+			handle.index = mResources.size();
+			mResources.push_back(std::move(resource));
+			mGenerations.push_back(0);
+		}
+		handle.generation = mGenerations[handle.index];
+		mNames[name] = handle;
+		return handle;
+	}
+
+	void Remove(Handle<Tag> handle)
+	{
+		if (!IsAlive(handle))
+		{
+			std::cout << "Error::ResourceRegistry::Removing a stale handle" << std::endl;
+			return;
+		}
+		mGenerations[handle.index]++;
+		mResources[handle.index] = T();
+		mFreeSlots.push_back(handle.index);
+		for (auto it = mNames.begin(); it != mNames.end(); ++it)
+		{
+			if (it->second == handle)
+			{
+				mNames.erase(it);
+				break;
+			}
+		}
+	}
+
+	// destroys every resource and invalidates every handle; call while whatever the resources need (the GL
+	// context) is still around, as the registries themselves are only destroyed after main returns
+	void Clear()
+	{
+		for (unsigned int& generation : mGenerations)
+			generation++;
+		mFreeSlots.clear();
+		for (unsigned int i = 0; i < mResources.size(); i++)
+		{
+			mResources[i] = T();
+			mFreeSlots.push_back(i);
+		}
+		mNames.clear();
+	}
+
+	// load time only; unlike std::map::operator[] a misspelt name is reported instead of inserted
+	Handle<Tag> Find(const std::string& name) const
+	{
+		auto it = mNames.find(name);
+		if (it == mNames.end())
+		{
+			std::cout << "Error::ResourceRegistry::No resource called " << name << std::endl;
+			return Handle<Tag>();
+		}
+		return it->second;
+	}
+
+	bool IsAlive(Handle<Tag> handle) const { return handle.index < mResources.size() && mGenerations[handle.index] == handle.generation; }
+
+	T& operator[](Handle<Tag> handle)
+	{
+		CheckHandle(handle);
+		return mResources[handle.index];
+	}
+	const T& operator[](Handle<Tag> handle) const
+	{
+		CheckHandle(handle);
+		return mResources[handle.index];
+	}
+
+	unsigned int GetSize() const { return mResources.size() - mFreeSlots.size(); }
+
+private:
+	void CheckHandle(Handle<Tag> handle) const
+	{
+#ifdef _DEBUG
+		if (!IsAlive(handle))
+		{
+			std::cout << "Error::ResourceRegistry::Stale or invalid handle (index " << handle.index << ", generation " << handle.generation << ")" << std::endl;
+			std::abort();
+		}
+#endif
+	}
+
+	std::vector<T> mResources;
+	std::vector<unsigned int> mGenerations;
+	std::vector<unsigned int> mFreeSlots;
+	std::map<std::string, Handle<Tag>> mNames;
+};
\ No newline at end of file
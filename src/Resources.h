@@ -0,0 +1,15 @@
+#pragma once
+#include "ResourceRegistry.h"
+#include "Shader.h"
+#include "BasicMesh.h"
+#include "Model.h"
+#include "Utility.h"
+
+// GL object names are plain unsigned ints, so textures get their own handle tag
+struct TextureTag {};
+
+typedef Handle<Shader> ShaderHandle;
+typedef Handle<BasicMesh> MeshHandle;
+typedef Handle<Model> ModelHandle;
+typedef Handle<TextureTag> TextureHandle;
+typedef Handle<Framebuffer> FramebufferHandle;
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "SceneGraph.h"
+#include <xmmintrin.h>
+#include <algorithm>
+
+// out = a * b for column major matrices: each column of out is the columns of a weighted by a column of b.
+// out may be a or b.
+static void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+	__m128 a0 = _mm_loadu_ps(&a[0][0]);
+	__m128 a1 = _mm_loadu_ps(&a[1][0]);
+	__m128 a2 = _mm_loadu_ps(&a[2][0]);
+	__m128 a3 = _mm_loadu_ps(&a[3][0]);
+	__m128 columns[4];
+	for (int i = 0; i < 4; i++)
+	{
+		__m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[i][0]));
+		column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[i][1])));
+		column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[i][2])));
+		column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[i][3])));
+		columns[i] = column;
+	}
+	for (int i = 0; i < 4; i++)
+		_mm_storeu_ps(&out[i][0], columns[i]);
+}
+
+// translation * rotation * scale, with the scale folded into the rotation's columns
+static glm::mat4 localMatrix(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	glm::mat3 r = glm::mat3_cast(rotation);
+	return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f), glm::vec4(r[1] * scale.y, 0.0f), glm::vec4(r[2] * scale.z, 0.0f), glm::vec4(position, 1.0f));
+}
+
+unsigned int SceneGraph::AddNode(int parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	mPositions.push_back(position);
+	mRotations.push_back(rotation);
+	mScales.push_back(scale);
+	mParents.push_back(parent);
+	mWorldMatrices.push_back(glm::mat4(1.0f));
+	mDirty.push_back(1);
+
+	unsigned int node = mParents.size() - 1;
+	mFirstDirty = std::min(mFirstDirty, node);
+	return node;
+}
+
+void SceneGraph::SetPosition(unsigned int node, const glm::vec3& position)
+{
+	mPositions[node] = position;
+	MarkDirty(node);
+}
+
+void SceneGraph::SetRotation(unsigned int node, const glm::quat& rotation)
+{
+	mRotations[node] = rotation;
+	MarkDirty(node);
+}
+
+void SceneGraph::SetScale(unsigned int node, const glm::vec3& scale)
+{
+	mScales[node] = scale;
+	MarkDirty(node);
+}
+
+void SceneGraph::Update(JobSystem& jobs)
+{
+	unsigned int numNodes = mParents.size();
+	if (mFirstDirty >= numNodes)
+		return;
+
+	// parents come before their children, so a parent's flag is final by the time its children are reached
+	for (unsigned int i = mFirstDirty; i < numNodes; i++)
+	{
+		int parent = mParents[i];
+		if (parent >= 0 && mDirty[parent])
+			mDirty[i] = 1;
+	}
+
+	// local matrices don't depend on each other, so they are built in parallel. A root's local matrix is its
+	// world matrix; a child's is parked in its world matrix slot until its parent's is known.
+	jobs.ParallelFor(numNodes - mFirstDirty, 1024, [this](unsigned int begin, unsigned int end) {
+		for (unsigned int i = mFirstDirty + begin; i < mFirstDirty + end; i++)
+		{
+			if (mDirty[i])
+				mWorldMatrices[i] = localMatrix(mPositions[i], mRotations[i], mScales[i]);
+		}
+	});
+
+	// then the children, in order, so that every parent is finished first
+	for (unsigned int i = mFirstDirty; i < numNodes; i++)
+	{
+		if (mDirty[i] && mParents[i] >= 0)
+			multiplyMatrices(mWorldMatrices[mParents[i]], mWorldMatrices[i], mWorldMatrices[i]);
+	}
+
+	std::fill(mDirty.begin() + mFirstDirty, mDirty.end(), 0);
+	mFirstDirty = numNodes;
+}
+
+void SceneGraph::MarkDirty(unsigned int node)
+{
+	mDirty[node] = 1;
+	mFirstDirty = std::min(mFirstDirty, node);
+}
\ No newline at end of file
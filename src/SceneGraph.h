@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <glm\glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "JobSystem.h"
+
+// Transform hierarchy.
+// Each node's local position, rotation and scale, its parent and its world matrix are kept in separate
+// arrays indexed by node. A parent is always added before its children, so walking the arrays in order
+// visits parents first and Update() can rebuild the world matrices in one pass. Only nodes that were
+// changed, or whose parent's world matrix was rebuilt, are recomputed; a static scene costs nothing.
+class SceneGraph
+{
+public:
+	// parent is -1 for a root node
+	unsigned int AddNode(int parent, const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+	void SetPosition(unsigned int node, const glm::vec3& position);
+	void SetRotation(unsigned int node, const glm::quat& rotation);
+	void SetScale(unsigned int node, const glm::vec3& scale);
+
+	void Update(JobSystem& jobs);
+
+	const glm::mat4& GetWorldMatrix(unsigned int node) const { return mWorldMatrices[node]; }
+	unsigned int GetNumNodes() const { return mParents.size(); }
+
+private:
+	void MarkDirty(unsigned int node);
+
+	std::vector<glm::vec3> mPositions;
+	std::vector<glm::quat> mRotations;
+	std::vector<glm::vec3> mScales;
+	std::vector<int> mParents;
+	std::vector<glm::mat4> mWorldMatrices;
+	std::vector<unsigned char> mDirty;
+
+	// nodes before this one are clean, so Update() starts here
+	unsigned int mFirstDirty = 0;
+};
\ No newline at end of file
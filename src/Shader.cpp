@@ -1,4 +1,6 @@
 #include "Shader.h"
+#include "CpuProfiler.h"
+#include "GpuMemory.h"
 #include <fstream>
 #include <sstream>
 #include <glfw3.h>
@@ -6,6 +8,7 @@
 
 Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& geometryPath)
 {
+	CpuScope scope("Shader compile");
 	// 1. Read vertex shader and fragment shader source code from file
 	std::ifstream vertexFile;
 	std::ifstream fragmentFile;
@@ -30,8 +33,8 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, c
 		vertexFile.close();
 		fragmentFile.close();
 		// convert streams to strings
-		vertexCode = vertexStream.str();
-		fragmentCode = fragmentStream.str();
+		vertexCode = ResolveIncludes(vertexStream.str(), vertexPath);
+		fragmentCode = ResolveIncludes(fragmentStream.str(), fragmentPath);
 
 		if (geometryPath != "")
 		{
@@ -39,7 +42,7 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, c
 			std::stringstream geometryStream;
 			geometryStream << geometryFile.rdbuf();
 			geometryFile.close();
-			geometryCode = geometryStream.str();
+			geometryCode = ResolveIncludes(geometryStream.str(), geometryPath);
 		}
 	}
 	catch (std::ifstream::failure& e)
@@ -74,7 +77,8 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, c
 		CheckCompilation(geometry, "Geometry");
 	}
 	// complete shader program
-	mID = glCreateProgram();
+	mID = GlProgram::Create();
+	TRACK_GPU_OBJECT(GpuResourceType::Program, mID, fragmentPath);
 	glAttachShader(mID, vertex);
 	glAttachShader(mID, fragment);
 	if (geometryPath != "")
@@ -92,59 +96,59 @@ void Shader::Use()
 	glUseProgram(mID);
 }
 
-void Shader::SetBool(const std::string& name, bool value) const
+void Shader::SetBool(const char* name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(mID, name.c_str()), value);
+	glUniform1i(glGetUniformLocation(mID, name), value);
 }
 
-void Shader::SetFloat(const std::string& name, float value) const
+void Shader::SetFloat(const char* name, float value) const
 {
-	glUniform1f(glGetUniformLocation(mID, name.c_str()), value);
+	glUniform1f(glGetUniformLocation(mID, name), value);
 }
 
-void Shader::SetInt(const std::string& name, int value) const
+void Shader::SetInt(const char* name, int value) const
 {
-	glUniform1i(glGetUniformLocation(mID, name.c_str()), value);
+	glUniform1i(glGetUniformLocation(mID, name), value);
 }
 
-void Shader::SetVec2f(const std::string& name, float v1, float v2) const
+void Shader::SetVec2f(const char* name, float v1, float v2) const
 {
-	glUniform2f(glGetUniformLocation(mID, name.c_str()), v1, v2);
+	glUniform2f(glGetUniformLocation(mID, name), v1, v2);
 }
 
-void Shader::SetVec2f(const std::string& name, const glm::vec2& vec) const
+void Shader::SetVec2f(const char* name, const glm::vec2& vec) const
 {
-	glUniform2fv(glGetUniformLocation(mID, name.c_str()), 1, &vec[0]);
+	glUniform2fv(glGetUniformLocation(mID, name), 1, &vec[0]);
 }
 
-void Shader::SetVec3f(const std::string& name, float v1, float v2, float v3) const
+void Shader::SetVec3f(const char* name, float v1, float v2, float v3) const
 {
-	glUniform3f(glGetUniformLocation(mID, name.c_str()), v1, v2, v3);
+	glUniform3f(glGetUniformLocation(mID, name), v1, v2, v3);
 }
 
-void Shader::SetVec3f(const std::string& name, const glm::vec3& vec) const
+void Shader::SetVec3f(const char* name, const glm::vec3& vec) const
 {
-	glUniform3fv(glGetUniformLocation(mID, name.c_str()), 1, &vec[0]);
+	glUniform3fv(glGetUniformLocation(mID, name), 1, &vec[0]);
 }
 
-void Shader::SetVec4f(const std::string& name, float v1, float v2, float v3, float v4) const
+void Shader::SetVec4f(const char* name, float v1, float v2, float v3, float v4) const
 {
-	glUniform4f(glGetUniformLocation(mID, name.c_str()), v1, v2, v3, v4);
+	glUniform4f(glGetUniformLocation(mID, name), v1, v2, v3, v4);
 }
 
-void Shader::SetVec4f(const std::string& name, const glm::vec4& vec) const
+void Shader::SetVec4f(const char* name, const glm::vec4& vec) const
 {
-	glUniform4fv(glGetUniformLocation(mID, name.c_str()), 1, &vec[0]);
+	glUniform4fv(glGetUniformLocation(mID, name), 1, &vec[0]);
 }
 
-void Shader::SetMat3f(const std::string& name, const glm::mat3& matrix) const
+void Shader::SetMat3f(const char* name, const glm::mat3& matrix) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(mID, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix3fv(glGetUniformLocation(mID, name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
-void Shader::SetMat4f(const std::string& name, const glm::mat4& matrix) const
+void Shader::SetMat4f(const char* name, const glm::mat4& matrix) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(mID, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix4fv(glGetUniformLocation(mID, name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void Shader::CheckCompilation(unsigned int id, std::string type)
@@ -172,4 +176,39 @@ void Shader::CheckCompilation(unsigned int id, std::string type)
 			std::cout << "Error::Shader::Program::Linking failed\n" << infoLog << std::endl;
 		}
 	}
+}
+
+std::string Shader::ResolveIncludes(const std::string& code, const std::string& path, int depth)
+{
+	// replace each line of the form #include "file" with the contents of that file,
+	// looked up relative to the including file
+	if (depth > 8)
+	{
+		std::cout << "Error::Shader::Include depth exceeded in " << path << std::endl;
+		return code;
+	}
+
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	std::stringstream input(code);
+	std::stringstream output;
+	std::string line;
+	while (std::getline(input, line))
+	{
+		if (line.compare(0, 10, "#include \"") == 0)
+		{
+			std::string includePath = directory + line.substr(10, line.find_last_of('"') - 10);
+			std::ifstream includeFile(includePath);
+			if (!includeFile)
+			{
+				std::cout << "Error::Shader::Included file not read: " << includePath << std::endl;
+				continue;
+			}
+			std::stringstream includeStream;
+			includeStream << includeFile.rdbuf();
+			output << ResolveIncludes(includeStream.str(), includePath, depth + 1) << '\n';
+		}
+		else
+			output << line << '\n';
+	}
+	return output.str();
 }
\ No newline at end of file
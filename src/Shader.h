@@ -4,30 +4,37 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "GlObject.h"
 
 class Shader
 {
 public:
 	Shader() = default;
 	Shader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& geometryPath = "");
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+	Shader(Shader&&) = default;
+	Shader& operator=(Shader&&) = default;
+
 	void Use();
 	unsigned int GetID() const { return mID; }
 
-	// uniform settings functions
-	void SetBool(const std::string& name, bool value) const;
-	void SetFloat(const std::string& name, float value) const;
-	void SetInt(const std::string& name, int value) const;
-	void SetVec2f(const std::string& name, float v1, float v2) const;
-	void SetVec2f(const std::string& name, const glm::vec2& vec) const;
-	void SetVec3f(const std::string& name, float v1, float v2, float v3) const;
-	void SetVec3f(const std::string& name, const glm::vec3& vec) const;
-	void SetVec4f(const std::string& name, float v1, float v2, float v3, float v4) const;
-	void SetVec4f(const std::string& name, const glm::vec4& vec) const;
-	void SetMat3f(const std::string& name, const glm::mat3& matrix) const;
-	void SetMat4f(const std::string& name, const glm::mat4& matrix) const;
+	// uniform settings functions; the names are plain C strings so that setting a uniform never allocates
+	void SetBool(const char* name, bool value) const;
+	void SetFloat(const char* name, float value) const;
+	void SetInt(const char* name, int value) const;
+	void SetVec2f(const char* name, float v1, float v2) const;
+	void SetVec2f(const char* name, const glm::vec2& vec) const;
+	void SetVec3f(const char* name, float v1, float v2, float v3) const;
+	void SetVec3f(const char* name, const glm::vec3& vec) const;
+	void SetVec4f(const char* name, float v1, float v2, float v3, float v4) const;
+	void SetVec4f(const char* name, const glm::vec4& vec) const;
+	void SetMat3f(const char* name, const glm::mat3& matrix) const;
+	void SetMat4f(const char* name, const glm::mat4& matrix) const;
 
 private:
 	void CheckCompilation(unsigned int id, std::string type);
+	static std::string ResolveIncludes(const std::string& code, const std::string& path, int depth = 0);
 
-	unsigned int mID;
+	GlProgram mID;
 };
\ No newline at end of file
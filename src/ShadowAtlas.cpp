@@ -0,0 +1,225 @@
+#include "ShadowAtlas.h"
+#include "GpuMemory.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+static const char* SHADOW_MATRIX_NAMES[6] = { "shadowMatrices[0]", "shadowMatrices[1]", "shadowMatrices[2]", "shadowMatrices[3]", "shadowMatrices[4]", "shadowMatrices[5]" };
+
+ShadowAtlas::ShadowAtlas(const std::vector<ShadowTier>& tiers, unsigned int updatesPerFrame) :
+	mUpdatesPerFrame(updatesPerFrame)
+{
+	if (tiers.size() > MAX_SHADOW_TIERS)
+		std::cout << "Error::ShadowAtlas::Only " << MAX_SHADOW_TIERS << " tiers are supported" << std::endl;
+
+	for (int i = 0; i < tiers.size() && i < MAX_SHADOW_TIERS; i++)
+	{
+		Tier tier;
+		tier.config = tiers[i];
+		tier.owners.assign(tiers[i].slots, -1);
+
+		// six layers per slot, one per cube face
+		tier.texture = GlTexture::Create();
+		glBindTexture(GL_TEXTURE_2D_ARRAY, tier.texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16, tier.config.resolution, tier.config.resolution, 6 * tier.config.slots, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		TRACK_GPU_TEXTURE(tier.texture, GL_DEPTH_COMPONENT16, tier.config.resolution, tier.config.resolution, 6 * tier.config.slots, 1, false, "shadow atlas tier");
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		// layered attachment: the depth geometry shader selects the layer with gl_Layer
+		tier.framebuffer = GlFramebuffer::Create();
+		TRACK_GPU_OBJECT(GpuResourceType::Framebuffer, tier.framebuffer, "shadow atlas tier");
+		glBindFramebuffer(GL_FRAMEBUFFER, tier.framebuffer);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tier.texture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "Error::ShadowAtlas::Framebuffer is incomplete" << std::endl;
+
+		mTiers.push_back(std::move(tier));
+	}
+
+	// glClear on a layered attachment clears every layer, so single layers are cleared through this framebuffer
+	mClearFramebuffer = GlFramebuffer::Create();
+	TRACK_GPU_OBJECT(GpuResourceType::Framebuffer, mClearFramebuffer, "shadow atlas clear");
+	glBindFramebuffer(GL_FRAMEBUFFER, mClearFramebuffer);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowAtlas::Allocate(const std::vector<PointLight>& lights, const Camera& camera, FrameArena& arena)
+{
+	mFrame++;
+
+	// lights removed since the last frame give their slots back
+	for (int i = lights.size(); i < mLightStates.size(); i++)
+		ReleaseSlot(mLightStates[i]);
+	mLightStates.resize(lights.size());
+
+	glm::mat4 projection = camera.GetProjectionMatrix();
+	Frustum frustum(projection * camera.GetViewMatrix());
+	FrameVector<unsigned int> order(arena);
+	for (int i = 0; i < lights.size(); i++)
+	{
+		LightState& state = mLightStates[i];
+		state.farPlane = calcLightRadius(lights[i]);
+		state.importance = lights[i].castsShadows ? CalcImportance(lights[i], state.farPlane, camera.GetPosition(), projection[1][1], frustum) : 0.0f;
+		if (state.importance > 0.0f)
+			order.push_back(i);
+	}
+
+	// lights that already own a slot get a small bonus so that lights close in importance don't swap tiers every frame
+	auto rankKey = [this](unsigned int i) { return mLightStates[i].importance * (mLightStates[i].valid ? 1.2f : 1.0f); };
+	std::sort(order.begin(), order.end(), [&rankKey](unsigned int a, unsigned int b) { return rankKey(a) > rankKey(b); });
+
+	// the most important lights fill the highest resolution tier first
+	FrameVector<int> desiredTier(lights.size(), -1, arena);
+	int tier = 0;
+	unsigned int used = 0;
+	for (int i = 0; i < order.size(); i++)
+	{
+		while (tier < mTiers.size() && used >= mTiers[tier].config.slots)
+		{
+			tier++;
+			used = 0;
+		}
+		if (tier == mTiers.size())
+			break;
+		desiredTier[order[i]] = tier;
+		used++;
+	}
+
+	// free the slots of lights changing tier before handing out new ones, so that lights staying in a tier keep their slot
+	for (int i = 0; i < lights.size(); i++)
+	{
+		if (mLightStates[i].tier != desiredTier[i])
+			ReleaseSlot(mLightStates[i]);
+	}
+	for (int i = 0; i < lights.size(); i++)
+	{
+		LightState& state = mLightStates[i];
+		if (desiredTier[i] < 0 || state.tier >= 0)
+			continue;
+
+		std::vector<int>& owners = mTiers[desiredTier[i]].owners;
+		int slot = std::find(owners.begin(), owners.end(), -1) - owners.begin();
+		owners[slot] = i;
+		state.tier = desiredTier[i];
+		state.slot = slot;
+		state.valid = false;
+	}
+
+	// pick the lights to re-render: slots without a shadow yet come first, then lights by how overdue they are.
+	// Lights that miss out this frame become more overdue, so low priority lights are refreshed round-robin.
+	FrameVector<unsigned int> candidates(arena);
+	for (int i = 0; i < lights.size(); i++)
+	{
+		const LightState& state = mLightStates[i];
+		if (state.tier >= 0 && (!state.valid || mFrame - state.lastUpdate >= mTiers[state.tier].config.updateInterval))
+			candidates.push_back(i);
+	}
+	auto overdue = [this](unsigned int i) {
+		const LightState& state = mLightStates[i];
+		if (!state.valid)
+			return 1e30f;
+		return (float)(mFrame - state.lastUpdate) / mTiers[state.tier].config.updateInterval * (1.0f + state.importance);
+	};
+	std::sort(candidates.begin(), candidates.end(), [&overdue](unsigned int a, unsigned int b) { return overdue(a) > overdue(b); });
+	if (candidates.size() > mUpdatesPerFrame)
+		candidates.resize(mUpdatesPerFrame);
+	mUpdateList.assign(candidates.begin(), candidates.end());
+}
+
+void ShadowAtlas::BeginUpdate(unsigned int lightIndex, const PointLight& light, const Shader& depthShader)
+{
+	LightState& state = mLightStates[lightIndex];
+	const Tier& tier = mTiers[state.tier];
+	int baseLayer = 6 * state.slot;
+
+	// clear only this light's six layers
+	glBindFramebuffer(GL_FRAMEBUFFER, mClearFramebuffer);
+	for (int face = 0; face < 6; face++)
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tier.texture, 0, baseLayer + face);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, tier.framebuffer);
+	glViewport(0, 0, tier.config.resolution, tier.config.resolution);
+
+	const glm::vec3& pos = light.position;
+	glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, state.farPlane);
+	glm::mat4 shadowTransforms[6] =
+	{
+		shadowProj * glm::lookAt(pos, pos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+		shadowProj * glm::lookAt(pos, pos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+		shadowProj * glm::lookAt(pos, pos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+		shadowProj * glm::lookAt(pos, pos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
+		shadowProj * glm::lookAt(pos, pos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+		shadowProj * glm::lookAt(pos, pos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
+	};
+	for (int i = 0; i < 6; ++i)
+		depthShader.SetMat4f(SHADOW_MATRIX_NAMES[i], shadowTransforms[i]);
+	depthShader.SetFloat("farPlane", state.farPlane);
+	depthShader.SetVec3f("lightPos", pos);
+	depthShader.SetInt("layerOffset", baseLayer);
+
+	state.valid = true;
+	state.lastUpdate = mFrame;
+}
+
+void ShadowAtlas::BindTextures(unsigned int firstUnit) const
+{
+	for (int i = 0; i < mTiers.size(); i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, mTiers[i].texture);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+int ShadowAtlas::GetTier(unsigned int lightIndex) const
+{
+	// lights whose slot hasn't been rendered yet are drawn unshadowed
+	const LightState& state = mLightStates[lightIndex];
+	return state.valid ? state.tier : -1;
+}
+
+int ShadowAtlas::GetLayer(unsigned int lightIndex) const
+{
+	return 6 * mLightStates[lightIndex].slot;
+}
+
+unsigned int ShadowAtlas::GetMemoryUsage() const
+{
+	unsigned int bytes = 0;
+	for (int i = 0; i < mTiers.size(); i++)
+		bytes += mTiers[i].config.resolution * mTiers[i].config.resolution * 6 * mTiers[i].config.slots * 2;
+	return bytes;
+}
+
+float ShadowAtlas::CalcImportance(const PointLight& light, float radius, const glm::vec3& viewPos, float projScale, const Frustum& frustum) const
+{
+	// a light whose sphere of influence is off screen lights nothing visible
+	if (!frustum.IntersectsSphere(light.position, radius))
+		return 0.0f;
+
+	// fraction of the screen covered by the light's sphere of influence, weighted by brightness
+	float distance = glm::length(light.position - viewPos);
+	float coverage = distance <= radius ? 1.0f : std::min(1.0f, radius * projScale / distance);
+	float brightness = std::max(std::max(light.diffuse.x, light.diffuse.y), light.diffuse.z);
+	return coverage * coverage * brightness;
+}
+
+void ShadowAtlas::ReleaseSlot(LightState& state)
+{
+	if (state.tier >= 0)
+		mTiers[state.tier].owners[state.slot] = -1;
+	state.tier = -1;
+	state.slot = -1;
+	state.valid = false;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <glm\glm.hpp>
+#include "Light.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "Frustum.h"
+#include "FrameArena.h"
+#include "GlObject.h"
+
+// the object shader samples at most this many tiers (shadowMaps[0..2])
+const unsigned int MAX_SHADOW_TIERS = 3;
+
+struct ShadowTier
+{
+	unsigned int resolution;
+	unsigned int slots;
+	unsigned int updateInterval; // refresh a light in this tier every N frames
+};
+
+// Shadow storage for many point lights.
+// Each tier is a depth 2D texture array with six layers (one per cube face) per slot,
+// so the shadow memory is fixed up front. Every frame, Allocate() ranks the lights by
+// screen-space importance, gives the most important ones the highest resolution tier
+// and picks which lights to re-render within the per-frame update budget.
+class ShadowAtlas
+{
+public:
+	ShadowAtlas() = default;
+	ShadowAtlas(const std::vector<ShadowTier>& tiers, unsigned int updatesPerFrame);
+
+	// scratch lists come from the frame arena
+	void Allocate(const std::vector<PointLight>& lights, const Camera& camera, FrameArena& arena);
+	const std::vector<unsigned int>& GetUpdateList() const { return mUpdateList; }
+
+	// Render target and depth shader uniforms for re-rendering one light's six faces
+	void BeginUpdate(unsigned int lightIndex, const PointLight& light, const Shader& depthShader);
+	void BindTextures(unsigned int firstUnit) const;
+
+	int GetTier(unsigned int lightIndex) const;
+	int GetLayer(unsigned int lightIndex) const;
+	float GetFarPlane(unsigned int lightIndex) const { return mLightStates[lightIndex].farPlane; }
+	unsigned int GetMemoryUsage() const;
+
+private:
+	struct Tier
+	{
+		ShadowTier config;
+		GlTexture texture;
+		GlFramebuffer framebuffer;
+		std::vector<int> owners; // light index per slot, -1 if free
+	};
+
+	struct LightState
+	{
+		int tier = -1;
+		int slot = -1;
+		bool valid = false; // the slot holds a rendered shadow for this light
+		unsigned int lastUpdate = 0;
+		float importance = 0.0f;
+		float farPlane = 25.0f;
+	};
+
+	float CalcImportance(const PointLight& light, float radius, const glm::vec3& viewPos, float projScale, const Frustum& frustum) const;
+	void ReleaseSlot(LightState& state);
+
+	std::vector<Tier> mTiers;
+	std::vector<LightState> mLightStates;
+	std::vector<unsigned int> mUpdateList;
+	unsigned int mUpdatesPerFrame = 0;
+	GlFramebuffer mClearFramebuffer;
+	unsigned int mFrame = 0;
+};
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "StreamBuffer.h"
+#include "GpuMemory.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// the regions together must stay addressable by an unsigned int offset
+static const unsigned long long MAX_FRAME_SIZE = 0xFFFFFFFFull / STREAM_BUFFER_FRAMES;
+
+StreamBuffer::StreamBuffer(GLenum target, unsigned int frameSize, bool growable) :
+	mTarget(target), mFrameSize(frameSize), mGrowable(growable)
+{
+	Create();
+}
+
+void StreamBuffer::Create()
+{
+	mBuffer = GlBuffer::Create();
+	TRACK_GPU_BUFFER(mBuffer, (unsigned long long)STREAM_BUFFER_FRAMES * mFrameSize, mTarget == GL_UNIFORM_BUFFER ? "uniform stream buffer" : "stream buffer");
+	glBindBuffer(mTarget, mBuffer);
+#ifdef GL_ARB_buffer_storage
+	if (GLAD_GL_ARB_buffer_storage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(mTarget, STREAM_BUFFER_FRAMES * mFrameSize, NULL, flags);
+		mMapping = (unsigned char*)glMapBufferRange(mTarget, 0, STREAM_BUFFER_FRAMES * mFrameSize, flags);
+		if (!mMapping)
+			std::cout << "Error::StreamBuffer::Persistent mapping failed" << std::endl;
+	}
+#endif
+	if (!mMapping)
+		glBufferData(mTarget, STREAM_BUFFER_FRAMES * mFrameSize, NULL, GL_STREAM_DRAW);
+	glBindBuffer(mTarget, 0);
+}
+
+void StreamBuffer::BeginFrame()
+{
+	if (mGrowable && mDemand > mFrameSize)
+		Grow();
+	mFrame = (mFrame + 1) % STREAM_BUFFER_FRAMES;
+	mOffset = 0;
+	mDemand = 0;
+	mFull = false;
+
+	if (!mMapping)
+	{
+		// a fresh store for the driver to hand out while the GPU finishes with the old one
+		glBindBuffer(mTarget, mBuffer);
+		glBufferData(mTarget, STREAM_BUFFER_FRAMES * mFrameSize, NULL, GL_STREAM_DRAW);
+		glBindBuffer(mTarget, 0);
+		return;
+	}
+
+	// only blocks when the CPU is a whole ring of frames ahead of the GPU
+	if (mFences[mFrame])
+	{
+		GLenum result = glClientWaitSync(mFences[mFrame], 0, 0);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(mFences[mFrame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		if (result == GL_WAIT_FAILED)
+			std::cout << "Error::StreamBuffer::Fence wait failed" << std::endl;
+		glDeleteSync(mFences[mFrame]);
+		mFences[mFrame] = 0;
+	}
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (mMapping)
+		mFences[mFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+unsigned int StreamBuffer::Write(const void* data, unsigned int size, unsigned int alignment)
+{
+	mDemand = ((mDemand + alignment - 1) & ~(unsigned long long)(alignment - 1)) + size;
+	mAlignment = std::max(mAlignment, alignment);
+	unsigned int offset = (mOffset + alignment - 1) & ~(alignment - 1);
+	if ((unsigned long long)offset + size > mFrameSize)
+	{
+		// never write into a region the GPU may be reading; the caller drops what needed the data instead
+		if (!mFull)
+			std::cout << "Error::StreamBuffer::Frame region full" << std::endl;
+		mFull = true;
+		countStreamOverflow();
+		return STREAM_BUFFER_FULL;
+	}
+	mOffset = offset + size;
+
+	unsigned int bufferOffset = mFrame * mFrameSize + offset;
+	if (size == 0)
+		return bufferOffset;
+	if (mMapping)
+	{
+		std::memcpy(mMapping + bufferOffset, data, size);
+	}
+	else
+	{
+		glBindBuffer(mTarget, mBuffer);
+		glBufferSubData(mTarget, bufferOffset, size, data);
+		glBindBuffer(mTarget, 0);
+	}
+	return bufferOffset;
+}
+
+void StreamBuffer::Grow()
+{
+	// the new buffer replaces every region at once, so wait until the GPU has finished with all of them
+	for (GLsync& fence : mFences)
+	{
+		if (!fence)
+			continue;
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		glDeleteSync(fence);
+		fence = 0;
+	}
+	if (mMapping)
+	{
+		glBindBuffer(mTarget, mBuffer);
+		glUnmapBuffer(mTarget);
+		glBindBuffer(mTarget, 0);
+		mMapping = nullptr;
+	}
+	mBuffer.Reset();
+
+	// a quarter to spare, so a scene that keeps growing a little doesn't reallocate every frame. The regions after the
+	// first start at multiples of the frame size, so it's rounded to the largest alignment asked of Write() to keep
+	// their offsets bindable.
+	unsigned long long alignmentMask = mAlignment - 1;
+	unsigned long long frameSize = std::min((mDemand + mDemand / 4 + alignmentMask) & ~alignmentMask, MAX_FRAME_SIZE & ~alignmentMask);
+	if (frameSize < mDemand)
+		std::cout << "Error::StreamBuffer::A frame needs " << mDemand << " bytes, more than a buffer can hold" << std::endl;
+	mFrameSize = (unsigned int)frameSize;
+	std::cout << "Stream buffer grown to " << mFrameSize / 1024 << " KB per frame" << std::endl;
+	Create();
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include <glad\glad.h>
+#include "GlObject.h"
+
+const unsigned int STREAM_BUFFER_FRAMES = 3;
+// returned by Write() when the frame's region has no room left
+const unsigned int STREAM_BUFFER_FULL = ~0u;
+
+// Ring buffer for the data the CPU rewrites every frame.
+// The store is split into one region per frame in flight. BeginFrame() moves on to the next region,
+// first waiting on the fence placed when the GPU was last given it, and EndFrame() fences the region
+// behind this frame's commands, so the CPU never writes over data a queued draw still reads.
+// With ARB_buffer_storage the store is mapped once, persistently and coherently, and Write() is a memcpy;
+// on plain GL 3.3 the store is orphaned at the start of each frame and written with glBufferSubData.
+// Write() returns the offset of the data within the buffer, for glBindBufferRange or a texel base, or
+// STREAM_BUFFER_FULL once the frame's region is used up: nothing is written, and the caller must skip the draw
+// that would have read the data. Each write that doesn't fit is counted in the RenderStats, and unless the buffer
+// was made fixed size the next BeginFrame() grows the regions to what the frame asked for. Growing makes a new
+// buffer object, so take GetBuffer() afresh each frame.
+class StreamBuffer
+{
+public:
+	StreamBuffer() = default;
+	StreamBuffer(GLenum target, unsigned int frameSize, bool growable = false);
+
+	void BeginFrame();
+	void EndFrame();
+	// alignment must be a power of two, and the frame size passed in a multiple of it
+	unsigned int Write(const void* data, unsigned int size, unsigned int alignment);
+
+	unsigned int GetBuffer() const { return mBuffer; }
+	unsigned int GetFrameSize() const { return mFrameSize; }
+	bool IsPersistent() const { return mMapping != nullptr; }
+
+private:
+	void Create();
+	void Grow();
+
+	GLenum mTarget = 0;
+	GlBuffer mBuffer;
+	unsigned int mFrameSize = 0;
+	unsigned char* mMapping = nullptr;
+	bool mGrowable = false;
+
+	unsigned int mFrame = 0; // region being written
+	unsigned int mOffset = 0; // next free byte within it
+	bool mFull = false;
+	unsigned long long mDemand = 0; // bytes the frame's writes asked for, whether they fitted or not
+	unsigned int mAlignment = 1; // largest alignment Write() has been asked for
+	GLsync mFences[STREAM_BUFFER_FRAMES] = {};
+};
\ No newline at end of file
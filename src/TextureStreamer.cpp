@@ -0,0 +1,450 @@
+#include "TextureStreamer.h"
+#include "CpuProfiler.h"
+#include "GpuMemory.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+static void getFormats(int numChannels, bool srgb, GLenum& internalFormat, GLenum& format)
+{
+	switch (numChannels)
+	{
+	case 1: internalFormat = GL_R8; format = GL_RED; break;
+	case 2: internalFormat = GL_RG8; format = GL_RG; break;
+	case 3: internalFormat = srgb ? GL_SRGB8 : GL_RGB8; format = GL_RGB; break;
+	default: internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; format = GL_RGBA; break;
+	}
+}
+
+static int mipSize(int size, int level)
+{
+	return std::max(size >> level, 1);
+}
+
+// 2x2 box filter; an odd row or column is averaged with itself
+static void downsample(const std::vector<unsigned char>& source, int width, int height, int numChannels, std::vector<unsigned char>& destination)
+{
+	int destinationWidth = mipSize(width, 1), destinationHeight = mipSize(height, 1);
+	destination.resize((size_t)destinationWidth * destinationHeight * numChannels);
+	for (int y = 0; y < destinationHeight; y++)
+	{
+		int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+		for (int x = 0; x < destinationWidth; x++)
+		{
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			for (int c = 0; c < numChannels; c++)
+			{
+				unsigned int sum = source[((size_t)y0 * width + x0) * numChannels + c] + source[((size_t)y0 * width + x1) * numChannels + c]
+					+ source[((size_t)y1 * width + x0) * numChannels + c] + source[((size_t)y1 * width + x1) * numChannels + c];
+				destination[((size_t)y * destinationWidth + x) * numChannels + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+void TextureStreamer::Init(JobSystem& jobs, unsigned int screenWidth, unsigned int screenHeight, unsigned long long budgetBytes)
+{
+	mJobs = &jobs;
+	mBudgetBytes = budgetBytes;
+	mFeedbackWidth = std::max(screenWidth / TEXTURE_FEEDBACK_SCALE, 1u);
+	mFeedbackHeight = std::max(screenHeight / TEXTURE_FEEDBACK_SCALE, 1u);
+	mFeedbackBuffer = createFramebuffer("texture feedback", mFeedbackWidth, mFeedbackHeight, { { GL_RG16UI, GL_RG_INTEGER, GL_UNSIGNED_SHORT } });
+	unsigned int bytes = mFeedbackWidth * mFeedbackHeight * 4;
+	for (FeedbackFrame& frame : mFeedbackFrames)
+	{
+		frame.pixels = GlBuffer::Create();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, frame.pixels);
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		TRACK_GPU_BUFFER(frame.pixels, bytes, "texture feedback read back");
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+unsigned int TextureStreamer::Load(const std::string& path, bool srgb, JobCounter& counter)
+{
+	StreamedTexture texture;
+	texture.texture = GlTexture::Create();
+	texture.path = path;
+	texture.srgb = srgb;
+	unsigned int id = texture.texture;
+	mTextureIndices[id] = mTextures.size();
+	mTextures.push_back(std::move(texture));
+	StartLoad(mTextures.size() - 1, -1, -1, &counter);
+	return id;
+}
+
+void TextureStreamer::StartLoad(unsigned int index, int firstLevel, int lastLevel, JobCounter* counter)
+{
+	mTextures[index].loading = true;
+	mLoadsInFlight++;
+	if (!counter)
+		counter = &mLoads;
+
+	// the whole image is decoded every time: the files hold no mips of their own to read on their own
+	JobSystem& jobs = *mJobs;
+	std::string path = mTextures[index].path;
+	jobs.Run([this, &jobs, index, path, firstLevel, lastLevel, counter]() {
+		std::shared_ptr<MipChain> chain = std::make_shared<MipChain>();
+		TextureImage image = decodeTexture(path);
+		if (image.data)
+		{
+			CpuScope scope("Build mips");
+			chain->width = image.width;
+			chain->height = image.height;
+			chain->numChannels = image.numChannels;
+			int numMips = std::min((int)std::log2(std::max(image.width, image.height)) + 1, (int)TEXTURE_STREAM_MAX_MIPS);
+			// the first load is every mip up to the initial size
+			int first = firstLevel;
+			if (first < 0)
+			{
+				first = 0;
+				while (first < numMips - 1 && std::max(mipSize(image.width, first), mipSize(image.height, first)) > (int)TEXTURE_STREAM_INITIAL_SIZE)
+					first++;
+			}
+			int last = lastLevel < 0 ? numMips - 1 : std::min(lastLevel, numMips - 1);
+			chain->firstLevel = first;
+
+			std::vector<unsigned char> level(image.data, image.data + (size_t)image.width * image.height * image.numChannels), next;
+			stbi_image_free(image.data);
+			for (int i = 0; i <= last; i++)
+			{
+				if (i >= first)
+					chain->levels.push_back(level);
+				if (i < last)
+				{
+					downsample(level, mipSize(chain->width, i), mipSize(chain->height, i), chain->numChannels, next);
+					level.swap(next);
+				}
+			}
+		}
+		jobs.RunOnMainThread([this, index, chain]() { Upload(index, *chain); }, counter);
+	}, counter);
+}
+
+void TextureStreamer::Upload(unsigned int index, const MipChain& chain)
+{
+	if (index >= mTextures.size())
+		return;
+	StreamedTexture& texture = mTextures[index];
+	texture.loading = false;
+	texture.pendingBytes = 0;
+	mLoadsInFlight--;
+	if (chain.levels.empty())
+	{
+		std::cout << "Failed to load texture at path: " << texture.path << std::endl;
+		return;
+	}
+
+	bool initial = texture.width == 0;
+	if (initial)
+	{
+		texture.width = chain.width;
+		texture.height = chain.height;
+		texture.numChannels = chain.numChannels;
+		texture.numMips = chain.firstLevel + chain.levels.size();
+		texture.initialLevel = chain.firstLevel;
+		texture.log2Size = std::log2((float)std::max(chain.width, chain.height));
+	}
+	else
+		mNumLoads++;
+
+	CpuScope scope("Texture mip upload");
+	GLenum internalFormat, format;
+	getFormats(texture.numChannels, texture.srgb, internalFormat, format);
+	glBindTexture(GL_TEXTURE_2D, texture.texture);
+	// rows of three channels, or of the smallest mips, aren't four byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int i = 0; i < chain.levels.size(); i++)
+	{
+		int level = chain.firstLevel + i;
+		glTexImage2D(GL_TEXTURE_2D, level, internalFormat, mipSize(texture.width, level), mipSize(texture.height, level), 0, format, GL_UNSIGNED_BYTE, chain.levels[i].data());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (initial)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture.numChannels == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture.numChannels == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.numMips - 1);
+	}
+	texture.baseLevel = chain.firstLevel;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.baseLevel);
+	Track(texture);
+}
+
+void TextureStreamer::BeginFeedback()
+{
+	mFeedbackFrame = (mFeedbackFrame + 1) % TEXTURE_FEEDBACK_FRAMES;
+	FeedbackFrame& frame = mFeedbackFrames[mFeedbackFrame];
+	if (frame.fence)
+	{
+		// still not read back a whole ring of frames later: drop it rather than wait
+		glDeleteSync(frame.fence);
+		frame.fence = 0;
+		mSkippedFeedback++;
+	}
+	frame.drawOffsets.clear();
+	frame.drawOffsets.push_back(0);
+	frame.drawTextures.clear();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, mFeedbackBuffer.id);
+	glViewport(0, 0, mFeedbackWidth, mFeedbackHeight);
+	const GLuint clearFeedback[] = { 0, 0, 0, 0 };
+	glClearBufferuiv(GL_COLOR, 0, clearFeedback);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+unsigned int TextureStreamer::AddFeedbackDraw(const std::vector<Texture>& textures)
+{
+	FeedbackFrame& frame = mFeedbackFrames[mFeedbackFrame];
+	// ids are 16 bits, and 0 is nothing
+	if (frame.drawOffsets.size() > 0xffff)
+		return 0;
+	unsigned int first = frame.drawTextures.size();
+	for (const Texture& texture : textures)
+	{
+		auto it = mTextureIndices.find(texture.id);
+		if (it != mTextureIndices.end())
+			frame.drawTextures.push_back(it->second);
+	}
+	if (frame.drawTextures.size() == first)
+		return 0;
+	frame.drawOffsets.push_back(frame.drawTextures.size());
+	return frame.drawOffsets.size() - 1;
+}
+
+void TextureStreamer::EndFeedback()
+{
+	FeedbackFrame& frame = mFeedbackFrames[mFeedbackFrame];
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, frame.pixels);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, mFeedbackWidth, mFeedbackHeight, GL_RG_INTEGER, GL_UNSIGNED_SHORT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void TextureStreamer::Update()
+{
+	if (!mJobs)
+		return;
+	CpuScope scope("Texture streaming");
+	// oldest first, so the last one read is the newest
+	for (unsigned int i = 1; i <= TEXTURE_FEEDBACK_FRAMES; i++)
+	{
+		FeedbackFrame& frame = mFeedbackFrames[(mFeedbackFrame + i) % TEXTURE_FEEDBACK_FRAMES];
+		if (!frame.fence)
+			continue;
+		GLenum result = glClientWaitSync(frame.fence, 0, 0);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			ReadFeedback(frame);
+	}
+	RequestMips();
+}
+
+void TextureStreamer::ReadFeedback(FeedbackFrame& frame)
+{
+	glDeleteSync(frame.fence);
+	frame.fence = 0;
+	mFeedbackSerial++;
+
+	// the finest footprint of each draw, then of each texture: a footprint of 2^lod texture coordinates per feedback
+	// pixel is 2^(lod + log2(size)) texels, and TEXTURE_FEEDBACK_SCALE times fewer per screen pixel
+	unsigned int numDraws = frame.drawOffsets.size() - 1;
+	mDrawLods.assign(numDraws, FLT_MAX);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, frame.pixels);
+	const unsigned short* pixels = (const unsigned short*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, mFeedbackWidth * mFeedbackHeight * 4, GL_MAP_READ_BIT);
+	if (pixels)
+	{
+		for (unsigned int i = 0; i < mFeedbackWidth * mFeedbackHeight; i++)
+		{
+			unsigned int id = pixels[2 * i];
+			if (id == 0 || id > numDraws)
+				continue;
+			mDrawLods[id - 1] = std::min(mDrawLods[id - 1], pixels[2 * i + 1] / 256.0f - 32.0f);
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	for (StreamedTexture& texture : mTextures)
+		texture.requiredLevel = INT_MAX;
+	float scaleLod = std::log2((float)TEXTURE_FEEDBACK_SCALE);
+	for (unsigned int draw = 0; draw < numDraws; draw++)
+	{
+		if (mDrawLods[draw] == FLT_MAX)
+			continue;
+		for (unsigned int i = frame.drawOffsets[draw]; i < frame.drawOffsets[draw + 1]; i++)
+		{
+			StreamedTexture& texture = mTextures[frame.drawTextures[i]];
+			if (texture.width == 0)
+				continue;
+			int level = (int)std::floor(mDrawLods[draw] + texture.log2Size - scaleLod);
+			texture.requiredLevel = std::min(texture.requiredLevel, std::max(std::min(level, texture.numMips - 1), 0));
+		}
+	}
+	for (StreamedTexture& texture : mTextures)
+	{
+		for (int level = texture.requiredLevel; level < texture.numMips; level++)
+			texture.lastUsed[level] = mFeedbackSerial;
+	}
+}
+
+void TextureStreamer::RequestMips()
+{
+	while (mLoadsInFlight < TEXTURE_STREAM_MAX_LOADS)
+	{
+		// the texture furthest from the mip it needs goes first
+		int next = -1;
+		int nextGap = 0;
+		for (unsigned int i = 0; i < mTextures.size(); i++)
+		{
+			const StreamedTexture& texture = mTextures[i];
+			if (texture.loading || texture.width == 0 || texture.requiredLevel >= texture.baseLevel)
+				continue;
+			if (texture.baseLevel - texture.requiredLevel > nextGap)
+			{
+				next = i;
+				nextGap = texture.baseLevel - texture.requiredLevel;
+			}
+		}
+		if (next < 0)
+			return;
+
+		// as fine as the budget allows, once the mips no longer needed are evicted
+		StreamedTexture& texture = mTextures[next];
+		unsigned long long resident = GetBytes(texture, texture.baseLevel);
+		int firstLevel = texture.requiredLevel;
+		while (firstLevel < texture.baseLevel && !MakeRoom(GetBytes(texture, firstLevel) - resident))
+			firstLevel++;
+		if (firstLevel == texture.baseLevel)
+		{
+			// nothing fits: wait for the next feedback
+			texture.requiredLevel = INT_MAX;
+			continue;
+		}
+		texture.pendingBytes = GetBytes(texture, firstLevel) - resident;
+		StartLoad(next, firstLevel, texture.baseLevel - 1, nullptr);
+	}
+}
+
+bool TextureStreamer::MakeRoom(unsigned long long bytes)
+{
+	unsigned long long used = GetResidentBytes();
+	unsigned long long evictable = 0;
+	for (const StreamedTexture& texture : mTextures)
+	{
+		used += texture.pendingBytes;
+		if (texture.loading || texture.width == 0)
+			continue;
+		// the mips the latest feedback needed stay
+		int level = texture.baseLevel;
+		while (level < texture.initialLevel && texture.lastUsed[level] != mFeedbackSerial)
+			level++;
+		evictable += GetBytes(texture, texture.baseLevel) - GetBytes(texture, level);
+	}
+	if (used + bytes > mBudgetBytes + evictable)
+		return false;
+
+	// least recently needed mip first
+	while (used + bytes > mBudgetBytes)
+	{
+		StreamedTexture* victim = nullptr;
+		for (StreamedTexture& texture : mTextures)
+		{
+			if (texture.loading || texture.width == 0 || texture.baseLevel >= texture.initialLevel || texture.lastUsed[texture.baseLevel] == mFeedbackSerial)
+				continue;
+			if (!victim || texture.lastUsed[texture.baseLevel] < victim->lastUsed[victim->baseLevel])
+				victim = &texture;
+		}
+		if (!victim)
+			return false;
+		unsigned long long before = GetBytes(*victim, victim->baseLevel);
+		Evict(*victim);
+		used -= before - GetBytes(*victim, victim->baseLevel);
+	}
+	return true;
+}
+
+void TextureStreamer::Evict(StreamedTexture& texture)
+{
+	GLenum internalFormat, format;
+	getFormats(texture.numChannels, texture.srgb, internalFormat, format);
+	int level = texture.baseLevel;
+	texture.baseLevel++;
+	glBindTexture(GL_TEXTURE_2D, texture.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.baseLevel);
+	// an empty image frees the level's storage; levels under the base level don't make the texture incomplete
+	glTexImage2D(GL_TEXTURE_2D, level, internalFormat, 0, 0, 0, format, GL_UNSIGNED_BYTE, NULL);
+	Track(texture);
+	mNumEvictions++;
+}
+
+void TextureStreamer::Track(const StreamedTexture& texture) const
+{
+	GLenum internalFormat, format;
+	getFormats(texture.numChannels, texture.srgb, internalFormat, format);
+	TRACK_GPU_TEXTURE(texture.texture, internalFormat, mipSize(texture.width, texture.baseLevel), mipSize(texture.height, texture.baseLevel), 1, 1, true, texture.path);
+}
+
+unsigned long long TextureStreamer::GetBytes(const StreamedTexture& texture, int baseLevel) const
+{
+	// three channels are padded to four, as GpuMemory counts them
+	unsigned long long bytesPerTexel = texture.numChannels == 3 ? 4 : texture.numChannels;
+	unsigned long long bytes = 0;
+	for (int level = baseLevel; level < texture.numMips; level++)
+		bytes += (unsigned long long)mipSize(texture.width, level) * mipSize(texture.height, level) * bytesPerTexel;
+	return bytes;
+}
+
+unsigned long long TextureStreamer::GetResidentBytes() const
+{
+	unsigned long long bytes = 0;
+	for (const StreamedTexture& texture : mTextures)
+		bytes += GetBytes(texture, texture.baseLevel);
+	return bytes;
+}
+
+void TextureStreamer::Dump(std::ostream& out) const
+{
+	if (!mJobs)
+		return;
+	out << "Texture streaming: " << mTextures.size() << " textures, " << GetResidentBytes() / (1024.0 * 1024.0) << " of " << mBudgetBytes / (1024.0 * 1024.0)
+		<< " MB, " << mLoadsInFlight << " loading, " << mNumLoads << " loads and " << mNumEvictions << " evictions so far, " << mSkippedFeedback << " feedback frames skipped" << std::endl;
+	for (const StreamedTexture& texture : mTextures)
+	{
+		out << "  " << texture.path << ": ";
+		if (texture.width == 0)
+		{
+			out << (texture.loading ? "loading" : "failed") << std::endl;
+			continue;
+		}
+		out << mipSize(texture.width, texture.baseLevel) << "x" << mipSize(texture.height, texture.baseLevel) << " (mip " << texture.baseLevel << " of " << texture.numMips << ")";
+		if (texture.requiredLevel != INT_MAX)
+			out << ", mip " << texture.requiredLevel << " needed";
+		out << (texture.loading ? ", loading" : "") << std::endl;
+	}
+}
+
+void TextureStreamer::Clear()
+{
+	if (!mJobs)
+		return;
+	// the uploads run on this thread while it waits
+	mJobs->Wait(mLoads);
+	for (FeedbackFrame& frame : mFeedbackFrames)
+	{
+		if (frame.fence)
+			glDeleteSync(frame.fence);
+		frame.fence = 0;
+		frame.pixels.Reset();
+	}
+	mFeedbackBuffer = Framebuffer();
+	mTextures.clear();
+	mTextureIndices.clear();
+	mJobs = nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+#include <climits>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GlObject.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "Utility.h"
+
+// feedback read backs in flight: results are read when their fence has passed, normally a frame or two later
+const unsigned int TEXTURE_FEEDBACK_FRAMES = 3;
+// the feedback buffer is this many times smaller than the screen each way
+const unsigned int TEXTURE_FEEDBACK_SCALE = 8;
+// a texture's mips up to this size are loaded straight away and never evicted
+const unsigned int TEXTURE_STREAM_INITIAL_SIZE = 64;
+const unsigned int TEXTURE_STREAM_MAX_MIPS = 16;
+// refinements decoding at once
+const unsigned int TEXTURE_STREAM_MAX_LOADS = 4;
+
+// Mip streaming for material textures, under a budget of texture memory.
+// Load() hands out the texture name at once and only loads the mips up to TEXTURE_STREAM_INITIAL_SIZE. Each frame
+// the renderer draws the objects again into a small RG16UI feedback buffer (shaders/texture_feedback_fs.txt), each
+// draw tagged with an id from AddFeedbackDraw() and each pixel holding the log2 of its texture coordinate footprint.
+// The buffer is read back through a ring of pixel buffers, without stalling, and Update() turns it into the finest
+// mip each texture needs. Textures that need finer mips than they have are decoded again by a job, their missing
+// mips built on the worker and uploaded on the main thread, and GL_TEXTURE_BASE_LEVEL is lowered to them. When that
+// would go over the budget the finest mips of the textures least recently needed are evicted: the base level goes
+// back up and the level is respecified empty, which frees it.
+// Only the GL thread may call these.
+class TextureStreamer
+{
+public:
+	TextureStreamer() = default;
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	void Init(JobSystem& jobs, unsigned int screenWidth, unsigned int screenHeight, unsigned long long budgetBytes);
+	bool IsStreaming() const { return mJobs != nullptr; }
+	// the name is valid straight away; counter is done when the initial mips are in
+	unsigned int Load(const std::string& path, bool srgb, JobCounter& counter);
+
+	// binds and clears the feedback buffer; draw between these two, setting feedbackId per draw
+	void BeginFeedback();
+	// the feedbackId of a draw sampling these textures, 0 if none of them are streamed
+	unsigned int AddFeedbackDraw(const std::vector<Texture>& textures);
+	void EndFeedback();
+
+	// reads the feedback that has arrived, then evicts and requests mips to suit it
+	void Update();
+
+	unsigned long long GetResidentBytes() const;
+	void Dump(std::ostream& out) const;
+	// deletes every texture and GL object, once the loads under way have finished; call while the context is current
+	void Clear();
+
+private:
+	struct StreamedTexture
+	{
+		GlTexture texture;
+		std::string path;
+		bool srgb;
+		int width = 0; // 0 until the initial mips are in
+		int height = 0;
+		int numChannels = 0;
+		int numMips = 0;
+		int initialLevel = 0; // the coarsest base level, never evicted
+		int baseLevel = 0; // the finest mip resident
+		float log2Size = 0.0f;
+		int requiredLevel = INT_MAX; // the finest mip the last feedback asked for
+		bool loading = false;
+		unsigned long long pendingBytes = 0;
+		unsigned long long lastUsed[TEXTURE_STREAM_MAX_MIPS] = {}; // the feedback each mip was last needed by
+	};
+
+	// mips decoded by a job, from firstLevel down
+	struct MipChain
+	{
+		int width = 0;
+		int height = 0;
+		int numChannels = 0;
+		int firstLevel = 0;
+		std::vector<std::vector<unsigned char>> levels;
+	};
+
+	struct FeedbackFrame
+	{
+		GlBuffer pixels;
+		GLsync fence = 0;
+		// the textures of draw id i are drawTextures[drawOffsets[i - 1]] up to drawTextures[drawOffsets[i]]
+		std::vector<unsigned int> drawOffsets;
+		std::vector<unsigned int> drawTextures;
+	};
+
+	void ReadFeedback(FeedbackFrame& frame);
+	void RequestMips();
+	void StartLoad(unsigned int index, int firstLevel, int lastLevel, JobCounter* counter);
+	void Upload(unsigned int index, const MipChain& chain);
+	bool MakeRoom(unsigned long long bytes);
+	void Evict(StreamedTexture& texture);
+	void Track(const StreamedTexture& texture) const;
+	unsigned long long GetBytes(const StreamedTexture& texture, int baseLevel) const;
+
+	JobSystem* mJobs = nullptr;
+	unsigned long long mBudgetBytes = 0;
+	std::vector<StreamedTexture> mTextures;
+	std::unordered_map<unsigned int, unsigned int> mTextureIndices; // by GL name
+	JobCounter mLoads;
+	unsigned int mLoadsInFlight = 0;
+
+	Framebuffer mFeedbackBuffer;
+	unsigned int mFeedbackWidth = 0;
+	unsigned int mFeedbackHeight = 0;
+	FeedbackFrame mFeedbackFrames[TEXTURE_FEEDBACK_FRAMES];
+	unsigned int mFeedbackFrame = 0;
+	unsigned long long mFeedbackSerial = 0; // feedback read so far
+	std::vector<float> mDrawLods; // finest footprint of each draw in the feedback being read
+
+	unsigned int mNumLoads = 0;
+	unsigned int mNumEvictions = 0;
+	unsigned int mSkippedFeedback = 0;
+};
\ No newline at end of file
@@ -1,29 +1,53 @@
 #include "Utility.h"
 #include <GLAD\glad\glad.h>
 #include "stb_image.h"
+#include "CpuProfiler.h"
+#include "GpuMemory.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 
-unsigned int loadTexture(const std::string& path)
+TextureImage decodeTexture(const std::string& path)
 {
-	unsigned int id;
-	glGenTextures(1, &id);
+	CpuScope scope("stbi decode");
+	// stb_image's flip flag is shared by every thread, so the rows are flipped here instead
+	TextureImage image;
+	image.data = stbi_load(path.c_str(), &image.width, &image.height, &image.numChannels, 0);
+	if (!image.data)
+		return image;
 
-	stbi_set_flip_vertically_on_load(true);
-	int width, height, numChannels;
-	unsigned char* image = stbi_load(path.c_str(), &width, &height, &numChannels, 0);
-	if (image)
+	size_t rowSize = image.width * image.numChannels;
+	std::vector<unsigned char> row(rowSize);
+	for (int y = 0; y < image.height / 2; y++)
+	{
+		unsigned char* top = image.data + y * rowSize;
+		unsigned char* bottom = image.data + (image.height - 1 - y) * rowSize;
+		std::copy(top, top + rowSize, row.begin());
+		std::copy(bottom, bottom + rowSize, top);
+		std::copy(row.begin(), row.end(), bottom);
+	}
+	return image;
+}
+
+void uploadTexture(unsigned int id, TextureImage& image, const std::string& path, bool srgb)
+{
+	CpuScope scope("glTexImage2D");
+	if (image.data)
 	{
 		glBindTexture(GL_TEXTURE_2D, id);
 
-		if (numChannels == 3)
+		if (image.numChannels == 3)
 		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+			glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB : GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data);
+			TRACK_GPU_TEXTURE(id, srgb ? GL_SRGB : GL_RGB, image.width, image.height, 1, 1, true, path);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		}
-		else if (numChannels == 4)
+		else if (image.numChannels == 4)
 		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+			glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB_ALPHA : GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data);
+			TRACK_GPU_TEXTURE(id, srgb ? GL_SRGB_ALPHA : GL_RGBA, image.width, image.height, 1, 1, true, path);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		}
@@ -32,59 +56,131 @@ unsigned int loadTexture(const std::string& path)
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(image);
 	}
 	else
-	{
 		std::cout << "Failed to load texture at path: " << path << std::endl;
-		stbi_image_free(image);
-	}
 
-	return id;
+	stbi_image_free(image.data);
+	image.data = nullptr;
 }
 
-unsigned int loadTextureSRGB(const std::string& path)
+static unsigned long crc32(const unsigned char* data, size_t size, unsigned long crc = 0)
 {
-	unsigned int id;
-	glGenTextures(1, &id);
-
-	stbi_set_flip_vertically_on_load(true);
-	int width, height, numChannels;
-	unsigned char* image = stbi_load(path.c_str(), &width, &height, &numChannels, 0);
-	if (image)
+	static unsigned long table[256];
+	if (table[1] == 0)
 	{
-		glBindTexture(GL_TEXTURE_2D, id);
-
-		if (numChannels == 3)
+		for (unsigned long i = 0; i < 256; i++)
 		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		}
-		else if (numChannels == 4)
-		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			unsigned long c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320ul ^ (c >> 1) : c >> 1;
+			table[i] = c;
 		}
+	}
+	crc ^= 0xfffffffful;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return crc ^ 0xfffffffful;
+}
 
-		glGenerateMipmap(GL_TEXTURE_2D);
+static void appendBigEndian(std::vector<unsigned char>& out, unsigned long value)
+{
+	out.push_back((value >> 24) & 0xff);
+	out.push_back((value >> 16) & 0xff);
+	out.push_back((value >> 8) & 0xff);
+	out.push_back(value & 0xff);
+}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+static void writePngChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+{
+	std::vector<unsigned char> chunk;
+	appendBigEndian(chunk, data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+	file.write((const char*)chunk.data(), chunk.size());
+}
 
-		stbi_image_free(image);
+bool writePng(const std::string& path, const unsigned char* pixels, int width, int height, int numChannels)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Error::Utility::Can't write " << path << std::endl;
+		return false;
 	}
-	else
+
+	// the image data is a zlib stream of stored deflate blocks, each row starting with filter type 0 (none)
+	size_t rowSize = (size_t)width * numChannels;
+	std::vector<unsigned char> raw;
+	raw.reserve((rowSize + 1) * height);
+	for (int y = 0; y < height; y++)
 	{
-		std::cout << "Failed to load texture at path: " << path << std::endl;
-		stbi_image_free(image);
+		raw.push_back(0);
+		raw.insert(raw.end(), pixels + y * rowSize, pixels + (y + 1) * rowSize);
+	}
+	std::vector<unsigned char> zlib = { 0x78, 0x01 };
+	for (size_t offset = 0; offset < raw.size() || offset == 0; offset += 65535)
+	{
+		size_t blockSize = std::min(raw.size() - offset, (size_t)65535);
+		zlib.push_back(offset + blockSize == raw.size() ? 1 : 0);
+		zlib.push_back(blockSize & 0xff);
+		zlib.push_back(blockSize >> 8);
+		zlib.push_back(~blockSize & 0xff);
+		zlib.push_back((~blockSize >> 8) & 0xff);
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+	}
+	unsigned long a = 1, b = 0;
+	for (unsigned char byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
 	}
+	appendBigEndian(zlib, (b << 16) | a);
 
+	std::vector<unsigned char> header;
+	appendBigEndian(header, width);
+	appendBigEndian(header, height);
+	header.push_back(8);
+	header.push_back(numChannels == 4 ? 6 : 2);
+	header.insert(header.end(), { 0, 0, 0 });
+
+	const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	file.write((const char*)signature, sizeof(signature));
+	writePngChunk(file, "IHDR", header);
+	writePngChunk(file, "IDAT", zlib);
+	writePngChunk(file, "IEND", {});
+	return (bool)file;
+}
+
+GlTexture loadTexture(const std::string& path)
+{
+	GlTexture id = GlTexture::Create();
+	TextureImage image = decodeTexture(path);
+	uploadTexture(id, image, path, false);
 	return id;
 }
 
+GlTexture loadTextureSRGB(const std::string& path)
+{
+	GlTexture id = GlTexture::Create();
+	TextureImage image = decodeTexture(path);
+	uploadTexture(id, image, path, true);
+	return id;
+}
+
+GlTexture loadTextureAsync(JobSystem& jobs, const std::string& path, bool srgb, JobCounter& counter)
+{
+	// the texture name is valid straight away; the image is decoded by a job and uploaded on the main thread
+	GlTexture texture = GlTexture::Create();
+	unsigned int id = texture;
+	jobs.Run([&jobs, &counter, path, id, srgb]() {
+		TextureImage image = decodeTexture(path);
+		jobs.RunOnMainThread([image, path, id, srgb]() mutable { uploadTexture(id, image, path, srgb); }, &counter);
+	}, &counter);
+	return texture;
+}
+
 void bindTextureMaps(unsigned int map0, unsigned int map1)
 {
 	glActiveTexture(GL_TEXTURE0);
@@ -103,31 +199,63 @@ void bindTextureMaps(unsigned int map0, unsigned int map1, unsigned int map2)
 	glBindTexture(GL_TEXTURE_2D, map2);
 }
 
-unsigned int createFramebuffer(unsigned int width, unsigned int height)
+Framebuffer createFramebuffer(const std::string& name, unsigned int width, unsigned int height, const std::vector<AttachmentFormat>& colourFormats, unsigned int samples, unsigned int sharedDepthTexture)
 {
-	unsigned int framebuffer;
-	glGenFramebuffers(1, &framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-	// create a texture for the colour attachment
-	unsigned int texColourBuffer;
-	glGenTextures(1, &texColourBuffer);
-	glBindTexture(GL_TEXTURE_2D, texColourBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	Framebuffer framebuffer;
+	framebuffer.samples = samples;
+	GLenum target = samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+	framebuffer.id = GlFramebuffer::Create();
+	TRACK_GPU_OBJECT(GpuResourceType::Framebuffer, framebuffer.id, name);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id);
 
-	// create a renderbuffer for the depth and stencil attachments
-	unsigned int rbo;
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	// create a texture for each colour attachment
+	std::vector<GLenum> drawBuffers;
+	for (int i = 0; i < colourFormats.size(); i++)
+	{
+		GlTexture texture = GlTexture::Create();
+		glBindTexture(target, texture);
+		if (samples > 0)
+			glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, colourFormats[i].internalFormat, width, height, GL_TRUE);
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, colourFormats[i].internalFormat, width, height, 0, colourFormats[i].format, colourFormats[i].type, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		TRACK_GPU_TEXTURE(texture, colourFormats[i].internalFormat, width, height, 1, samples, false, name + " colour");
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, target, texture, 0);
+		framebuffer.colourTextures.push_back(std::move(texture));
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+	if (drawBuffers.empty())
+		glDrawBuffer(GL_NONE);
+	else
+		glDrawBuffers(drawBuffers.size(), drawBuffers.data());
 
-	// attach the attachments to the framebuffer
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColourBuffer, 0);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+	// create a texture for the depth and stencil attachments, so that later passes can read the depth,
+	// or share the depth of another framebuffer with the same size and sample count
+	framebuffer.depthTexture = sharedDepthTexture;
+	if (sharedDepthTexture == 0)
+	{
+		framebuffer.ownDepthTexture = GlTexture::Create();
+		framebuffer.depthTexture = framebuffer.ownDepthTexture;
+		glBindTexture(target, framebuffer.depthTexture);
+		if (samples > 0)
+			glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_DEPTH24_STENCIL8, width, height, GL_TRUE);
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		TRACK_GPU_TEXTURE(framebuffer.depthTexture, GL_DEPTH24_STENCIL8, width, height, 1, samples, false, name + " depth");
+	}
+	glBindTexture(target, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, target, framebuffer.depthTexture, 0);
 
 	// check if the framebuffer is complete
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
@@ -137,13 +265,13 @@ unsigned int createFramebuffer(unsigned int width, unsigned int height)
 	return framebuffer;
 }
 
-unsigned int loadCubemap(std::vector<std::string> faces)
+GlTexture loadCubemap(std::vector<std::string> faces)
 {
-	unsigned int id;
-	glGenTextures(1, &id);
+	CpuScope scope("Cubemap load");
+	GlTexture id = GlTexture::Create();
 	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
 
-	int width, height, numChannels;
+	int width = 0, height = 0, numChannels = 0;
 	for (int i = 0; i < faces.size(); i++)
 	{
 		unsigned char* image = stbi_load(faces[i].c_str(), &width, &height, &numChannels, 0);
@@ -167,6 +295,7 @@ unsigned int loadCubemap(std::vector<std::string> faces)
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	TRACK_GPU_TEXTURE(id, numChannels == 4 ? GL_RGBA : GL_RGB, width, height, 6, 1, false, faces.empty() ? "cubemap" : faces[0]);
 
 	return id;
 }
@@ -174,4 +303,25 @@ unsigned int loadCubemap(std::vector<std::string> faces)
 void bindUniformBlockToPoint(const Shader& shader, const std::string& blockName, unsigned int bindingPoint)
 {
 	glUniformBlockBinding(shader.GetID(), glGetUniformBlockIndex(shader.GetID(), blockName.c_str()), bindingPoint);
+}
+
+// the vertices come from gl_VertexID (shaders/fullscreen_vs.txt), but the core profile still needs a vertex array bound
+static GlVertexArray gFullscreenVertexArray;
+
+void drawFullscreenTriangle()
+{
+	if (gFullscreenVertexArray == 0)
+	{
+		gFullscreenVertexArray = GlVertexArray::Create();
+		TRACK_GPU_OBJECT(GpuResourceType::VertexArray, gFullscreenVertexArray, "fullscreen triangle");
+	}
+	glBindVertexArray(gFullscreenVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	countDraw(1);
+	glBindVertexArray(0);
+}
+
+void releaseFullscreenTriangle()
+{
+	gFullscreenVertexArray.Reset();
 }
\ No newline at end of file
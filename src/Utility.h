@@ -2,13 +2,51 @@
 #include <string>
 #include <glm\glm.hpp>
 #include <vector>
+#include "GlObject.h"
 #include "Shader.h"
+#include "JobSystem.h"
 
-unsigned int loadTexture(const std::string& path);
-unsigned int loadTextureSRGB(const std::string& path);
+struct AttachmentFormat
+{
+	GLenum internalFormat;
+	GLenum format;
+	GLenum type;
+};
+
+// A framebuffer with a texture per colour attachment and a depth/stencil texture.
+// The textures are GL_TEXTURE_2D_MULTISAMPLE when samples > 0.
+struct Framebuffer
+{
+	GlFramebuffer id;
+	std::vector<GlTexture> colourTextures;
+	unsigned int depthTexture = 0; // may be another framebuffer's, which must then outlive this one
+	GlTexture ownDepthTexture; // unless the depth is shared
+	unsigned int samples = 0;
+};
+
+// A decoded image, flipped so that the first row is the bottom one as GL expects
+struct TextureImage
+{
+	unsigned char* data = nullptr;
+	int width = 0;
+	int height = 0;
+	int numChannels = 0;
+};
+
+TextureImage decodeTexture(const std::string& path);
+void uploadTexture(unsigned int id, TextureImage& image, const std::string& path, bool srgb);
+// 8 bit RGB or RGBA, first row at the top; stored uncompressed, so no compression library is needed
+bool writePng(const std::string& path, const unsigned char* pixels, int width, int height, int numChannels);
+GlTexture loadTexture(const std::string& path);
+GlTexture loadTextureSRGB(const std::string& path);
+// the texture must outlive the counter, as the upload writes to it
+GlTexture loadTextureAsync(JobSystem& jobs, const std::string& path, bool srgb, JobCounter& counter);
 void bindTextureMaps(unsigned int map0, unsigned int map1);
 void bindTextureMaps(unsigned int map0, unsigned int map1, unsigned int map2);
-unsigned int createFramebuffer(unsigned int width, unsigned int height);
-unsigned int loadCubemap(std::vector<std::string> faces);
+Framebuffer createFramebuffer(const std::string& name, unsigned int width, unsigned int height, const std::vector<AttachmentFormat>& colourFormats = { { GL_RGB, GL_RGB, GL_UNSIGNED_BYTE } }, unsigned int samples = 0, unsigned int sharedDepthTexture = 0);
+GlTexture loadCubemap(std::vector<std::string> faces);
 inline float billboard(const glm::vec3& camPos, const glm::vec3& objPos) { return atan2f(camPos.x - objPos.x, camPos.z - objPos.z); }
-void bindUniformBlockToPoint(const Shader& shader, const std::string& blockName, unsigned int bindingPoint);
\ No newline at end of file
+void bindUniformBlockToPoint(const Shader& shader, const std::string& blockName, unsigned int bindingPoint);
+void drawFullscreenTriangle();
+// deletes the vertex array drawFullscreenTriangle() keeps; call while the context is current
+void releaseFullscreenTriangle();
\ No newline at end of file